@@ -0,0 +1,78 @@
+; Branch target and timing tests, run with IceBro -batch branch.txt
+;	assemble with x65 branch.s branch.prg
+; Each test ends on jmp * after ldy #1 at the branch target, an ldx #$ee
+; after a taken branch means the target was missed. A taken branch costs
+; one cycle more, and another if the target is on a different page than
+; the instruction after the branch.
+
+	org $1000
+
+; $1000 beq forward on the same page, 3 cycles
+	lda #0
+	beq .same
+	ldx #$ee
+.same
+	ldy #1
+	jmp *
+
+; $1020 beq not taken, 2 cycles
+	org $1020
+	lda #1
+	beq .not
+	ldx #2
+.not
+	ldy #1
+	jmp *
+
+; $1040 bmi forward and back on the same page, 3 cycles each
+	org $1040
+	lda #$80
+	bmi .fwd
+.back
+	ldy #1
+	jmp *
+.fwd
+	ldx #$83
+	bmi .back
+
+; target of the branch back from $1122
+	org $10e0
+prev_page
+	ldy #1
+	jmp *
+
+; $10f9 beq forward to the next page, 4 cycles
+	org $10f9
+	lda #0
+	beq next_page
+	ldx #$ee
+	org $1104
+next_page
+	ldy #1
+	jmp *
+
+; $1120 beq back to the previous page, 4 cycles
+	org $1120
+	lda #0
+	beq prev_page
+	ldx #$ee
+
+; $11fc beq on the last bytes of a page to the page of the next instruction, 3 cycles
+	org $11fc
+	lda #0
+	beq .next_op
+	ldx #$ee
+	org $1204
+.next_op
+	ldy #1
+	jmp *
+
+; $12fc beq on the last bytes of a page back to the page of the branch, 4 cycles
+	org $12f0
+.branch_page
+	ldy #1
+	jmp *
+	org $12fc
+	lda #0
+	beq .branch_page
+	ldx #$ee
@@ -0,0 +1,920 @@
+; NMOS 6510 illegal opcode tests, run with IceBro -batch illegal.txt
+;	assemble with x65 illegal.s illegal.prg
+; Each test starts on a 32 byte boundary from $1000, sets up registers
+; and memory, runs one opcode and traps on jmp *. The manifest checks the
+; registers, the written memory and the cycles including the setup and
+; the final jmp. Unstable opcodes are only tested where the result does
+; not depend on the chip. Illegal nops are written as bytes.
+
+	cpu 6502ill
+	org $1000
+
+; $1000 slo (zp,x), 8 cycles
+	align 32
+	lda #$81
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lda #$40
+	clc
+	slo ($f0,x)
+	jmp *
+
+; $1020 slo zp, 5 cycles
+	align 32
+	lda #$40
+	sta $f0
+	lda #$01
+	sec
+	slo $f0
+	jmp *
+
+; $1040 slo abs, 6 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$ff
+	clc
+	slo $2000
+	jmp *
+
+; $1060 slo (zp),y, 8 cycles
+	align 32
+	lda #$ff
+	sta $2110
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$20
+	lda #$80
+	sec
+	slo ($f2),y
+	jmp *
+
+; $1080 slo zp,x, 6 cycles
+	align 32
+	lda #$7f
+	sta $f0
+	ldx #$10
+	lda #$7f
+	clc
+	slo $e0,x
+	jmp *
+
+; $10a0 slo abs,y, 7 cycles
+	align 32
+	lda #$80
+	sta $2110
+	ldy #$20
+	lda #$00
+	sec
+	slo $20f0,y
+	jmp *
+
+; $10c0 slo abs,x, 7 cycles
+	align 32
+	lda #$01
+	sta $2110
+	ldx #$20
+	lda #$35
+	clc
+	slo $20f0,x
+	jmp *
+
+; $10e0 rla (zp,x), 8 cycles
+	align 32
+	lda #$81
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lda #$40
+	clc
+	rla ($f0,x)
+	jmp *
+
+; $1100 rla zp, 5 cycles
+	align 32
+	lda #$40
+	sta $f0
+	lda #$01
+	sec
+	rla $f0
+	jmp *
+
+; $1120 rla abs, 6 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$ff
+	clc
+	rla $2000
+	jmp *
+
+; $1140 rla (zp),y, 8 cycles
+	align 32
+	lda #$ff
+	sta $2110
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$20
+	lda #$80
+	sec
+	rla ($f2),y
+	jmp *
+
+; $1160 rla zp,x, 6 cycles
+	align 32
+	lda #$7f
+	sta $f0
+	ldx #$10
+	lda #$7f
+	clc
+	rla $e0,x
+	jmp *
+
+; $1180 rla abs,y, 7 cycles
+	align 32
+	lda #$80
+	sta $2110
+	ldy #$20
+	lda #$00
+	sec
+	rla $20f0,y
+	jmp *
+
+; $11a0 rla abs,x, 7 cycles
+	align 32
+	lda #$01
+	sta $2110
+	ldx #$20
+	lda #$35
+	clc
+	rla $20f0,x
+	jmp *
+
+; $11c0 sre (zp,x), 8 cycles
+	align 32
+	lda #$81
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lda #$40
+	clc
+	sre ($f0,x)
+	jmp *
+
+; $11e0 sre zp, 5 cycles
+	align 32
+	lda #$40
+	sta $f0
+	lda #$01
+	sec
+	sre $f0
+	jmp *
+
+; $1200 sre abs, 6 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$ff
+	clc
+	sre $2000
+	jmp *
+
+; $1220 sre (zp),y, 8 cycles
+	align 32
+	lda #$ff
+	sta $2110
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$20
+	lda #$80
+	sec
+	sre ($f2),y
+	jmp *
+
+; $1240 sre zp,x, 6 cycles
+	align 32
+	lda #$7f
+	sta $f0
+	ldx #$10
+	lda #$7f
+	clc
+	sre $e0,x
+	jmp *
+
+; $1260 sre abs,y, 7 cycles
+	align 32
+	lda #$80
+	sta $2110
+	ldy #$20
+	lda #$00
+	sec
+	sre $20f0,y
+	jmp *
+
+; $1280 sre abs,x, 7 cycles
+	align 32
+	lda #$01
+	sta $2110
+	ldx #$20
+	lda #$35
+	clc
+	sre $20f0,x
+	jmp *
+
+; $12a0 rra (zp,x), 8 cycles
+	align 32
+	lda #$81
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lda #$40
+	clc
+	rra ($f0,x)
+	jmp *
+
+; $12c0 rra zp, 5 cycles
+	align 32
+	lda #$40
+	sta $f0
+	lda #$01
+	sec
+	rra $f0
+	jmp *
+
+; $12e0 rra abs, 6 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$ff
+	clc
+	rra $2000
+	jmp *
+
+; $1300 rra (zp),y, 8 cycles
+	align 32
+	lda #$ff
+	sta $2110
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$20
+	lda #$80
+	sec
+	rra ($f2),y
+	jmp *
+
+; $1320 rra zp,x, 6 cycles
+	align 32
+	lda #$7f
+	sta $f0
+	ldx #$10
+	lda #$7f
+	clc
+	rra $e0,x
+	jmp *
+
+; $1340 rra abs,y, 7 cycles
+	align 32
+	lda #$80
+	sta $2110
+	ldy #$20
+	lda #$00
+	sec
+	rra $20f0,y
+	jmp *
+
+; $1360 rra abs,x, 7 cycles
+	align 32
+	lda #$01
+	sta $2110
+	ldx #$20
+	lda #$35
+	clc
+	rra $20f0,x
+	jmp *
+
+; $1380 dcp (zp,x), 8 cycles
+	align 32
+	lda #$81
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lda #$40
+	clc
+	dcp ($f0,x)
+	jmp *
+
+; $13a0 dcp zp, 5 cycles
+	align 32
+	lda #$40
+	sta $f0
+	lda #$01
+	sec
+	dcp $f0
+	jmp *
+
+; $13c0 dcp abs, 6 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$ff
+	clc
+	dcp $2000
+	jmp *
+
+; $13e0 dcp (zp),y, 8 cycles
+	align 32
+	lda #$ff
+	sta $2110
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$20
+	lda #$80
+	sec
+	dcp ($f2),y
+	jmp *
+
+; $1400 dcp zp,x, 6 cycles
+	align 32
+	lda #$7f
+	sta $f0
+	ldx #$10
+	lda #$7f
+	clc
+	dcp $e0,x
+	jmp *
+
+; $1420 dcp abs,y, 7 cycles
+	align 32
+	lda #$80
+	sta $2110
+	ldy #$20
+	lda #$00
+	sec
+	dcp $20f0,y
+	jmp *
+
+; $1440 dcp abs,x, 7 cycles
+	align 32
+	lda #$01
+	sta $2110
+	ldx #$20
+	lda #$35
+	clc
+	dcp $20f0,x
+	jmp *
+
+; $1460 isc (zp,x), 8 cycles
+	align 32
+	lda #$81
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lda #$40
+	clc
+	isc ($f0,x)
+	jmp *
+
+; $1480 isc zp, 5 cycles
+	align 32
+	lda #$40
+	sta $f0
+	lda #$01
+	sec
+	isc $f0
+	jmp *
+
+; $14a0 isc abs, 6 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$ff
+	clc
+	isc $2000
+	jmp *
+
+; $14c0 isc (zp),y, 8 cycles
+	align 32
+	lda #$ff
+	sta $2110
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$20
+	lda #$80
+	sec
+	isc ($f2),y
+	jmp *
+
+; $14e0 isc zp,x, 6 cycles
+	align 32
+	lda #$7f
+	sta $f0
+	ldx #$10
+	lda #$7f
+	clc
+	isc $e0,x
+	jmp *
+
+; $1500 isc abs,y, 7 cycles
+	align 32
+	lda #$80
+	sta $2110
+	ldy #$20
+	lda #$00
+	sec
+	isc $20f0,y
+	jmp *
+
+; $1520 isc abs,x, 7 cycles
+	align 32
+	lda #$01
+	sta $2110
+	ldx #$20
+	lda #$35
+	clc
+	isc $20f0,x
+	jmp *
+
+; $1540 rra zp decimal, 5 cycles
+	align 32
+	lda #$27
+	sta $f0
+	lda #$58
+	sed
+	clc
+	rra $f0
+	jmp *
+
+; $1560 isc zp decimal, 5 cycles
+	align 32
+	lda #$27
+	sta $f0
+	lda #$58
+	sed
+	clc
+	isc $f0
+	jmp *
+
+; $1580 sax (zp,x), 6 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lda #$f0
+	ldx #$02
+	lda #$f3
+	sax ($f0,x)
+	jmp *
+
+; $15a0 sax zp, 3 cycles
+	align 32
+	lda #$00
+	sta $f0
+	lda #$3c
+	ldx #$c3
+	sax $f0
+	jmp *
+
+; $15c0 sax abs, 4 cycles
+	align 32
+	lda #$00
+	sta $2000
+	lda #$81
+	ldx #$83
+	sax $2000
+	jmp *
+
+; $15e0 sax zp,y, 4 cycles
+	align 32
+	lda #$00
+	sta $f0
+	ldy #$10
+	lda #$ff
+	ldx #$00
+	ldx #$a5
+	sax $e0,y
+	jmp *
+
+; $1600 lax (zp,x), 6 cycles
+	align 32
+	lda #$80
+	sta $2000
+	lda #$00
+	sta $f2
+	lda #$20
+	sta $f3
+	ldx #$02
+	lax ($f0,x)
+	jmp *
+
+; $1620 lax zp, 3 cycles
+	align 32
+	lda #$00
+	sta $f0
+	lax $f0
+	jmp *
+
+; $1640 lax abs, 4 cycles
+	align 32
+	lda #$7f
+	sta $2000
+	lax $2000
+	jmp *
+
+; $1660 lax (zp),y, 6 cycles
+	align 32
+	lda #$c1
+	sta $2110
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$20
+	lax ($f2),y
+	jmp *
+
+; $1680 lax zp,y, 4 cycles
+	align 32
+	lda #$01
+	sta $f0
+	ldy #$10
+	lax $e0,y
+	jmp *
+
+; $16a0 lax abs,y, 5 cycles
+	align 32
+	lda #$fe
+	sta $2110
+	ldy #$20
+	lax $20f0,y
+	jmp *
+
+; $16c0 lax abs,y no page crossing, 4 cycles
+	align 32
+	lda #$42
+	sta $20f5
+	ldy #$05
+	lax $20f0,y
+	jmp *
+
+; $16e0 anc #, 2 cycles
+	align 32
+	lda #$81
+	ldx #$3c
+	clc
+	anc #$f0
+	jmp *
+
+; $1700 aac #, 2 cycles
+	align 32
+	lda #$7f
+	ldx #$3c
+	sec
+	aac #$0f
+	jmp *
+
+; $1720 alr #, 2 cycles
+	align 32
+	lda #$ff
+	ldx #$3c
+	clc
+	alr #$81
+	jmp *
+
+; $1740 arr #, 2 cycles
+	align 32
+	lda #$ff
+	ldx #$3c
+	sec
+	arr #$c0
+	jmp *
+
+; $1760 arr #, 2 cycles
+	align 32
+	lda #$7f
+	ldx #$3c
+	clc
+	arr #$3f
+	jmp *
+
+; $1780 axs #, 2 cycles
+	align 32
+	lda #$f0
+	ldx #$3c
+	clc
+	axs #$05
+	jmp *
+
+; $17a0 sbi #, 2 cycles
+	align 32
+	lda #$50
+	ldx #$3c
+	sec
+	sbi #$f0
+	jmp *
+
+; $17c0 arr # decimal, 2 cycles
+	align 32
+	lda #$ff
+	sed
+	sec
+	arr #$9a
+	jmp *
+
+; $17e0 xaa # with a=$ff, 2 cycles
+	align 32
+	lda #$ff
+	ldx #$3c
+	xaa #$a5
+	jmp *
+
+; $1800 lax2 # with a=$ff, 2 cycles
+	align 32
+	lda #$ff
+	lax2 #$a5
+	jmp *
+
+; $1820 las abs,y, 5 cycles
+	align 32
+	lda #$b7
+	sta $2110
+	ldy #$20
+	las $20f0,y
+	jmp *
+
+; $1840 las abs,y no page crossing, 4 cycles
+	align 32
+	lda #$b7
+	sta $20f5
+	ldy #$05
+	las $20f0,y
+	jmp *
+
+; $1860 ahx (zp),y, 6 cycles
+	align 32
+	lda #$f0
+	sta $f2
+	lda #$20
+	sta $f3
+	ldy #$05
+	lda #$ff
+	ldx #$3f
+	ahx ($f2),y
+	jmp *
+
+; $1880 ahx abs,y, 5 cycles
+	align 32
+	ldy #$05
+	lda #$f7
+	ldx #$3f
+	ahx $20f0,y
+	jmp *
+
+; $18a0 shx abs,y, 5 cycles
+	align 32
+	ldy #$05
+	ldx #$ff
+	shx $20f0,y
+	jmp *
+
+; $18c0 shy abs,x, 5 cycles
+	align 32
+	ldx #$05
+	ldy #$ff
+	shy $20f0,x
+	jmp *
+
+; $18e0 shy abs,x crossing a page, 5 cycles
+	align 32
+	ldx #$20
+	ldy #$01
+	shy $20f0,x
+	jmp *
+
+; $1900 tas abs,y, 5 cycles
+	align 32
+	ldy #$05
+	lda #$f3
+	ldx #$3f
+	tas $20f0,y
+	jmp *
+
+; $1920 nop $1a, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $1a	; nop
+	jmp *
+
+; $1940 nop $3a, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $3a	; nop
+	jmp *
+
+; $1960 nop $5a, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $5a	; nop
+	jmp *
+
+; $1980 nop $7a, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $7a	; nop
+	jmp *
+
+; $19a0 nop $da, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $da	; nop
+	jmp *
+
+; $19c0 nop $fa, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $fa	; nop
+	jmp *
+
+; $19e0 nop $80 #, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $80, $55	; nop #$55
+	jmp *
+
+; $1a00 nop $82 #, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $82, $55	; nop #$55
+	jmp *
+
+; $1a20 nop $89 #, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $89, $55	; nop #$55
+	jmp *
+
+; $1a40 nop $c2 #, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $c2, $55	; nop #$55
+	jmp *
+
+; $1a60 nop $e2 #, 2 cycles
+	align 32
+	lda #$5a
+	dc.b $e2, $55	; nop #$55
+	jmp *
+
+; $1a80 nop $04 zp, 3 cycles
+	align 32
+	lda #$5a
+	dc.b $04, $f0	; nop $f0
+	jmp *
+
+; $1aa0 nop $44 zp, 3 cycles
+	align 32
+	lda #$5a
+	dc.b $44, $f0	; nop $f0
+	jmp *
+
+; $1ac0 nop $64 zp, 3 cycles
+	align 32
+	lda #$5a
+	dc.b $64, $f0	; nop $f0
+	jmp *
+
+; $1ae0 nop $14 zp,x, 4 cycles
+	align 32
+	ldx #$10
+	lda #$5a
+	dc.b $14, $e0	; nop $e0,x
+	jmp *
+
+; $1b00 nop $34 zp,x, 4 cycles
+	align 32
+	ldx #$10
+	lda #$5a
+	dc.b $34, $e0	; nop $e0,x
+	jmp *
+
+; $1b20 nop $54 zp,x, 4 cycles
+	align 32
+	ldx #$10
+	lda #$5a
+	dc.b $54, $e0	; nop $e0,x
+	jmp *
+
+; $1b40 nop $74 zp,x, 4 cycles
+	align 32
+	ldx #$10
+	lda #$5a
+	dc.b $74, $e0	; nop $e0,x
+	jmp *
+
+; $1b60 nop $d4 zp,x, 4 cycles
+	align 32
+	ldx #$10
+	lda #$5a
+	dc.b $d4, $e0	; nop $e0,x
+	jmp *
+
+; $1b80 nop $f4 zp,x, 4 cycles
+	align 32
+	ldx #$10
+	lda #$5a
+	dc.b $f4, $e0	; nop $e0,x
+	jmp *
+
+; $1ba0 nop $0c abs, 4 cycles
+	align 32
+	lda #$5a
+	dc.b $0c, $00, $20	; nop $2000
+	jmp *
+
+; $1bc0 nop $1c abs,x, 5 cycles
+	align 32
+	ldx #$20
+	lda #$5a
+	dc.b $1c, $f0, $20	; nop $20f0,x
+	jmp *
+
+; $1be0 nop $3c abs,x, 5 cycles
+	align 32
+	ldx #$20
+	lda #$5a
+	dc.b $3c, $f0, $20	; nop $20f0,x
+	jmp *
+
+; $1c00 nop $5c abs,x, 5 cycles
+	align 32
+	ldx #$20
+	lda #$5a
+	dc.b $5c, $f0, $20	; nop $20f0,x
+	jmp *
+
+; $1c20 nop $7c abs,x, 5 cycles
+	align 32
+	ldx #$20
+	lda #$5a
+	dc.b $7c, $f0, $20	; nop $20f0,x
+	jmp *
+
+; $1c40 nop $dc abs,x, 5 cycles
+	align 32
+	ldx #$20
+	lda #$5a
+	dc.b $dc, $f0, $20	; nop $20f0,x
+	jmp *
+
+; $1c60 nop $fc abs,x, 5 cycles
+	align 32
+	ldx #$20
+	lda #$5a
+	dc.b $fc, $f0, $20	; nop $20f0,x
+	jmp *
+
+; $1c80 nop $1c abs,x no page crossing, 4 cycles
+	align 32
+	ldx #$05
+	lda #$5a
+	dc.b $1c, $f0, $20	; nop $20f0,x
+	jmp *
+
+; $1ca0 jam $02
+	align 32
+	lda #$11
+	dc.b $02	; jam
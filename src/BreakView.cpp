@@ -4,14 +4,19 @@
 #include "BreakView.h"
 #include "machine.h"
 #include "Config.h"
+#include "Expressions.h"
+#include "ImGui_Helper.h"
 
-BreakView::BreakView() : open(false)
+BreakView::BreakView() : open(false), watchValue(0), watchCycles(0), numWatchWrites(-1)
 {
+	watchAddress[0] = 0;
+	reverseCond[0] = 0;
 }
 
 void BreakView::WriteConfig(UserData& config)
 {
 	config.AddValue(strref("open"), config.OnOff(open));
+	if (watchAddress[0]) { config.AddValue(strref("reverseWatch"), strref(watchAddress)); }
 }
 
 void BreakView::ReadConfig(strref config)
@@ -22,10 +27,27 @@ void BreakView::ReadConfig(strref config)
 		ConfigParseType type = conf.Next(&name, &value);
 		if (name.same_str("open") && type == CPT_Value) {
 			open = !value.same_str("Off");
+		} else if (name.same_str("reverseWatch") && type == CPT_Value) {
+			strovl addr(watchAddress, sizeof(watchAddress));
+			addr.copy(value);
+			addr.c_str();
+			watchValue = (uint16_t)ValueFromExpression(watchAddress);
 		}
 	}
 }
 
+// hit counts are kept by the local breakpoints, also while VICE is connected
+static void AppendHits(strown<64> &desc, uint32_t id)
+{
+	BreakpointHits info;
+	if (GetBPHits(id, info)) {
+		desc.sprintf_append(" #%u hits %u", id, info.hits);
+		if (info.ignore) { desc.sprintf_append(" ign %u", info.ignore); }
+		if (info.every > 1) { desc.sprintf_append(" every %u", info.every); }
+		if (info.temporary) { desc.append(" temp"); }
+	}
+}
+
 void BreakView::Draw()
 {
 	if (!open) { return; }
@@ -39,14 +61,17 @@ void BreakView::Draw()
 	int numBP = GetNumBreakpoints();
 	const ViceBP* bp = GetBreakpoints();
 
+	uint16_t *BPAddr;
+	uint32_t *BPID;
+	uint16_t nDS;
+	uint16_t nSB_BP = GetPCBreakpointsID(&BPAddr, &BPID, nDS);
 	if (numBP == 0) {
-		uint16_t nSB_BP = GetNumPCBreakpoints();
-		uint16_t* BPAddr = GetPCBreakpoints();
 		for (uint16_t b = 0; b < nSB_BP; ++b) {
 			strown<64> desc;
 			uint16_t bk = BPAddr[b];
 			desc.append("BREAK");
 			desc.append(": $").append_num(bk, 4, 16);
+			AppendHits(desc, BPID[b]);
 			ImGui::Text(desc.c_str());
 		}
 	}
@@ -65,8 +90,53 @@ void BreakView::Draw()
 			desc.append("-$").append_num(bk.end, 4, 16);
 		}
 		if (bk.viceIndex >= 0) { desc.sprintf_append(" (%d)", bk.viceIndex); }
+		if (bk.type == VBP_Break) {
+			for (uint16_t s = 0; s < nSB_BP + nDS; ++s) {
+				if (BPAddr[s] == bk.address) { AppendHits(desc, BPID[s]); break; }
+			}
+		}
+		ImGui::Text(desc.c_str());
+	}
+
+	const Tracepoint* tp = GetTracepoints();
+	for (int t = 0, n = GetNumTracepoints(); t < n; ++t) {
+		strown<192> desc("TRACE: $");
+		desc.append_num(tp[t].pc, 4, 16).append(' ').append(tp[t].text);
 		ImGui::Text(desc.c_str());
 	}
 
+	ImGui::Separator();
+	ImGui::Text("Reverse watch");
+	if (ImGui::InputText("address", watchAddress, sizeof(watchAddress), ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback)) {
+		watchValue = (uint16_t)ValueFromExpression(watchAddress);
+		numWatchWrites = -1;
+	}
+	if (watchAddress[0] && !IsCPURunning()) {
+		// the undo history only changes when the cpu moves
+		if (numWatchWrites < 0 || watchCycles != GetCycles()) {
+			numWatchWrites = FindHistoryWrites(watchValue, watchWrites, MaxWatchWrites);
+			watchCycles = GetCycles();
+		}
+		if (ImGui::Button("Step back to write") && !CPUReverseToWrite(watchValue)) { numWatchWrites = 0; }
+		for (int w = 0; w < numWatchWrites; ++w) {
+			const UndoWrite &write = watchWrites[w];
+			ImGui::Text("%6u back: $%04x $%02x -> $%02x", write.stepsBack, write.pc, write.before, write.after);
+		}
+		if (!numWatchWrites) { ImGui::Text("No writes to $%04x in the history", watchValue); }
+	}
+	if (!IsCPURunning()) {
+		ImGui::InputText("condition", reverseCond, sizeof(reverseCond), ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback);
+		if (reverseCond[0] && ImGui::Button("Reverse until condition")) {
+			uint8_t rpn[512];
+			BuildExpression(reverseCond, rpn, sizeof(rpn));
+			ReverseStop stop;
+			stop.start = stop.end = 0;
+			stop.writes = false;
+			stop.breakpoints = true;
+			stop.cond = rpn;
+			CPUReverseUntil(stop);
+		}
+	}
+
 	ImGui::End();
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 struct UserData;
+#include "machine.h"
 
 struct BreakView
 {
@@ -10,5 +11,14 @@ struct BreakView
 	void Draw();
 
 	bool open;
+
+	// reverse watch lists the most recent writes to an address in the undo history
+	enum { MaxWatchWrites = 16 };
+	char watchAddress[64];
+	uint16_t watchValue;
+	uint32_t watchCycles;	// cycle count the write list was found at
+	int numWatchWrites;
+	UndoWrite watchWrites[MaxWatchWrites];
+	char reverseCond[128];	// reverse-continue until this expression is true
 };
 
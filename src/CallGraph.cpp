@@ -0,0 +1,225 @@
+// Shadow call stack following JSR/RTS/RTI and interrupts, accumulating
+// inclusive cycles per call path for flame graphs
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "struse/struse.h"
+#include "HashTable.h"
+#include "machine.h"
+#include "sym.h"
+#include "CallGraph.h"
+
+#define CALL_STACK_DEPTH 256
+
+enum CallKind {
+	CK_Root,
+	CK_Call,
+	CK_IRQ,
+	CK_NMI,
+	CK_BRK
+};
+
+// one node per unique call path, node 0 is the root ("main")
+struct CallNode {
+	uint32_t parent;
+	uint16_t addr;
+	uint8_t kind;
+	uint32_t calls;
+	uint32_t maxCycles;		// longest single call
+	uint64_t cycles;		// inclusive cycles of completed calls
+};
+
+struct CallFrame {
+	uint32_t node;
+	uint32_t enter;			// cycle count when entered
+	uint8_t sp;				// stack pointer before return address was pushed
+};
+
+static std::vector<CallNode> sNodes;
+static HashTable<uint32_t> sChildren;	// (parent, kind, address) => node
+static CallFrame sStack[CALL_STACK_DEPTH];
+static int sDepth = 0;
+static uint32_t sFirstCycle = 0;
+static uint32_t sLastCycle = 0;
+static bool sStarted = false;
+static bool sEnabled = false;
+
+void ResetCallGraph()
+{
+	sNodes.clear();
+	sChildren.Clear();
+	CallNode root = { 0, 0, CK_Root, 1, 0, 0 };
+	sNodes.push_back(root);
+	sDepth = 0;
+	sStarted = false;
+}
+
+void EnableCallGraph(bool enable)
+{
+	if (enable && !sNodes.size()) { ResetCallGraph(); }
+	sEnabled = enable;
+}
+
+bool IsCallGraphEnabled()
+{
+	return sEnabled;
+}
+
+void ShutdownCallGraph()
+{
+	sEnabled = false;
+	sNodes.clear();
+	sNodes.shrink_to_fit();
+	sChildren.Clear();
+}
+
+static void CallEnter(uint8_t kind, uint16_t addr, uint8_t sp, uint32_t cycle)
+{
+	// calls nested deeper than the shadow stack are counted towards the deepest frame
+	if (sDepth == CALL_STACK_DEPTH) { return; }
+
+	uint32_t parent = sDepth ? sStack[sDepth - 1].node : 0;
+	uint64_t key = (uint64_t(parent + 1) << 24) | (uint64_t(kind) << 16) | addr;
+	uint32_t node;
+	if (uint32_t *found = sChildren.Value(key)) {
+		node = *found;
+	} else {
+		node = (uint32_t)sNodes.size();
+		CallNode call = { parent, addr, kind, 0, 0, 0 };
+		sNodes.push_back(call);
+		sChildren.Insert(key, node);
+	}
+	++sNodes[node].calls;
+	CallFrame &frame = sStack[sDepth++];
+	frame.node = node;
+	frame.enter = cycle;
+	frame.sp = sp;
+}
+
+// any frame with a return address above the stack pointer has returned
+static void CallLeave(uint8_t sp, uint32_t cycle)
+{
+	while (sDepth && sStack[sDepth - 1].sp <= sp) {
+		const CallFrame &frame = sStack[--sDepth];
+		CallNode &node = sNodes[frame.node];
+		uint32_t spent = cycle - frame.enter;
+		node.cycles += spent;
+		if (spent > node.maxCycles) { node.maxCycles = spent; }
+	}
+}
+
+void CallGraphStep(uint8_t op, const Regs &before, const Regs &after, uint32_t cycle)
+{
+	if (!sStarted) {
+		sFirstCycle = cycle - after.T;
+		sStarted = true;
+	}
+	sLastCycle = cycle;
+	switch (op) {
+		case 0x20:	// jsr, includes the cycles of the jsr itself
+			CallEnter(CK_Call, after.PC, before.S, cycle - after.T);
+			break;
+		case 0x00:	// brk
+			CallEnter(CK_BRK, after.PC, before.S, cycle - after.T);
+			break;
+		case 0x40:	// rti
+		case 0x60:	// rts
+		case 0x9a:	// txs
+			CallLeave(after.S, cycle);
+			break;
+	}
+}
+
+void CallGraphInterrupt(const Regs &before, const Regs &after, uint32_t cycle, bool nmi)
+{
+	// masked irq leaves the registers unchanged
+	if (before.S != after.S) {
+		if (!sStarted) {
+			sFirstCycle = cycle;
+			sStarted = true;
+		}
+		CallEnter(nmi ? CK_NMI : CK_IRQ, after.PC, before.S, cycle);
+	}
+}
+
+static void CallPath(uint32_t node, strown<4096> &path)
+{
+	uint32_t chain[CALL_STACK_DEPTH];
+	int depth = 0;
+	while (node && depth < CALL_STACK_DEPTH) {
+		chain[depth++] = node;
+		node = sNodes[node].parent;
+	}
+	path.copy("main");
+	while (depth) {
+		const CallNode &call = sNodes[chain[--depth]];
+		path.append(';');
+		switch (call.kind) {
+			case CK_IRQ: path.append("irq;"); break;
+			case CK_NMI: path.append("nmi;"); break;
+			case CK_BRK: path.append("brk;"); break;
+		}
+		if (const char *name = GetSymbol(call.addr)) { path.append(name); }
+		else { path.append('$').append_num(call.addr, 4, 16); }
+	}
+}
+
+// inclusive cycles per node, including frames that are still on the shadow stack
+static void InclusiveCycles(std::vector<uint64_t> &incl)
+{
+	incl.resize(sNodes.size());
+	for (size_t n = 0, e = sNodes.size(); n < e; ++n) { incl[n] = sNodes[n].cycles; }
+	for (int f = 0; f < sDepth; ++f) { incl[sStack[f].node] += sLastCycle - sStack[f].enter; }
+	incl[0] = sStarted ? (sLastCycle - sFirstCycle) : 0;
+}
+
+bool SaveCallGraph(const char *filename)
+{
+	if (!sNodes.size()) { return false; }
+
+	std::vector<uint64_t> incl, self;
+	InclusiveCycles(incl);
+	self = incl;
+	for (size_t n = 1, e = sNodes.size(); n < e; ++n) {
+		uint32_t parent = sNodes[n].parent;
+		self[parent] = self[parent] > incl[n] ? (self[parent] - incl[n]) : 0;
+	}
+
+	FILE *f;
+	if (fopen_s(&f, filename, "w") != 0 || !f) { return false; }
+	strown<4096> path;
+	for (size_t n = 0, e = sNodes.size(); n < e; ++n) {
+		if (self[n]) {
+			CallPath((uint32_t)n, path);
+			fprintf(f, "%s %llu\n", path.c_str(), (unsigned long long)self[n]);
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+int ReportCallGraph(int maxPaths, CallGraphReport report, void *user)
+{
+	if (sNodes.size() < 2) { return 0; }
+
+	std::vector<uint64_t> incl;
+	InclusiveCycles(incl);
+	std::vector<uint32_t> order;
+	for (uint32_t n = 1, e = (uint32_t)sNodes.size(); n < e; ++n) { order.push_back(n); }
+	std::sort(order.begin(), order.end(), [](uint32_t a, uint32_t b) {
+		return sNodes[a].maxCycles > sNodes[b].maxCycles;
+	});
+
+	int count = 0;
+	strown<4096> path;
+	for (size_t i = 0; i < order.size() && count < maxPaths; ++i, ++count) {
+		const CallNode &call = sNodes[order[i]];
+		CallPath(order[i], path);
+		report(path.c_str(), call.calls, incl[order[i]], call.maxCycles, user);
+	}
+	return count;
+}
@@ -0,0 +1,22 @@
+#pragma once
+// Shadow call stack following JSR/RTS/RTI and interrupts, accumulating
+// inclusive cycles per call path for flame graphs
+#include <stdint.h>
+
+struct Regs;
+
+void EnableCallGraph(bool enable);
+bool IsCallGraphEnabled();
+void ResetCallGraph();
+void ShutdownCallGraph();
+
+// called by the emulator after an instruction or interrupt was processed
+void CallGraphStep(uint8_t op, const Regs &before, const Regs &after, uint32_t cycle);
+void CallGraphInterrupt(const Regs &before, const Regs &after, uint32_t cycle, bool nmi);
+
+// collapsed stack format, one "main;irq;music_play 1234" line per call path
+bool SaveCallGraph(const char *filename);
+
+// call paths sorted by most cycles spent in a single call, returns number written
+typedef void(*CallGraphReport)(const char *path, uint32_t calls, uint64_t cycles, uint32_t maxCycles, void *user);
+int ReportCallGraph(int maxPaths, CallGraphReport report, void *user);
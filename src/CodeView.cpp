@@ -97,7 +97,7 @@ void CodeView::Draw(int index)
 	const Regs& regs = GetRegs();	// current registers
 
 	// input text for address field
-	if (ImGui::InputText("address", address, sizeof(address), ImGuiInputTextFlags_EnterReturnsTrue)) {
+	if (ImGui::InputText("address", address, sizeof(address), ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback)) {
 		fixedAddress = address[0]=='=';
 		SetAddr(ValueFromExpression(address+(fixedAddress ? 1 : 0)));
 	} else if (evalAddress||(fixedAddress && MemoryChange())) {
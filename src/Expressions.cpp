@@ -4,6 +4,8 @@
 #include <inttypes.h>
 #include "machine.h"
 #include "sym.h"
+#include "struse/struse.h"
+#include <string.h>
 
 // These are expression tokens in order of precedence (last is highest precedence)
 
@@ -258,11 +260,10 @@ uint32_t BuildExpression(const char *Expr, uint8_t *ops, uint32_t max_ops)
 }
 
 #define MAX_EXPR_VALUE_DEPTH 32
-int EvalExpression(const uint8_t *RPN)
+int EvalExpression(const uint8_t *RPN, const Regs &r, CBGetByte read, void *user)
 {
 	int values[MAX_EXPR_VALUE_DEPTH];
 	int i = 0;
-	const Regs &r = GetRegs();
 	bool err = false;
 
 	while (!err && *RPN) {
@@ -284,12 +285,12 @@ int EvalExpression(const uint8_t *RPN)
 			case EO_FL: values[i++] = r.P; break;
 			case EO_BYTE:			// read byte from memory
 				if (!(err = i<1))
-					values[i-1] = Get6502Byte((uint16_t)values[i-1]);
+					values[i-1] = read((uint16_t)values[i-1], user);
 				break;
 			case EO_2BYTE:			// read byte from memory
 				if (!(err = i<1))
-					values[i-1] = Get6502Byte((uint16_t)values[i-1]) +
-						((uint16_t)Get6502Byte(uint16_t(values[i-1]+1))<<8);
+					values[i-1] = read((uint16_t)values[i-1], user) +
+						((uint16_t)read(uint16_t(values[i-1]+1), user)<<8);
 				break;
 			case EO_EQU:				// 1 if left equal to right otherwise 0
 				if (!(err = i<2)) {
@@ -411,9 +412,114 @@ int EvalExpression(const uint8_t *RPN)
 	return (err || i!=1) ? 0 : values[0];
 }
 
+static uint8_t EvalGetByte(uint16_t addr, void *user)
+{
+	return Get6502Byte(addr);
+}
+
+int EvalExpression(const uint8_t *RPN)
+{
+	return EvalExpression(RPN, GetRegs(), EvalGetByte, nullptr);
+}
+
+// Compiled expressions by source text. An entry remembers the bytes it read
+// and the registers it used so evaluating it again is a compare of those
+// inputs unless they or the symbols changed.
+#define EXPR_CACHE_SIZE 64
+#define EXPR_CACHE_TEXT 64
+#define EXPR_CACHE_OPS 128
+#define EXPR_CACHE_DEPS 8
+#define EXPR_DEPS_UNTRACKED 0xff
+
+struct ExprCacheEntry {
+	uint64_t hash;
+	uint32_t symbolGen;
+	uint32_t lastUse;
+	int value;
+	bool usesRegs;
+	uint8_t numDeps;	// bytes read by the last evaluation or EXPR_DEPS_UNTRACKED
+	Regs regs;
+	uint16_t depAddr[EXPR_CACHE_DEPS];
+	uint8_t depValue[EXPR_CACHE_DEPS];
+	char text[EXPR_CACHE_TEXT];
+	uint8_t ops[EXPR_CACHE_OPS];
+};
+
+static ExprCacheEntry sExprCache[EXPR_CACHE_SIZE];
+static uint32_t sExprCacheUse = 0;
+
+static uint8_t ExprCacheGetByte(uint16_t addr, void *user)
+{
+	ExprCacheEntry *entry = (ExprCacheEntry*)user;
+	uint8_t value = Get6502Byte(addr);
+	if (entry->numDeps < EXPR_CACHE_DEPS) {
+		entry->depAddr[entry->numDeps] = addr;
+		entry->depValue[entry->numDeps++] = value;
+	} else
+		entry->numDeps = EXPR_DEPS_UNTRACKED;
+	return value;
+}
+
+// true if the bytecode reads any cpu register
+bool ExpressionUsesRegs(const uint8_t *ops)
+{
+	while (uint8_t op = *ops++) {
+		if (op == EO_VAL8) { ops++; }
+		else if (op == EO_VAL16) { ops += 2; }
+		else if (op >= EO_PC && op <= EO_FL) { return true; }
+	}
+	return false;
+}
+
+static bool ExprCacheCurrent(const ExprCacheEntry &entry)
+{
+	if (entry.symbolGen != GetSymbolGeneration() || entry.numDeps == EXPR_DEPS_UNTRACKED)
+		return false;
+	if (entry.usesRegs) {
+		Regs regs = entry.regs;
+		if (regs != GetRegs()) { return false; }
+	}
+	for (uint8_t d = 0; d < entry.numDeps; ++d) {
+		if (Get6502Byte(entry.depAddr[d]) != entry.depValue[d]) { return false; }
+	}
+	return true;
+}
+
 int ValueFromExpression( const char* exp )
 {
-	uint8_t ops[128];
-	BuildExpression(exp, ops, sizeof(ops));
-	return EvalExpression( ops );
+	size_t len = strlen(exp);
+	if (len >= EXPR_CACHE_TEXT) {
+		uint8_t ops[128];
+		BuildExpression(exp, ops, sizeof(ops));
+		return EvalExpression( ops );
+	}
+
+	uint64_t hash = strref(exp, (strl_t)len).fnv1a_64();
+	ExprCacheEntry *entry = nullptr, *oldest = sExprCache;
+	for (int e = 0; e < EXPR_CACHE_SIZE; ++e) {
+		ExprCacheEntry &slot = sExprCache[e];
+		if (slot.lastUse && slot.hash == hash && !strcmp(slot.text, exp)) {
+			entry = &slot;
+			break;
+		}
+		if (slot.lastUse < oldest->lastUse) { oldest = &slot; }
+	}
+	if (entry && ExprCacheCurrent(*entry)) {
+		entry->lastUse = ++sExprCacheUse;
+		return entry->value;
+	}
+
+	if (!entry || entry->symbolGen != GetSymbolGeneration()) {
+		entry = entry ? entry : oldest;
+		entry->hash = hash;
+		memcpy(entry->text, exp, len + 1);
+		entry->symbolGen = GetSymbolGeneration();
+		BuildExpression(exp, entry->ops, sizeof(entry->ops));
+		entry->usesRegs = ExpressionUsesRegs(entry->ops);
+	}
+	entry->lastUse = ++sExprCacheUse;
+	entry->regs = GetRegs();
+	entry->numDeps = 0;
+	entry->value = EvalExpression(entry->ops, entry->regs, ExprCacheGetByte, entry);
+	return entry->value;
 }
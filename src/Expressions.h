@@ -1,5 +1,9 @@
 #pragma once
+struct Regs;
+typedef uint8_t(*CBGetByte)(uint16_t addr, void *user);
 
 uint32_t BuildExpression(const char *Expr, uint8_t *ops, uint32_t max_ops);
 int EvalExpression(const uint8_t *RPN);
+int EvalExpression(const uint8_t *RPN, const Regs &r, CBGetByte read, void *user);	// evaluate against a specific machine state
 int ValueFromExpression( const char* exp );
+bool ExpressionUsesRegs(const uint8_t *RPN);
@@ -13,6 +13,9 @@
 #include "SourceDebug.h"
 #include "ViceConnect.h"
 #include "platform.h"
+#include "TextFile.h"
+#include "FileDialog.h"
+#include <chrono>
 
 #define FILE_LOAD_THREAD_STACK 8192
 
@@ -34,6 +37,26 @@ static bool binForceAddress;
 static bool binLoadResetUndo;
 static char binLoadFilename[MAX_PATH];
 
+// hot reload watches the loaded binary and the symbols, listing and debug
+// info that were loaded with it. A changed binary is compared with memory
+// and only the bytes that differ are written and sent to VICE.
+enum WatchFile {
+	WATCH_BINARY,
+	WATCH_SYMBOLS,
+	WATCH_VICE_COMMANDS,
+	WATCH_LISTING,
+	WATCH_KICK_DEBUG,
+	WATCH_COUNT
+};
+
+static bool sHotReload = true;
+static IBFileWatch* sFileWatch = nullptr;
+static bool sFileWatchDirty = false;
+static char sWatchFilenames[WATCH_COUNT][MAX_PATH];
+static uint64_t sWatchHash[WATCH_COUNT];	// text files are skipped if unchanged, 0 = not read yet
+static bool sWatchPending[WATCH_COUNT];
+static HotReloadStats sHotReloadStats;
+
 
 bool IsFileDialogOpen() { return sFileDialogOpen; }
 bool IsFileLoadReady() { return sFileLoadReady; }
@@ -123,6 +146,7 @@ void BinFileWriteConfig( UserData& config )
 	config.AddValue( strref( "binForceAddress" ), config.OnOff( binForceAddress ) );
 	config.AddValue( strref( "binLoadResetUndo" ), config.OnOff( binLoadResetUndo ) );
 	config.AddValue( strref( "binLoadFilename" ), binLoadFilename );
+	config.AddValue( strref( "hotReload" ), config.OnOff( sHotReload ) );
 }
 
 void BinFileReadConfig( strref config )
@@ -143,6 +167,8 @@ void BinFileReadConfig( strref config )
 			binForceAddress = !value.same_str( "Off" );
 		} else if( name.same_str("binLoadResetUndo") && type == CPT_Value ) {
 			binLoadResetUndo = !value.same_str( "Off" );
+		} else if( name.same_str("hotReload") && type == CPT_Value ) {
+			sHotReload = !value.same_str( "Off" );
 		} else if( name.same_str("binLoadFilename") && type == CPT_Value ) {
 			strovl name( binLoadFilename, MAX_PATH );
 			name.copy( value );
@@ -151,46 +177,78 @@ void BinFileReadConfig( strref config )
 }
 
 
-IBThreadRet LoadBinaryThread(void* params)
+// reads the bytes of a binary that fit in memory from address, the same
+// rules as LoadBinaryFile. free() the returned buffer.
+static uint8_t* ReadBinaryFile( const char* filename, int filetype, int& address, bool forceAddress, size_t& read )
 {
-	(void)params;
 	FILE *f = nullptr;
+	if( fopen_s( &f, filename, "rb" ) != 0 || !f ) {
+		return nullptr;
+	}
 
-	if( fopen_s( &f, binLoadFilename, "rb" ) == 0 ) {
-		// assume .prg for now
-		fseek( f, 0, SEEK_END );
-		size_t size = ftell( f );
-		fseek( f, 0, SEEK_SET );
+	fseek( f, 0, SEEK_END );
+	size_t size = ftell( f );
+	fseek( f, 0, SEEK_SET );
 
-		if( binFiletype == 0 || binFiletype == 1 ) {
-			int8_t addr8[ 2 ];
+	if( filetype == 0 || filetype == 1 ) {
+		uint8_t addr8[ 2 ] = {};
+		fread( addr8, 1, 2, f );
+		size_t addr = addr8[ 0 ] + (uint16_t( addr8[ 1 ] ) << 8);
+		size = size > 2 ? (size - 2) : 0;
+		if( filetype == 1 ) {
 			fread( addr8, 1, 2, f );
-			size_t addr = addr8[ 0 ] + (uint16_t( addr8[ 1 ] ) << 8);
-			size -= 2;
-			if( binFiletype == 1 ) {
-				fread( addr8, 1, 2, f );
-				size = addr8[ 0 ] + (uint16_t( addr8[ 1 ] ) << 8);
-			}
-			if( !binForceAddress )
-				binAddress = (int)addr;
+			size = addr8[ 0 ] + (uint16_t( addr8[ 1 ] ) << 8);
 		}
+		if( !forceAddress )
+			address = (int)addr;
+	}
 
-		size_t read = size < size_t( 0x10000 - binAddress ) ?
-			size : size_t( 0x10000 - binAddress );
+	read = size < size_t( 0x10000 - address ) ?
+		size : size_t( 0x10000 - address );
 
-		uint8_t *trg = Get6502Mem( (uint16_t)binAddress );
-		fread( trg, read, 1, f );
+	uint8_t *buf = (uint8_t*)malloc( read ? read : 1 );
+	if( !buf ) {
 		fclose( f );
+		return nullptr;
+	}
+	read = fread( buf, 1, read, f );
+	fclose( f );
+	return buf;
+}
+
+// loads a binary into a machine. filetype 0 is a .prg with a load address,
+// 1 is a .prg followed by a size and 2 is raw data loaded at address.
+// startAddr is the load address, or the SYS address of a basic line at $0801
+bool LoadBinaryFile( Machine& machine, const char* filename, int filetype, int& address, bool forceAddress, uint16_t& startAddr )
+{
+	size_t read;
+	uint8_t *buf = ReadBinaryFile( filename, filetype, address, forceAddress, read );
+	if( !buf ) {
+		return false;
+	}
+	for( size_t b = 0; b < read; ++b ) {
+		machine.SetByte( uint16_t( address + b ), buf[ b ] );
+	}
+	free( buf );
+
+	// if load address == $0801 && file type == 0 && [$0805] == $9e =>
+	// { start address = strref($0806).atoi() }
+	startAddr = (uint16_t)address;
+	if( address == 0x0801 && filetype == 0 && machine.GetByte( 0x0805 ) == 0x9e ) {
+		char sys[ 8 ] = {};
+		for( int c = 0; c < 7; ++c ) { sys[ c ] = (char)machine.GetByte( uint16_t( 0x0806 + c ) ); }
+		startAddr = (uint16_t)strref( sys ).atoi();
+	}
+	return true;
+}
 
+IBThreadRet LoadBinaryThread(void* params)
+{
+	(void)params;
+	uint16_t startAddr;
+	if( LoadBinaryFile( GetMachine(), binLoadFilename, binFiletype, binAddress, binForceAddress, startAddr ) ) {
 		GetRegs().T = 0;
 		if( binLoadSetPC ) {
-			// refinement:
-			// if load address == $0801 && file type == 0 && [$0805] == $9e =>
-			// { start address = strref($0806).atoi() }
-			uint16_t startAddr = binAddress;
-			if( binAddress == 0x0801 && binFiletype == 0 && Get6502Byte( 0x0805 ) == 0x9e ) {
-				startAddr = (uint16_t)strref( (const char*)Get6502Mem( 0x0806 ) ).atoi();
-			}
 			GetRegs().PC = startAddr;
 			FocusPC();
 		}
@@ -207,6 +265,39 @@ IBThreadRet LoadBinaryThread(void* params)
 }
 
 
+static void SetWatchFile( WatchFile file, const char* filename )
+{
+	if( strcmp( sWatchFilenames[ file ], filename ) ) {
+		strovl name( sWatchFilenames[ file ], MAX_PATH );
+		name.copy( filename );
+		name.c_str();
+		sFileWatchDirty = true;
+	}
+	sWatchHash[ file ] = 0;
+	sWatchPending[ file ] = false;
+}
+
+// the symbols ReadSymbolsForBinary picks, .sym if there is one otherwise .vs
+static void WatchBinary( const char* binname )
+{
+	SetWatchFile( WATCH_BINARY, binname );
+	strref origname = strref( binname ).before_last( '.' );
+	if( !origname ) { origname = strref( binname ); }
+	strown<MAX_PATH> symFile( origname );
+	symFile.append( ".sym" );
+	FILE* f = nullptr;
+	if( fopen_s( &f, symFile.c_str(), "rb" ) == 0 && f ) {
+		fclose( f );
+		SetWatchFile( WATCH_SYMBOLS, symFile.c_str() );
+		SetWatchFile( WATCH_VICE_COMMANDS, "" );
+	} else {
+		symFile.copy( origname );
+		symFile.append( ".vs" );
+		SetWatchFile( WATCH_SYMBOLS, "" );
+		SetWatchFile( WATCH_VICE_COMMANDS, symFile.c_str() );
+	}
+}
+
 void LoadBinary( int filetype, int address, bool setPC, bool forceAddress, bool resetUndo )
 {
 	binFiletype = filetype;
@@ -215,12 +306,14 @@ void LoadBinary( int filetype, int address, bool setPC, bool forceAddress, bool
 	binForceAddress = forceAddress;
 	binLoadResetUndo = resetUndo;
 	memcpy( binLoadFilename, sFileNameOpen, MAX_PATH );
+	WatchBinary( binLoadFilename );
 
 	IBCreateThread(&hThreadLoadBinary, FILE_LOAD_THREAD_STACK, LoadBinaryThread, nullptr);
 }
 
 void ReloadBinary()
 {
+	WatchBinary( binLoadFilename );
 	IBCreateThread(&hThreadLoadBinary, FILE_LOAD_THREAD_STACK, LoadBinaryThread, nullptr);
 }
 
@@ -236,6 +329,8 @@ void CheckLoadListing()
 {
 	if( sListLoadReady ) {
 		LoadListing( sFileNameOpen );
+		SetWatchFile( WATCH_LISTING, sFileNameOpen );
+		SetWatchFile( WATCH_KICK_DEBUG, "" );
 		sListLoadReady = false;
 		ResetStartFolder();
 	}
@@ -254,6 +349,8 @@ void CheckLoadKickDebug()
 	if (sKickDebugLoadReady) {
 		ViceSetUpdateSymbols(false);
 		ReadC64DbgSrc(sFileNameOpen);
+		SetWatchFile(WATCH_KICK_DEBUG, sFileNameOpen);
+		SetWatchFile(WATCH_LISTING, "");
 		sKickDebugLoadReady = false;
 		ResetStartFolder();
 	}
@@ -272,6 +369,8 @@ void CheckSymFileLoad()
 	if (sSymFileLoadReady) {
 		ViceSetUpdateSymbols(false);
 		ReadSymbols(sFileNameOpen);
+		SetWatchFile(WATCH_SYMBOLS, sFileNameOpen);
+		SetWatchFile(WATCH_VICE_COMMANDS, "");
 		sSymFileLoadReady = false;
 		ResetStartFolder();
 	}
@@ -289,7 +388,115 @@ void CheckLoadViceCommand()
 {
 	if (sViceCommandLoadReady) {
 		ReadViceCommandFile(sFileNameOpen);
+		SetWatchFile(WATCH_VICE_COMMANDS, sFileNameOpen);
+		SetWatchFile(WATCH_SYMBOLS, "");
 		sViceCommandLoadReady = false;
 		ResetStartFolder();
 	}
 }
+
+void SetHotReload( bool enable )
+{
+	sHotReload = enable;
+	sFileWatchDirty = true;
+}
+
+bool GetHotReload() { return sHotReload; }
+const HotReloadStats& GetHotReloadStats() { return sHotReloadStats; }
+
+// assemblers often write the same symbols again, those files are not reloaded
+static bool WatchTextChanged( WatchFile file )
+{
+	TextFile text;
+	if( !OpenTextFile( text, sWatchFilenames[ file ] ) ) { return false; }
+	uint64_t hash = 14695981039346656037ULL;
+	const uint8_t* data = (const uint8_t*)text.map.data;
+	for( size_t b = 0; b < text.map.size; ++b ) { hash = ( hash ^ data[ b ] ) * 1099511628211ULL; }
+	CloseTextFile( text );
+	bool changed = hash != sWatchHash[ file ];
+	sWatchHash[ file ] = hash;
+	return changed;
+}
+
+// writes the bytes of the binary that differ from memory, runs of changes with
+// short unchanged gaps go to VICE as one range
+static void HotPatchBinary()
+{
+	size_t size;
+	uint8_t* buf = ReadBinaryFile( sWatchFilenames[ WATCH_BINARY ], binFiletype, binAddress, binForceAddress, size );
+	if( !buf ) { return; }
+	uint16_t base = (uint16_t)binAddress;
+	bool vice = ViceConnected();
+	for( size_t b = 0; b < size; ) {
+		if( Get6502Byte( uint16_t( base + b ) ) == buf[ b ] ) { ++b; continue; }
+		size_t end = b + 1;
+		for( size_t e = end, gap = 0; e < size && gap < 8; ++e ) {
+			if( Get6502Byte( uint16_t( base + e ) ) != buf[ e ] ) { end = e + 1; gap = 0; }
+			else { ++gap; }
+		}
+		sHotReloadStats.bytes += Patch6502Mem( uint16_t( base + b ), buf + b, uint32_t( end - b ) );
+		if( vice ) { ViceSetMem( uint16_t( base + b ), buf + b, int( end - b ) ); }
+		++sHotReloadStats.ranges;
+		b = end;
+	}
+	free( buf );
+}
+
+void CheckHotReload()
+{
+	if( sFileWatchDirty ) {
+		IBDestroyFileWatch( sFileWatch );
+		sFileWatch = nullptr;
+		if( sHotReload ) {
+			const char* files[ WATCH_COUNT ];
+			for( int w = 0; w < WATCH_COUNT; ++w ) { files[ w ] = sWatchFilenames[ w ]; }
+			sFileWatch = IBCreateFileWatch( files, WATCH_COUNT );
+		}
+		sFileWatchDirty = false;
+	}
+	if( !sFileWatch ) { return; }
+
+	bool changed[ WATCH_COUNT ];
+	if( IBPollFileWatch( sFileWatch, changed ) ) {
+		for( int w = 0; w < WATCH_COUNT; ++w ) { sWatchPending[ w ] = sWatchPending[ w ] || changed[ w ]; }
+	}
+
+	// the binary load thread also reads symbols and memory can't change under a running cpu,
+	// pending reloads wait for the next frame
+	if( hThreadLoadBinary ) { return; }
+	bool binary = sWatchPending[ WATCH_BINARY ] && !IsCPURunning();
+	if( !binary && !sWatchPending[ WATCH_SYMBOLS ] && !sWatchPending[ WATCH_VICE_COMMANDS ] &&
+		!sWatchPending[ WATCH_LISTING ] && !sWatchPending[ WATCH_KICK_DEBUG ] ) { return; }
+
+	auto start = std::chrono::steady_clock::now();
+	sHotReloadStats.files = 0;
+	sHotReloadStats.bytes = 0;
+	sHotReloadStats.ranges = 0;
+	if( binary ) {
+		HotPatchBinary();
+		sWatchPending[ WATCH_BINARY ] = false;
+		sHotReloadStats.files |= 1 << WATCH_BINARY;
+	}
+	for( int w = WATCH_SYMBOLS; w < WATCH_COUNT; ++w ) {
+		if( !sWatchPending[ w ] ) { continue; }
+		sWatchPending[ w ] = false;
+		if( !WatchTextChanged( (WatchFile)w ) ) { continue; }
+		switch( w ) {
+			case WATCH_SYMBOLS: ViceSetUpdateSymbols( false ); ReadSymbols( sWatchFilenames[ w ] ); break;
+			case WATCH_VICE_COMMANDS: ViceSetUpdateSymbols( false ); ReadViceCommandFile( sWatchFilenames[ w ] ); break;
+			case WATCH_LISTING: LoadListing( sWatchFilenames[ w ] ); break;
+			case WATCH_KICK_DEBUG: ReadC64DbgSrc( sWatchFilenames[ w ] ); break;
+		}
+		sHotReloadStats.files |= 1 << w;
+	}
+	if( sHotReloadStats.files ) {
+		++sHotReloadStats.reloads;
+		sHotReloadStats.micros = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start ).count();
+	}
+}
+
+void ShutdownHotReload()
+{
+	IBDestroyFileWatch( sFileWatch );
+	sFileWatch = nullptr;
+}
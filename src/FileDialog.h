@@ -1,5 +1,7 @@
 #pragma once
 
+class Machine;
+
 void GetStartFolder();
 void ResetStartFolder();
 
@@ -10,6 +12,7 @@ void FileLoadReadyAck();
 const char* GetLoadFilename();
 void LoadBinary( int filetype, int address, bool setPC, bool forceAddress, bool resetUndo );
 void ReloadBinary();
+bool LoadBinaryFile( Machine& machine, const char* filename, int filetype, int& address, bool forceAddress, uint16_t& startAddr );
 
 void BinFileWriteConfig( UserData& config );
 void BinFileReadConfig( strref config );
@@ -24,3 +27,17 @@ void CheckSymFileLoad();
 void LoadViceCommandFileDialog();
 void CheckLoadViceCommand();
 
+// the loaded binary and its symbols, listing or debug info reload when the files change
+struct HotReloadStats {
+	uint32_t reloads;
+	uint32_t files;		// bits: binary, symbols, vice commands, listing, debug info
+	uint32_t bytes;		// bytes of the binary that changed
+	uint32_t ranges;	// memory ranges sent to VICE
+	uint32_t micros;
+};
+
+void SetHotReload( bool enable );
+bool GetHotReload();
+const HotReloadStats& GetHotReloadStats();
+void CheckHotReload();
+void ShutdownHotReload();
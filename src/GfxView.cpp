@@ -9,6 +9,7 @@
 #include "Expressions.h"
 #include "Config.h"
 #include "ViceConnect.h"
+#include "ImGui_Helper.h"
 
 #ifndef _MSC_VER
 #define sprintf_s sprintf
@@ -75,6 +76,7 @@ void GfxView::WriteConfig(UserData& config)
 	config.AddValue(strref("zoom"), zoom);
 	config.AddValue(strref("columns"), columns);
 	config.AddValue(strref("rows"), rows);
+	config.AddValue(strref("heatOverlay"), config.OnOff(heatOverlay));
 }
 
 void GfxView::ReadConfig(strref config)
@@ -134,6 +136,9 @@ void GfxView::ReadConfig(strref config)
 		} else if (name.same_str("rows") && type == CPT_Value) {
 			rows = (int)value.atoi();
 			reeval = true;
+		} else if (name.same_str("heatOverlay") && type == CPT_Value) {
+			heatOverlay = !value.same_str("Off");
+			if (heatOverlay) { EnableHeatmap(true); }
 		}
 	}
 }
@@ -167,21 +172,21 @@ void GfxView::Draw(int index)
 		if (displayMode != C64_Current) {
 			name.copy("screen##");
 			name.append_num(index + 1, 1, 10);
-			if (ImGui::InputText(name.c_str(), address_screen, sizeof(address_screen))) {
+			if (ImGui::InputText(name.c_str(), address_screen, sizeof(address_screen), ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback)) {
 				addrScreenValue = ValueFromExpression(address_screen);
 				redraw = true;
 			}
 			ImGui::NextColumn();
 			name.copy("chars##");
 			name.append_num(index + 1, 1, 10);
-			if (ImGui::InputText(name.c_str(), address_gfx, sizeof(address_gfx))) {
+			if (ImGui::InputText(name.c_str(), address_gfx, sizeof(address_gfx), ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback)) {
 				addrGfxValue = ValueFromExpression(address_gfx);
 				redraw = true;
 			}
 			ImGui::NextColumn();
 			name.copy("color##");
 			name.append_num(index + 1, 1, 10);
-			if (ImGui::InputText(name.c_str(), address_col, sizeof(address_col))) {
+			if (ImGui::InputText(name.c_str(), address_col, sizeof(address_col), ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback)) {
 				addrColValue = ValueFromExpression(address_col);
 				redraw = true;
 			}
@@ -216,6 +221,13 @@ void GfxView::Draw(int index)
 		name.copy("zoom##");
 		name.append_num(index + 1, 1, 10);
 		ImGui::Combo(name.c_str(), &zoom, "Pixel\0Double\0Quad\0Fit X\0Fit Y\0Fit Window\0\0");
+		ImGui::SameLine();
+		name.copy("heat##");
+		name.append_num(index + 1, 1, 10);
+		if (ImGui::Checkbox(name.c_str(), &heatOverlay)) {
+			if (heatOverlay) { EnableHeatmap(true); }
+			redraw = true;
+		}
 
 //		bool modeOpt = displayMode == C64_Bitmap || displayMode == C64_Text || displayMode == C64_Sprites;
 
@@ -361,6 +373,8 @@ void GfxView::Create8bppBitmap()
 		case Apl2_HR_Col: CreateApple2HiresColorBitmap(d, linesHigh, w, c64pal); break;
 	}
 
+	if (heatOverlay && IsHeatmapEnabled()) { ApplyHeatOverlay(d, cl, rw); }
+
 	if (!texture) { texture = CreateTexture(); }
 	if (texture) {
 		SelectTexture(texture);
@@ -368,6 +382,98 @@ void GfxView::Create8bppBitmap()
 	}
 }
 
+// recently written pixels are tinted red, fading out over this many cycles
+#define GfxHeatCycles 1000000
+
+static uint32_t MinWriteAge(uint32_t age, uint16_t addr)
+{
+	uint32_t a = GetHeatAge(addr, HEAT_WRITE);
+	return a < age ? a : age;
+}
+
+// finds the bytes each 8 pixel span was generated from and tints the span
+// if any of them were written recently
+void GfxView::ApplyHeatOverlay(uint32_t* d, uint32_t cl, uint32_t rw)
+{
+	int mode = displayMode;
+	uint16_t g = (uint16_t)addrGfxValue, s = (uint16_t)addrScreenValue, cm = (uint16_t)addrColValue;
+	bool col = color, mc = multicolor, ext = false;
+
+	if (mode == C64_Current) {
+		uint16_t vic = (3 ^ (Get6502Byte(0xdd00) & 3)) * 0x4000;
+		uint8_t d018 = Get6502Byte(0xd018);
+		uint8_t d011 = Get6502Byte(0xd011);
+		g = (d018 & 0xe) * 0x400 + vic;
+		s = (d018 >> 4) * 0x400 + vic;
+		if (g == 0x1000 || g == 0xb000) { g = 0; }
+		cm = 0xd800;
+		mc = (Get6502Byte(0xd016) & 0x10) ? true : false;
+		col = !mc;
+		if (d011 & 0x40) {
+			mode = C64_Text; ext = true; col = false; mc = false;
+		} else if (d011 & 0x20) {
+			mode = C64_Bitmap;
+			if (!mc) { g &= 0xe000; }
+		} else { mode = C64_Text; }
+	} else if (mode == C64_ColBitmap) {
+		mode = C64_Bitmap; col = true; mc = false;
+	} else if (mode == C64_MCBM) {
+		mode = C64_Bitmap; col = false; mc = true;
+	} else if (mode == C64_ExtText || mode == C64_Text_MC) {
+		ext = mode == C64_ExtText;
+		col = false; mc = !ext;
+		mode = C64_Text;
+	}
+
+	uint32_t w = cl * 8;
+	uint32_t h = rw * 8;
+	uint32_t sx = columns / 3;
+	uint32_t sy = (h / 21) * 21;	// sprites only fill whole 21 line rows
+	for (uint32_t y = 0; y < h; ++y) {
+		for (uint32_t x = 0; x < cl; ++x) {
+			uint32_t age = HEAT_NEVER;
+			uint32_t cell = (y >> 3) * cl + x;
+			switch (mode) {
+				case Planar: age = MinWriteAge(age, uint16_t(g + y * columns + x)); break;
+				case Columns: age = MinWriteAge(age, uint16_t(g + x * h + y)); break;
+				case C64_Sprites:
+					if ((x / 3) < sx && y < sy) {
+						uint32_t sprite = (y / 21) * sx + x / 3;
+						age = MinWriteAge(age, uint16_t(g + sprite * 64 + (y % 21) * 3 + x % 3));
+					}
+					break;
+				case C64_Bitmap:
+					age = MinWriteAge(age, uint16_t(g + (y >> 3) * w + x * 8 + (y & 7)));
+					if (col || mc) { age = MinWriteAge(age, uint16_t(s + cell)); }
+					if (mc) { age = MinWriteAge(age, uint16_t(cm + cell)); }
+					break;
+				case C64_Text:
+				case C64_ColumnScreen_MC: {
+					if (mode == C64_ColumnScreen_MC) { cell = x * rw + (y >> 3); }
+					uint8_t chr = Get6502Byte(uint16_t(s + cell));
+					if (ext) { chr &= 0x3f; }
+					age = MinWriteAge(age, uint16_t(s + cell));
+					if (g) { age = MinWriteAge(age, uint16_t(g + chr * 8 + (y & 7))); }
+					if (col || mc || ext || mode == C64_ColumnScreen_MC) { age = MinWriteAge(age, uint16_t(cm + cell)); }
+					break;
+				}
+				default: return;	// no overlay for Apple II modes
+			}
+			if (age < GfxHeatCycles) {
+				uint32_t a = 192 - age / (GfxHeatCycles / 192 + 1);
+				uint32_t* o = d + y * w + x * 8;
+				for (int p = 0; p < 8; ++p) {
+					uint32_t c = o[p];
+					uint32_t r = ((c & 0xff) * (256 - a) + 255 * a) >> 8;
+					uint32_t gr = (((c >> 8) & 0xff) * (256 - a)) >> 8;
+					uint32_t b = (((c >> 16) & 0xff) * (256 - a)) >> 8;
+					o[p] = (c & 0xff000000) | (b << 16) | (gr << 8) | r;
+				}
+			}
+		}
+	}
+}
+
 void GfxView::CreatePlanarBitmap(uint32_t* d, int linesHigh, uint32_t w, const uint32_t* pal)
 {
 	uint16_t a = addrGfxValue;
@@ -769,7 +875,7 @@ void GfxView::CreateApple2HiresColorBitmap(uint32_t* d, int linesHigh, uint32_t
 
 
 
-GfxView::GfxView() : open(false), reeval(false)
+GfxView::GfxView() : open(false), reeval(false), heatOverlay(false)
 {
 	addrScreenValue = 0x0400;
 	addrGfxValue = 0x0000;
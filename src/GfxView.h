@@ -66,6 +66,7 @@ struct GfxView
 
 	bool color;
 	bool multicolor;
+	bool heatOverlay;
 
 	GfxView();
 
@@ -75,6 +76,7 @@ struct GfxView
 
 	void Draw( int index );
 	void Create8bppBitmap();
+	void ApplyHeatOverlay(uint32_t* dst, uint32_t cl, uint32_t rw);
 
 	void CreatePlanarBitmap(uint32_t* dst, int lines, uint32_t width, const uint32_t* palette);
 	void CreateColumnsBitmap(uint32_t* dst, int lines, uint32_t width, const uint32_t* palette);
@@ -0,0 +1,682 @@
+// Command line modes that run without creating a window
+//	IceBro -tracediff <a> <b> [-context <n>]
+//	IceBro -batch <manifest> [-jobs <n>] [-junit <file>] [-json <file>]
+//	IceBro -conformance <folder> [-budget <cycles>] [-success <addr>]
+//	IceBro -symbench [<labels>] [-file <sym>]
+#ifdef _WIN32
+#include "stdafx.h"
+#include <shellapi.h>
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include "struse/struse.h"
+#include "machine.h"
+#include "cpu.h"
+#include "Expressions.h"
+#include "Config.h"
+#include "FileDialog.h"
+#include "Trace.h"
+#include "sym.h"
+#include "Headless.h"
+
+static void HeadlessPrint(const char *line, void *user)
+{
+	fprintf((FILE*)user, "%s\n", line);
+}
+
+static int HeadlessTraceDiff(int argc, char *argv[])
+{
+	const char *traces[2] = {};
+	int numTraces = 0;
+	int context = 5;
+	for (int a = 0; a < argc; ++a) {
+		if (strcmp(argv[a], "-context") == 0 && (a + 1) < argc) {
+			context = atoi(argv[++a]);
+		} else if (numTraces < 2) {
+			traces[numTraces++] = argv[a];
+		}
+	}
+	if (numTraces < 2) {
+		fprintf(stderr, "Usage: IceBro -tracediff <trace a> <trace b> [-context <n>]\n"
+			"  traces are IceBro trace files or VICE text traces\n");
+		return 2;
+	}
+	int result = TraceDiff(traces[0], traces[1], context, HeadlessPrint, stdout);
+	return result < 0 ? 2 : result;
+}
+
+//
+// Batch regression runner
+//
+// Each manifest line is a test: <program> <load> <entry> <cycles> [check ...]
+//	load is - to use the .prg load address, otherwise the address to load at
+//	entry is - to start at the load address or the basic SYS address
+//	cycles is the budget, a test passes when it traps (jmp * or branch to
+//	itself), jams or hits no check failures before running out of cycles
+//	checks are expressions without spaces that must be non-zero, e.g. a=0 {$0400}=$01
+//	except cycles=<n> which checks the total cycles including the final trap
+// Tests are spread over worker processes that each write their results to
+// a file which the main process collects into JUnit XML and JSON summaries.
+
+#define BATCH_MAX_CHECKS 16
+
+enum BatchStatus {
+	BS_Pass,
+	BS_Fail,
+	BS_Error
+};
+
+struct BatchTest {
+	strown<MAX_PATH> program;
+	strown<64> name;
+	int load;					// -1 for the .prg load address
+	int entry;					// -1 for the load or SYS address
+	uint32_t cycles;
+	int numChecks;
+	strown<64> checks[BATCH_MAX_CHECKS];
+};
+
+struct BatchResult {
+	int status;
+	uint32_t cycles;
+	uint32_t micros;
+	strown<256> message;
+};
+
+static const char *sBatchStatus[] = { "pass", "fail", "error" };
+
+static int BatchValue(strref value)
+{
+	if (value.get_first() == '$') {
+		++value;
+		return (int)value.ahextoui();
+	}
+	return (int)value.atoi();
+}
+
+static bool ReadBatchManifest(const char *manifest, std::vector<BatchTest> &tests)
+{
+	FILE *f;
+	if (fopen_s(&f, manifest, "rb") != 0 || !f) { return false; }
+	fseek(f, 0, SEEK_END);
+	size_t size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char *text = (char*)malloc(size + 1);
+	if (!text) {
+		fclose(f);
+		return false;
+	}
+	size = fread(text, 1, size, f);
+	fclose(f);
+
+	// programs are relative to the manifest
+	strref folder(manifest);
+	int slash = folder.find_last('/', '\\');
+	folder = slash >= 0 ? folder.get_substr(0, slash + 1) : strref();
+
+	strref file(text, (strl_t)size);
+	while (strref line = file.line()) {
+		line.trim_whitespace();
+		if (!line || line.get_first() == '#' || line.get_first() == ';') { continue; }
+		BatchTest test;
+		strref program = line.split_token_trim(' ');
+		if (program.get_first() == '/' || program.get_first() == '\\' || (program.get_len() > 1 && program[1] == ':')) {
+			test.program.copy(program);
+		} else {
+			test.program.copy(folder);
+			test.program.append(program);
+		}
+		test.name.copy(program.after_last('/', '\\') ? program.after_last('/', '\\') : program);
+		strref load = line.split_token_trim(' ');
+		strref entry = line.split_token_trim(' ');
+		strref cycles = line.split_token_trim(' ');
+		test.load = load.same_str("-") ? -1 : BatchValue(load);
+		test.entry = entry.same_str("-") ? -1 : BatchValue(entry);
+		if (test.entry >= 0) { test.name.append(' ').append(entry); }	// several tests in one program
+		test.cycles = (uint32_t)cycles.atoui();
+		test.numChecks = 0;
+		while (strref check = line.split_token_trim(' ')) {
+			if (test.numChecks < BATCH_MAX_CHECKS) { test.checks[test.numChecks++].copy(check); }
+		}
+		tests.push_back(test);
+	}
+	free(text);
+	return true;
+}
+
+static uint8_t BatchGetByte(uint16_t addr, void *user)
+{
+	return ((Machine*)user)->GetByte(addr);
+}
+
+static void RunBatchTest(const BatchTest &test, BatchResult &result)
+{
+	auto start = std::chrono::steady_clock::now();
+	result.status = BS_Pass;
+	result.cycles = 0;
+	result.message.clear();
+
+	Machine machine;
+	if (!machine.Initialize()) {
+		result.status = BS_Error;
+		result.message.copy("out of memory");
+		return;
+	}
+
+	strref ext = strref(test.program.get(), test.program.get_len()).after_last('.');
+	int filetype = ext.same_str("prg") ? 0 : 2;
+	int address = test.load >= 0 ? test.load : 0;
+	uint16_t startAddr;
+	if (!LoadBinaryFile(machine, test.program.c_str(), filetype, address, test.load >= 0, startAddr)) {
+		result.status = BS_Error;
+		result.message.sprintf("could not load %s", test.program.c_str());
+		return;
+	}
+
+	Regs &regs = machine.GetRegs();
+	regs.PC = test.entry >= 0 ? (uint16_t)test.entry : startAddr;
+	regs.T = 0;
+	MachineRunResult run = machine.Run(test.cycles);
+	result.cycles = machine.GetCycles();
+
+	if (run == MRR_Budget) {
+		result.status = BS_Fail;
+		result.message.sprintf("cycle budget exceeded at $%04x", regs.PC);
+	}
+	for (int c = 0; c < test.numChecks && result.status == BS_Pass; ++c) {
+		uint8_t rpn[256];
+		strref check(test.checks[c].get(), test.checks[c].get_len());
+		if (check.has_prefix("cycles=")) {
+			uint32_t expect = (uint32_t)BatchValue(check + 7);
+			if (result.cycles != expect) {
+				result.status = BS_Fail;
+				result.message.sprintf("%s failed with %u cycles at $%04x", test.checks[c].c_str(), result.cycles, regs.PC);
+			}
+		} else if (!BuildExpression(test.checks[c].c_str(), rpn, sizeof(rpn))) {
+			result.status = BS_Error;
+			result.message.sprintf("invalid check %s", test.checks[c].c_str());
+		} else if (!EvalExpression(rpn, regs, BatchGetByte, &machine)) {
+			result.status = BS_Fail;
+			result.message.sprintf("%s failed at $%04x A:%02x X:%02x Y:%02x S:%02x P:%02x", test.checks[c].c_str(),
+								   regs.PC, regs.A, regs.X, regs.Y, regs.S, regs.P);
+		}
+	}
+	result.micros = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// runs every jobs'th test starting at worker and writes one line per test
+static int BatchWorker(const std::vector<BatchTest> &tests, int worker, int jobs, const char *output)
+{
+	FILE *f;
+	if (fopen_s(&f, output, "w") != 0 || !f) { return 2; }
+	for (size_t t = worker; t < tests.size(); t += jobs) {
+		BatchResult result;
+		RunBatchTest(tests[t], result);
+		fprintf(f, "%u\t%d\t%u\t%u\t%s\n", (uint32_t)t, result.status, result.cycles, result.micros, result.message.c_str());
+	}
+	fclose(f);
+	return 0;
+}
+
+static bool ReadBatchResults(const char *output, std::vector<BatchResult> &results)
+{
+	FILE *f;
+	if (fopen_s(&f, output, "r") != 0 || !f) { return false; }
+	char line[512];
+	while (fgets(line, sizeof(line), f)) {
+		strref rest(line);
+		rest.clip_trailing_whitespace();
+		uint32_t index = (uint32_t)rest.split_token('\t').atoui();
+		if (index >= results.size()) { continue; }
+		BatchResult &result = results[index];
+		result.status = (int)rest.split_token('\t').atoi();
+		result.cycles = (uint32_t)rest.split_token('\t').atoui();
+		result.micros = (uint32_t)rest.split_token('\t').atoui();
+		result.message.copy(rest);
+	}
+	fclose(f);
+	return true;
+}
+
+static void BatchWorkerFile(strown<MAX_PATH> &file, const char *manifest, int worker)
+{
+	file.copy(manifest);
+	file.append(".worker").append_num(worker, 0, 10);
+}
+
+// start one process per job, windows starts the executable again
+static bool StartBatchWorkers(const char *manifest, const std::vector<BatchTest> &tests, int jobs)
+{
+#ifdef _WIN32
+	char exe[MAX_PATH];
+	if (!GetModuleFileNameA(NULL, exe, MAX_PATH)) { return false; }
+	std::vector<HANDLE> processes;
+	for (int w = 0; w < jobs; ++w) {
+		strown<MAX_PATH> output;
+		BatchWorkerFile(output, manifest, w);
+		strown<MAX_PATH * 3 + 64> cmd;
+		cmd.sprintf("\"%s\" -batchworker \"%s\" %d %d \"%s\"", exe, manifest, w, jobs, output.c_str());
+		STARTUPINFOA si = {};
+		si.cb = sizeof(si);
+		PROCESS_INFORMATION pi = {};
+		if (CreateProcessA(NULL, cmd.charstr(), NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+			CloseHandle(pi.hThread);
+			processes.push_back(pi.hProcess);
+		}
+	}
+	for (size_t p = 0; p < processes.size(); ++p) {
+		WaitForSingleObject(processes[p], INFINITE);
+		CloseHandle(processes[p]);
+	}
+	return processes.size() == (size_t)jobs;
+#else
+	std::vector<pid_t> processes;
+	for (int w = 0; w < jobs; ++w) {
+		strown<MAX_PATH> output;
+		BatchWorkerFile(output, manifest, w);
+		pid_t pid = fork();
+		if (pid == 0) {
+			_exit(BatchWorker(tests, w, jobs, output.c_str()));
+		} else if (pid > 0) {
+			processes.push_back(pid);
+		}
+	}
+	for (size_t p = 0; p < processes.size(); ++p) {
+		int status;
+		waitpid(processes[p], &status, 0);
+	}
+	return processes.size() == (size_t)jobs;
+#endif
+}
+
+static void XMLEscape(FILE *f, const char *text)
+{
+	for (; *text; ++text) {
+		switch (*text) {
+			case '<': fputs("&lt;", f); break;
+			case '>': fputs("&gt;", f); break;
+			case '&': fputs("&amp;", f); break;
+			case '"': fputs("&quot;", f); break;
+			default: fputc(*text, f); break;
+		}
+	}
+}
+
+static void JSONEscape(FILE *f, const char *text)
+{
+	for (; *text; ++text) {
+		if (*text == '"' || *text == '\\') { fputc('\\', f); }
+		if ((uint8_t)*text >= ' ') { fputc(*text, f); }
+	}
+}
+
+static bool WriteJUnit(const char *file, const char *suite, const std::vector<BatchTest> &tests,
+					   const std::vector<BatchResult> &results, const int *counts, double seconds)
+{
+	FILE *f;
+	if (fopen_s(&f, file, "w") != 0 || !f) { return false; }
+	fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(f, "<testsuites tests=\"%d\" failures=\"%d\" errors=\"%d\" time=\"%.3f\">\n",
+			(int)tests.size(), counts[BS_Fail], counts[BS_Error], seconds);
+	fprintf(f, "\t<testsuite name=\"");
+	XMLEscape(f, suite);
+	fprintf(f, "\" tests=\"%d\" failures=\"%d\" errors=\"%d\" time=\"%.3f\">\n",
+			(int)tests.size(), counts[BS_Fail], counts[BS_Error], seconds);
+	for (size_t t = 0; t < tests.size(); ++t) {
+		const BatchResult &result = results[t];
+		fprintf(f, "\t\t<testcase name=\"");
+		XMLEscape(f, tests[t].name.c_str());
+		fprintf(f, "\" classname=\"");
+		XMLEscape(f, suite);
+		fprintf(f, "\" time=\"%.6f\"", result.micros / 1000000.0);
+		if (result.status == BS_Pass) {
+			fprintf(f, "/>\n");
+			continue;
+		}
+		fprintf(f, ">\n\t\t\t<%s message=\"", result.status == BS_Fail ? "failure" : "error");
+		XMLEscape(f, result.message.c_str());
+		fprintf(f, "\"/>\n\t\t</testcase>\n");
+	}
+	fprintf(f, "\t</testsuite>\n</testsuites>\n");
+	fclose(f);
+	return true;
+}
+
+static bool WriteJSONSummary(const char *file, const std::vector<BatchTest> &tests,
+							 const std::vector<BatchResult> &results, const int *counts, double seconds)
+{
+	FILE *f;
+	if (fopen_s(&f, file, "w") != 0 || !f) { return false; }
+	fprintf(f, "{\n\t\"tests\": %d,\n\t\"passed\": %d,\n\t\"failed\": %d,\n\t\"errors\": %d,\n\t\"time\": %.3f,\n\t\"results\": [",
+			(int)tests.size(), counts[BS_Pass], counts[BS_Fail], counts[BS_Error], seconds);
+	for (size_t t = 0; t < tests.size(); ++t) {
+		const BatchResult &result = results[t];
+		fprintf(f, "%s\n\t\t{ \"name\": \"", t ? "," : "");
+		JSONEscape(f, tests[t].name.c_str());
+		fprintf(f, "\", \"status\": \"%s\", \"cycles\": %u, \"time\": %.6f, \"message\": \"",
+				sBatchStatus[result.status], result.cycles, result.micros / 1000000.0);
+		JSONEscape(f, result.message.c_str());
+		fprintf(f, "\" }");
+	}
+	fprintf(f, "\n\t]\n}\n");
+	fclose(f);
+	return true;
+}
+
+static int HeadlessBatch(int argc, char *argv[])
+{
+	const char *manifest = nullptr, *junit = nullptr, *json = nullptr;
+	int jobs = IBNumCores();
+	for (int a = 0; a < argc; ++a) {
+		if (strcmp(argv[a], "-jobs") == 0 && (a + 1) < argc) { jobs = atoi(argv[++a]); }
+		else if (strcmp(argv[a], "-junit") == 0 && (a + 1) < argc) { junit = argv[++a]; }
+		else if (strcmp(argv[a], "-json") == 0 && (a + 1) < argc) { json = argv[++a]; }
+		else if (!manifest) { manifest = argv[a]; }
+	}
+	if (!manifest) {
+		fprintf(stderr, "Usage: IceBro -batch <manifest> [-jobs <n>] [-junit <file>] [-json <file>]\n"
+			"  manifest lines: <program> <load|-> <entry|-> <cycles> [check ...]\n");
+		return 2;
+	}
+
+	std::vector<BatchTest> tests;
+	if (!ReadBatchManifest(manifest, tests)) {
+		fprintf(stderr, "Could not read manifest %s\n", manifest);
+		return 2;
+	}
+	if (jobs > (int)tests.size()) { jobs = (int)tests.size(); }
+	if (jobs < 1) { jobs = 1; }
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<BatchResult> results(tests.size());
+	for (size_t t = 0; t < results.size(); ++t) {
+		results[t].status = BS_Error;
+		results[t].cycles = 0;
+		results[t].micros = 0;
+		results[t].message.copy("worker did not report a result");
+	}
+	if (!StartBatchWorkers(manifest, tests, jobs)) { fprintf(stderr, "Could not start all worker processes\n"); }
+	for (int w = 0; w < jobs; ++w) {
+		strown<MAX_PATH> output;
+		BatchWorkerFile(output, manifest, w);
+		ReadBatchResults(output.c_str(), results);
+		remove(output.c_str());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int counts[3] = {};
+	for (size_t t = 0; t < tests.size(); ++t) {
+		const BatchResult &result = results[t];
+		++counts[result.status];
+		if (result.status != BS_Pass) {
+			printf("%s %s: %s\n", sBatchStatus[result.status], tests[t].name.c_str(), result.message.c_str());
+		}
+	}
+	printf("%d tests, %d passed, %d failed, %d errors in %.3f seconds on %d processes\n",
+		   (int)tests.size(), counts[BS_Pass], counts[BS_Fail], counts[BS_Error], seconds, jobs);
+
+	strref suite = strref(manifest).after_last('/', '\\');
+	strown<MAX_PATH> suiteName(suite ? suite : strref(manifest));
+	if (junit && !WriteJUnit(junit, suiteName.c_str(), tests, results, counts, seconds)) { fprintf(stderr, "Could not write %s\n", junit); }
+	if (json && !WriteJSONSummary(json, tests, results, counts, seconds)) { fprintf(stderr, "Could not write %s\n", json); }
+	return counts[BS_Error] ? 2 : (counts[BS_Fail] ? 1 : 0);
+}
+
+// a worker process started by the batch runner
+static int HeadlessBatchWorker(int argc, char *argv[])
+{
+	if (argc < 4) { return 2; }
+	std::vector<BatchTest> tests;
+	if (!ReadBatchManifest(argv[0], tests)) { return 2; }
+	return BatchWorker(tests, atoi(argv[1]), atoi(argv[2]), argv[3]);
+}
+
+//
+// CPU conformance and speed check
+//
+// Runs Klaus Dormann's 6502 functional and decimal mode test binaries
+// directly on Step6502 with flat memory. The functional test passes when it
+// traps at the success address, the decimal test passes when it clears its
+// ERROR byte. Reports instructions per second so changes to the core get a
+// correctness and speed number in one run.
+
+#define CONFORMANCE_ERROR_ADDR 0x000b
+
+struct ConformanceTest {
+	const char *name;
+	const char *file;
+	uint16_t load;
+	uint16_t start;
+	bool decimal;
+};
+
+static const ConformanceTest sConformanceTests[] = {
+	{ "functional", "6502_functional_test.bin", 0x0000, 0x0400, false },
+	{ "decimal", "6502_decimal_test.bin", 0x0200, 0x0200, true },
+};
+
+struct ConformanceMem {
+	uint8_t ram[0x10000];
+	bool errorCleared;
+};
+
+static uint8_t ConformanceGetByte(uint16_t addr, void *user)
+{
+	return ((ConformanceMem*)user)->ram[addr];
+}
+
+static void ConformanceSetByte(uint16_t addr, uint8_t value, void *user)
+{
+	ConformanceMem *mem = (ConformanceMem*)user;
+	mem->ram[addr] = value;
+	if (addr == CONFORMANCE_ERROR_ADDR && !value) { mem->errorCleared = true; }
+}
+
+static int HeadlessConformance(int argc, char *argv[])
+{
+	const char *folder = nullptr;
+	uint64_t budget = 200000000;
+	uint16_t success = 0x3469;	// success trap of the default functional test build
+	for (int a = 0; a < argc; ++a) {
+		if (strcmp(argv[a], "-budget") == 0 && (a + 1) < argc) { budget = strref(argv[++a]).atoui(); }
+		else if (strcmp(argv[a], "-success") == 0 && (a + 1) < argc) { success = (uint16_t)BatchValue(strref(argv[++a])); }
+		else if (!folder) { folder = argv[a]; }
+	}
+	if (!folder) {
+		fprintf(stderr, "Usage: IceBro -conformance <folder> [-budget <cycles>] [-success <addr>]\n"
+			"  folder contains 6502_functional_test.bin and 6502_decimal_test.bin\n");
+		return 2;
+	}
+
+	ConformanceMem *mem = (ConformanceMem*)malloc(sizeof(ConformanceMem));
+	if (!mem) { return 2; }
+	int failed = 0, missing = 0;
+	uint64_t totalInstructions = 0;
+	double totalSeconds = 0.0;
+	for (size_t t = 0; t < sizeof(sConformanceTests) / sizeof(sConformanceTests[0]); ++t) {
+		const ConformanceTest &test = sConformanceTests[t];
+		strown<MAX_PATH> file(folder);
+		if (file && file.get_last() != '/' && file.get_last() != '\\') { file.append('/'); }
+		file.append(test.file);
+
+		memset(mem, 0, sizeof(ConformanceMem));
+		FILE *f;
+		if (fopen_s(&f, file.c_str(), "rb") != 0 || !f) {
+			printf("missing %s: could not open %s\n", test.name, file.c_str());
+			++missing;
+			continue;
+		}
+		fread(mem->ram + test.load, 1, 0x10000 - test.load, f);
+		fclose(f);
+
+		Regs regs = {};
+		regs.PC = test.start;
+		regs.S = 0xff;
+		regs.P = 0x24;
+		uint64_t cycles = 0, instructions = 0;
+		const char *stop = "cycle budget exceeded";
+		auto start = std::chrono::steady_clock::now();
+		while (cycles < budget) {
+			uint16_t pc = regs.PC;
+			regs = Step6502(regs, ConformanceGetByte, ConformanceSetByte, mem);
+			++instructions;
+			if (regs.T == 0xff) { stop = "jam"; break; }
+			cycles += regs.T;
+			if (regs.PC == pc) { stop = "trap"; break; }
+			if (test.decimal && mem->errorCleared) { stop = "error cleared"; break; }
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		totalInstructions += instructions;
+		totalSeconds += seconds;
+
+		bool pass = test.decimal ? mem->errorCleared : (regs.PC == success && !strcmp(stop, "trap"));
+		if (!pass) { ++failed; }
+		printf("%s %s: %s at $%04x after %llu instructions, %llu cycles in %.3f s (%.2f M instructions/s)\n",
+			   pass ? "pass" : "FAIL", test.name, stop, regs.PC, (unsigned long long)instructions,
+			   (unsigned long long)cycles, seconds, seconds > 0.0 ? instructions / seconds / 1000000.0 : 0.0);
+	}
+	free(mem);
+
+	if (totalSeconds > 0.0) {
+		printf("%.2f M instructions/s overall\n", totalInstructions / totalSeconds / 1000000.0);
+	}
+	return missing ? 2 : (failed ? 1 : 0);
+}
+
+
+//
+// Symbol store benchmark
+//
+// Writes a KickAss style .sym file with the given number of labels (or
+// reads an existing one with -file), then times loading, resetting and the
+// lookups the views do every frame, and checks that every label resolves.
+
+static double SymBenchMillis(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int HeadlessSymBench(int argc, char *argv[])
+{
+	uint32_t labels = 100000;
+	const char *file = nullptr;
+	for (int a = 0; a < argc; ++a) {
+		if (strcmp(argv[a], "-file") == 0 && (a + 1) < argc) { file = argv[++a]; }
+		else { labels = strref(argv[a]).atoui(); }
+	}
+	bool generated = !file;
+	if (generated) {
+		file = "symbench.sym";
+		FILE *f;
+		if (fopen_s(&f, file, "w") != 0 || !f) {
+			fprintf(stderr, "could not write %s\n", file);
+			return 2;
+		}
+		for (uint32_t l = 0; l < labels; ++l) {
+			fprintf(f, ".label %s_%u=$%04x\n", (l & 1) ? "loop" : "data", l, (l * 7) & 0xffff);
+		}
+		fclose(f);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	bool loaded = ReadSymbols(file);
+	double load = SymBenchMillis(start);
+	if (!loaded) {
+		fprintf(stderr, "could not read %s\n", file);
+		return 2;
+	}
+
+	start = std::chrono::steady_clock::now();
+	uint32_t found = 0;
+	for (uint32_t a = 0; a < 0x10000; ++a) { found += GetSymbol((uint16_t)a) ? 1 : 0; }
+	double bySymbol = SymBenchMillis(start);
+
+	// every generated name resolves to the address it was written with
+	int failed = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t l = 0; generated && l < labels; ++l) {
+		char name[32];
+		int chars = sprintf_s(name, sizeof(name), "%s_%u", (l & 1) ? "loop" : "data", l);
+		uint16_t addr;
+		if (!GetAddress(name, chars, addr) || addr != ((l * 7) & 0xffff)) { ++failed; }
+	}
+	double byName = SymBenchMillis(start);
+
+	static const char *queries[] = { "l", "loop_1", "data_99", "p_12", "dt9" };
+	SymbolSearchResult results[32];
+	start = std::chrono::steady_clock::now();
+	uint32_t matches = 0;
+	for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); ++q) {
+		matches += SearchSymbols(queries[q], strlen(queries[q]), results, 32);
+	}
+	double search = SymBenchMillis(start);
+
+	uint32_t names = GetNumSymbolNames();
+	start = std::chrono::steady_clock::now();
+	ResetSymbols();
+	double reset = SymBenchMillis(start);
+
+	printf("%u names, %u addresses labeled\n", names, found);
+	printf("load %.2f ms, 64K address lookups %.2f ms, name lookups %.2f ms, %d searches %.3f ms (%u matches), reset %.3f ms\n",
+		   load, bySymbol, byName, (int)(sizeof(queries) / sizeof(queries[0])), search, matches, reset);
+	if (failed) { printf("FAIL %d names did not resolve\n", failed); }
+	ShutdownSymbols();
+	if (generated) { remove(file); }
+	return failed ? 1 : 0;
+}
+
+bool HeadlessCommand(int argc, char *argv[], int &exitCode)
+{
+	for (int a = 1; a < argc; ++a) {
+		if (strcmp(argv[a], "-tracediff") == 0) {
+			exitCode = HeadlessTraceDiff(argc - a - 1, argv + a + 1);
+			return true;
+		} else if (strcmp(argv[a], "-batch") == 0) {
+			exitCode = HeadlessBatch(argc - a - 1, argv + a + 1);
+			return true;
+		} else if (strcmp(argv[a], "-batchworker") == 0) {
+			exitCode = HeadlessBatchWorker(argc - a - 1, argv + a + 1);
+			return true;
+		} else if (strcmp(argv[a], "-conformance") == 0) {
+			exitCode = HeadlessConformance(argc - a - 1, argv + a + 1);
+			return true;
+		} else if (strcmp(argv[a], "-symbench") == 0) {
+			exitCode = HeadlessSymBench(argc - a - 1, argv + a + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef _WIN32
+bool HeadlessCommand(int &exitCode)
+{
+	int argc = 0;
+	LPWSTR *argvW = CommandLineToArgvW(GetCommandLineW(), &argc);
+	if (!argvW) { return false; }
+
+	std::vector<char> args((size_t)argc * MAX_PATH);
+	std::vector<char*> argv(argc);
+	for (int a = 0; a < argc; ++a) {
+		argv[a] = &args[(size_t)a * MAX_PATH];
+		WideCharToMultiByte(CP_UTF8, 0, argvW[a], -1, argv[a], MAX_PATH, NULL, NULL);
+	}
+	LocalFree(argvW);
+
+	// a windows application has no console, print to the one that launched it
+	bool headless = false;
+	for (int a = 1; a < argc && !headless; ++a) { headless = argv[a][0] == '-'; }
+	if (headless && AttachConsole(ATTACH_PARENT_PROCESS)) {
+		FILE *f;
+		freopen_s(&f, "CONOUT$", "w", stdout);
+		freopen_s(&f, "CONOUT$", "w", stderr);
+	}
+	return argc && HeadlessCommand(argc, &argv[0], exitCode);
+}
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+// Command line modes that run without creating a window
+
+// returns true if the command line selected a headless mode, exitCode is then the process result
+bool HeadlessCommand(int argc, char *argv[], int &exitCode);
+
+#ifdef _WIN32
+// parses the process command line for wWinMain
+bool HeadlessCommand(int &exitCode);
+#endif
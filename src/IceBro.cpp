@@ -10,7 +10,6 @@
 * Rework the draw call for memory view
 * Replace text loading code with struse
 * Vic 20 screen modes
-* Label View
 * Look at possibility of loading vice snapshots link : http://vice-emu.sourceforge.net/vice_9.html
 */
 
@@ -32,6 +31,7 @@
 #include "Sym.h"
 #include "FileDialog.h"
 #include "SourceDebug.h"
+#include "Headless.h"
 
 // test loading kickasm src debug
 #include "SourceDebug.h"
@@ -56,6 +56,17 @@ int main(int argc, char *argv[])
 {
 	GetStartFolder();
 
+	// command line modes such as -tracediff exit before any window is created
+	{
+		int exitCode = 0;
+#ifdef _WIN32
+		if (HeadlessCommand(exitCode))
+#else
+		if (HeadlessCommand(argc, argv, exitCode))
+#endif
+			return exitCode;
+	}
+
 	// check if either imgui.ini or icebro.cfg is missing
 	CheckMissingConfig();
 
@@ -177,6 +188,7 @@ int main(int argc, char *argv[])
 
 	ShutdownSymbols();
 	ShutdownListing();
+	ShutdownHotReload();
 	ViceConnectShutdown();
 	ShutdownSourceDebug();
 
@@ -1,5 +1,8 @@
 #include "imgui.h"
 #include "imgui_internal.h"
+#include <ctype.h>
+#include "struse/struse.h"
+#include "sym.h"
 
 void ForceKeyboardCanvas(const char* label)
 {
@@ -74,3 +77,49 @@ bool KeyboardCanvas( const char* label )
 }
 
 
+
+static bool IsLabelChar(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+// Tab completion for labels in expression fields. The word in front of the
+// cursor is replaced by the only match, or extended to the longest prefix
+// shared by all names starting with it. Returns the number of matches found.
+int CompleteSymbolInput(ImGuiInputTextCallbackData* data, SymbolSearchResult* matches, int maxMatches)
+{
+	if (data->EventFlag != ImGuiInputTextFlags_CallbackCompletion) { return 0; }
+	int end = data->CursorPos, start = end;
+	while (start > 0 && IsLabelChar(data->Buf[start - 1])) { --start; }
+	if (start == end) { return 0; }
+
+	int numMatches = (int)SearchSymbols(data->Buf + start, end - start, matches, maxMatches);
+
+	// names are sorted so the first and last name with the prefix share what all of them share,
+	// even when there are more than fit in matches
+	uint32_t first;
+	uint32_t numPrefix = SearchSymbolPrefix(data->Buf + start, end - start, first);
+	strref complete;
+	const char *name, *last;
+	uint16_t address;
+	if (numPrefix && GetSymbolName(first, name, address) && GetSymbolName(first + numPrefix - 1, last, address)) {
+		complete = strref(name);
+		strl_t len = 0;
+		while (len < complete.get_len() && tolower(complete[len]) == tolower(last[len])) { ++len; }
+		complete = complete.get_substr(0, len);
+	} else if (numMatches == 1) {
+		complete = strref(matches[0].name);
+	}
+	if (complete.get_len() >= strl_t(end - start)) {
+		data->DeleteChars(start, end - start);
+		data->InsertChars(start, complete.get(), complete.get() + complete.get_len());
+	}
+	return numMatches;
+}
+
+int SymbolCompletionCallback(ImGuiInputTextCallbackData* data)
+{
+	SymbolSearchResult matches[32];
+	CompleteSymbolInput(data, matches, 32);
+	return 0;
+}
@@ -1,4 +1,9 @@
 #pragma once
 
+struct ImGuiInputTextCallbackData;
+struct SymbolSearchResult;
+
 void ForceKeyboardCanvas(const char* label);
 bool KeyboardCanvas( const char* label );
+int CompleteSymbolInput(ImGuiInputTextCallbackData* data, SymbolSearchResult* matches, int maxMatches);
+int SymbolCompletionCallback(ImGuiInputTextCallbackData* data);
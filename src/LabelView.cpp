@@ -0,0 +1,76 @@
+#include "imgui/imgui.h"
+#include "LabelView.h"
+#include "Views.h"
+#include "Config.h"
+#include "ImGui_Helper.h"
+#include "sym.h"
+
+LabelView::LabelView() : open(false)
+{
+	filter[0] = 0;
+}
+
+void LabelView::WriteConfig(UserData & config)
+{
+	config.AddValue(strref("open"), config.OnOff(open));
+	config.AddValue(strref("filter"), strref(filter));
+}
+
+void LabelView::ReadConfig(strref config)
+{
+	ConfigParse conf(config);
+	while (!conf.Empty()) {
+		strref name, value;
+		ConfigParseType type = conf.Next(&name, &value);
+		if (name.same_str("open") && type == CPT_Value) {
+			open = !value.same_str("Off");
+		} else if (name.same_str("filter") && type == CPT_Value) {
+			strovl filterStr(filter, sizeof(filter));
+			filterStr.copy(value);
+			filterStr.c_str();
+		}
+	}
+}
+
+// one line per label, double click shows the address in the code views
+static void LabelLine(const char* name, uint16_t address, int index)
+{
+	strown<128> line;
+	line.append('$').append_num(address, 4, 16).append(' ').append(name);
+	ImGui::PushID(index);
+	if (ImGui::Selectable(line.c_str(), false, ImGuiSelectableFlags_AllowDoubleClick) && ImGui::IsMouseDoubleClicked(0)) {
+		FocusAddress(address);
+	}
+	ImGui::PopID();
+}
+
+void LabelView::Draw()
+{
+	if (!open) { return; }
+	ImGui::SetNextWindowSize(ImVec2(320, 400), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Labels", &open)) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::InputText("filter", filter, sizeof(filter), ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback);
+	ImGui::BeginChild("labels");
+	if (filter[0]) {
+		// prefix matches first, then substring and fuzzy matches
+		enum { MaxMatches = 256 };
+		static SymbolSearchResult matches[MaxMatches];
+		int numMatches = (int)SearchSymbols(filter, strlen(filter), matches, MaxMatches);
+		for (int m = 0; m < numMatches; ++m) { LabelLine(matches[m].name, matches[m].address, m); }
+	} else {
+		ImGuiListClipper clipper((int)GetNumSymbolNames());
+		while (clipper.Step()) {
+			for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+				const char* name;
+				uint16_t address;
+				if (GetSymbolName((uint32_t)i, name, address)) { LabelLine(name, address, i); }
+			}
+		}
+	}
+	ImGui::EndChild();
+	ImGui::End();
+}
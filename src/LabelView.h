@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include "struse\struse.h"
+struct UserData;
+
+struct LabelView {
+	LabelView();
+	void WriteConfig(UserData & config);
+	void ReadConfig(strref config);
+	void Draw();
+
+	bool open;
+	char filter[128];
+};
@@ -1,30 +1,37 @@
 // support for loading listing files
 #include "struse/struse.h"
-#include "HashTable.h"
 #include "SourceDebug.h"
+#include "TextFile.h"
 #include <malloc.h>
 #include <vector>
-#include <assert.h>
+#include <algorithm>
 
+// One line entry per address so a lookup is a single load. Addresses that
+// are listed by more than one section (banks, overlays) keep the earliest
+// section in the table and the rest in a sorted overflow list.
 struct ListLineInfo
 {
-	strref m_line;
+	uint32_t m_offset;	// line text in ListFile::m_fileText
+	uint16_t m_length;
+	uint8_t m_section;	// 1 based, 0 = address not listed
 	uint8_t m_numBytes;
 	uint8_t m_bytes[7]; // for validating line, not sure needed
 };
 
-struct ListSection
+struct ListOverflow
 {
-	strref m_name;
-	strref m_type;
-	HashTable<ListLineInfo> m_lines;
+	uint16_t m_addr;
+	ListLineInfo m_info;
 };
 
 struct ListFile
 {
-	std::vector< ListSection* > m_sections;
+	ListLineInfo* m_lines;	// 64K entries
+	std::vector< ListOverflow > m_overflow;
+	std::vector< strref > m_sections;
 	void* m_fileText;
-	~ListFile() { for( auto &section : m_sections ) { delete section; } delete m_fileText; }
+	ListFile() : m_lines( (ListLineInfo*)calloc( 0x10000, sizeof( ListLineInfo ) ) ), m_fileText( nullptr ) {}
+	~ListFile() { free( m_lines ); free( m_fileText ); }
 };
 
 static ListFile* sListing = nullptr;
@@ -37,98 +44,170 @@ void ShutdownListing()
 	}
 }
 
+static strref ListingLine( const ListLineInfo* info, const uint8_t** bytes, uint8_t* numBytes )
+{
+	if( numBytes && bytes ) {
+		*numBytes = info->m_numBytes;
+		*bytes = info->m_bytes;
+	}
+	return strref( (const char*)sListing->m_fileText + info->m_offset, info->m_length );
+}
+
 strref GetListing( uint16_t address, const uint8_t** bytes, uint8_t* numBytes )
 {
 	if( sListing ) {
-		for( auto &section : sListing->m_sections ) {
-			if( ListLineInfo* info = section->m_lines.Value( address ) )
-			{
-				if( numBytes && bytes ) {
-					*numBytes = info->m_numBytes;
-					*bytes = info->m_bytes;
+		const ListLineInfo* info = sListing->m_lines + address;
+		if( info->m_section ) { return ListingLine( info, bytes, numBytes ); }
+	}
+	return strref();
+}
+
+int GetListingCount( uint16_t address )
+{
+	if( !sListing || !sListing->m_lines[ address ].m_section ) { return 0; }
+	const std::vector< ListOverflow >& over = sListing->m_overflow;
+	size_t first = std::lower_bound( over.begin(), over.end(), address,
+		[]( const ListOverflow& o, uint16_t a ) { return o.m_addr < a; } ) - over.begin();
+	size_t count = 1;
+	while( ( first + count - 1 ) < over.size() && over[ first + count - 1 ].m_addr == address ) { ++count; }
+	return (int)count;
+}
+
+strref GetListingAt( uint16_t address, int index, strref* section )
+{
+	if( index < 0 || index >= GetListingCount( address ) ) { return strref(); }
+	const ListLineInfo* info = sListing->m_lines + address;
+	if( index ) {
+		const std::vector< ListOverflow >& over = sListing->m_overflow;
+		size_t first = std::lower_bound( over.begin(), over.end(), address,
+			[]( const ListOverflow& o, uint16_t a ) { return o.m_addr < a; } ) - over.begin();
+		info = &over[ first + index - 1 ].m_info;
+	}
+	if( section ) { *section = sListing->m_sections[ info->m_section - 1 ]; }
+	return ListingLine( info, nullptr, nullptr );
+}
+
+// a section header or an address line, parsed per chunk and merged in file order
+struct ListChunkLine
+{
+	strref m_sectName;	// set for section headers
+	strref m_line;
+	uint16_t m_addr;
+	uint8_t m_numBytes;
+	uint8_t m_bytes[7];
+};
+
+typedef std::vector<ListChunkLine> ListChunk;
+
+static void ParseListingChunk( void* user, int index, strref file )
+{
+	ListChunk& chunk = ( (ListChunk*)user )[ index ];
+	while( strref line = file.line() ) {
+		if( line.get_word().same_str( "Section" ) ) {
+			// file header has a list of sections that should be ignored
+			line += 7; // len("section")
+			line.skip_whitespace();
+			strref SectName = line.get_word();
+			line.skip( SectName.get_len() );
+			line.skip_whitespace();
+			if( line.get_first() == '(' ) {
+				++line; line.skip_whitespace();
+				line.atoi_skip();
+				if( line.get_first() == ',' ) {
+					++line; line.skip_whitespace();
+					ListChunkLine sect;
+					sect.m_sectName = SectName;
+					sect.m_addr = 0;
+					chunk.push_back( sect );
+				}
+			}
+		} else if( line.get_first() == '$' ) {
+			ListChunkLine entry;
+			entry.m_numBytes = 0;
+			entry.m_line = line + 40;
+			entry.m_line.clip_trailing_whitespace();
+			++line;
+			entry.m_addr = (uint16_t)line.ahextoui_skip();
+			if( entry.m_addr ) {	// also what a line without an address reads as
+				++line;
+				while( strref::is_hex(line.get_first()) && strref::is_ws(line[2]) && entry.m_numBytes < 7 ) {
+					entry.m_bytes[ entry.m_numBytes++ ] = (uint8_t)line.ahextoui_skip();
+					++line;
 				}
-				return info->m_line;
+				chunk.push_back( entry );
 			}
 		}
 	}
-	return strref();
 }
 
 void LoadListing( const char* filename )
 {
-	FILE *f = nullptr;
-
-	if( fopen_s( &f, filename, "rb" ) == 0 ) {
+	size_t size;
+	// keep a copy of the text rather than the mapping so the assembler can rewrite the file
+	if( void* data = LoadTextFile( filename, &size ) ) {
 
 		ShutdownSourceDebug();
 		ShutdownListing();
 
-		fseek( f, 0, SEEK_END );
-		size_t size = ftell( f );
-		fseek( f, 0, SEEK_SET );
-
-		void* data = malloc( size );
-		fread( data, size, 1, f );
-		fclose( f );
-		strref file( (const char*)data, (int)size );
-		ListSection* currSection = nullptr;
+		strref file( (const char*)data, (strl_t)size );
+		uint8_t currSection = 0;
 
 		ListFile* listfile = new ListFile;
 		listfile->m_fileText = data;
-		if( file[0]==0xef && file[1]==0xbb && file[2]==0xbf ) { file +=3; }	// bom if applied
-
-		while( strref line = file.line() ) {
-			if( line.get_word().same_str( "Section" ) ) {
-				// file header has a list of sections that should be ignored
-				line += 7; // len("section")
-				line.skip_whitespace();
-				strref SectName = line.get_word();
-				line.skip( SectName.get_len() );
-				line.skip_whitespace();
-				if( line.get_first() == '(' ) {
-					++line; line.skip_whitespace();
-					int SectNum = line.atoi_skip();
-					if( line.get_first() == ',' ) {
-						++line; line.skip_whitespace();
-						strref SectType = line.get_word();
-						// check if section already listed
-						bool sectionFound = false;
-						for(auto &section : listfile->m_sections) {
-							if( section->m_name.same_str( SectName ) ) {
-								currSection = section;
-								sectionFound = true;
-								break;
-							}
-						}
-						if( !sectionFound ) {
-							ListSection* section = new ListSection;
-							section->m_name = SectName;
-							section->m_type = SectType;
-							listfile->m_sections.push_back( section );
-							currSection = listfile->m_sections[ listfile->m_sections.size() - 1 ];
+		if( file.get_len() >= 3 && (uint8_t)file[0]==0xef && (uint8_t)file[1]==0xbb && (uint8_t)file[2]==0xbf ) { file +=3; }	// bom if applied
+
+		int numChunks = TextChunkCount( file );
+		std::vector<ListChunk> chunks( numChunks );
+		ParseTextChunks( file, numChunks, ParseListingChunk, chunks.data() );
+
+		for( auto &chunk : chunks ) {
+			for( auto &entry : chunk ) {
+				if( entry.m_sectName ) {
+					// check if section already listed, sections are numbered in the order first seen
+					currSection = 0;
+					for( size_t s = 0; s < listfile->m_sections.size(); ++s ) {
+						if( listfile->m_sections[ s ].same_str( entry.m_sectName ) ) {
+							currSection = (uint8_t)( s + 1 );
+							break;
 						}
 					}
-				}
-			} else if( currSection && line.get_first() == '$' ) {
-				ListLineInfo info;
-				info.m_numBytes = 0;
-				info.m_line = line + 40;
-				info.m_line.clip_trailing_whitespace();
-				++line;
-				// if address is already used in this section ignore the new one
-				uint16_t addr = (uint16_t)line.ahextoui_skip();
-				if( addr && !currSection->m_lines.Exists(addr) ) {	// 0 is not a valid hash key
-					++line;
-					while( strref::is_hex(line.get_first()) && strref::is_ws(line[2]) && info.m_numBytes < 7 ) {
-						info.m_bytes[ info.m_numBytes++ ] = (uint8_t)line.ahextoui_skip();
-						++line;
+					if( !currSection && listfile->m_sections.size() < 255 ) {
+						listfile->m_sections.push_back( entry.m_sectName );
+						currSection = (uint8_t)listfile->m_sections.size();
 					}
-					currSection->m_lines.Insert(addr, info);
-					assert( currSection->m_lines.Value( addr ) );
+				} else if( currSection ) {
+					ListOverflow line;
+					line.m_addr = entry.m_addr;
+					line.m_info.m_offset = (uint32_t)( entry.m_line.get() - (const char*)data );
+					line.m_info.m_length = (uint16_t)( entry.m_line.get_len() < 0xffff ? entry.m_line.get_len() : 0xffff );
+					line.m_info.m_section = currSection;
+					line.m_info.m_numBytes = entry.m_numBytes;
+					memcpy( line.m_info.m_bytes, entry.m_bytes, sizeof( line.m_info.m_bytes ) );
+					ListLineInfo& info = listfile->m_lines[ entry.m_addr ];
+					if( !info.m_section ) {
+						info = line.m_info;
+					} else if( info.m_section != currSection ) {
+						// the earliest section owns the table entry, others overflow
+						if( currSection < info.m_section ) { std::swap( info, line.m_info ); }
+						listfile->m_overflow.push_back( line );
+					}	// if address is already used in this section ignore the new one
 				}
 			}
 		}
 
+		// sort overflow by address then section, and only keep the first line of a section
+		std::stable_sort( listfile->m_overflow.begin(), listfile->m_overflow.end(), []( const ListOverflow& a, const ListOverflow& b ) {
+			return a.m_addr != b.m_addr ? a.m_addr < b.m_addr : a.m_info.m_section < b.m_info.m_section; } );
+		size_t kept = 0;
+		for( size_t o = 0; o < listfile->m_overflow.size(); ++o ) {
+			const ListOverflow& line = listfile->m_overflow[ o ];
+			if( !kept || listfile->m_overflow[ kept - 1 ].m_addr != line.m_addr || listfile->m_overflow[ kept - 1 ].m_info.m_section != line.m_info.m_section ) {
+				listfile->m_overflow[ kept++ ] = line;
+			}
+		}
+		listfile->m_overflow.resize( kept );
+		listfile->m_overflow.shrink_to_fit();
+
 		if( sListing ) {
 			delete sListing;
 		}
@@ -1,6 +1,9 @@
 #pragma once
 
 strref GetListing( uint16_t address, const uint8_t** bytes, uint8_t* numBytes );
+// every section listing an address, index 0 is the line GetListing returns
+int GetListingCount( uint16_t address );
+strref GetListingAt( uint16_t address, int index, strref* section );
 void LoadListing( const char* filename );
 void ShutdownListing();
 
@@ -13,7 +13,7 @@
 static const char* memDefaultAddr = "$0400";
 static const char* memDefaultSpan = "0";
 
-MemView::MemView() : open(false), fixedAddress(false), evalAddress(false)
+MemView::MemView() : heatMode(Heat_Off), open(false), fixedAddress(false), evalAddress(false)
 {
 	SetAddr(0x400);
 
@@ -33,6 +33,30 @@ MemView::MemView() : open(false), fixedAddress(false), evalAddress(false)
 
 #define CursorFlashPeriod 64.0f/50.0f
 
+// heat fades out over roughly a second of emulated time
+#define HeatRecentCycles 1000000
+
+// red for writes, green for reads, blue for execution, 0 if cold
+uint32_t MemView::HeatColor(uint16_t addr)
+{
+	uint32_t rgb[HEAT_ACCESS_TYPES];
+	uint32_t sum = 0;
+	for (int t = 0; t < HEAT_ACCESS_TYPES; ++t) {
+		uint32_t i = 0;
+		if (heatMode == Heat_Recent) {
+			uint32_t age = GetHeatAge(addr, (HeatAccess)t);
+			if (age < HeatRecentCycles) { i = 255 - age / (HeatRecentCycles / 255 + 1); }
+		} else if (uint32_t count = GetHeatCount(addr, (HeatAccess)t)) {
+			while (count) { i += 24; count >>= 1; }	// log scale
+			if (i > 255) { i = 255; }
+		}
+		rgb[t] = i;
+		sum += i;
+	}
+	if (!sum) { return 0; }
+	return ImColor(int(rgb[HEAT_WRITE]), int(rgb[HEAT_READ]), int(rgb[HEAT_EXEC]), 128);
+}
+
 uint8_t ScreenToAscii(uint8_t s)
 {
 	if (s==0) { return '@'; }
@@ -75,7 +99,7 @@ void MemView::Draw(int index)
 		strown<64> field("address##");
 		field.append_num(index+1, 1, 10);
 		ImGui::Columns(2, "memViewCokumns", false);  // 3-ways, no border
-		if (ImGui::InputText(field.c_str(), address, sizeof(address), ImGuiInputTextFlags_EnterReturnsTrue)) {
+		if (ImGui::InputText(field.c_str(), address, sizeof(address), ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback)) {
 			fixedAddress = address[0]=='=';
 			SetAddr(ValueFromExpression(address+(fixedAddress ? 1 : 0)));
 		}
@@ -106,6 +130,14 @@ void MemView::Draw(int index)
 		ImGui::Checkbox("hex", &showHex);
 		ImGui::SameLine();
 		ImGui::Checkbox("text", &showText);
+		ImGui::SameLine();
+		strown<32> heatName("heat##");
+		heatName.append_num(index+1, 1, 10);
+		ImGui::PushItemWidth(fontCharWidth * 12);
+		if (ImGui::Combo(heatName.c_str(), &heatMode, "Off\0Recent\0Frequent\0\0") && heatMode != Heat_Off) {
+			EnableHeatmap(true);
+		}
+		ImGui::PopItemWidth();
 	}
 
 
@@ -166,6 +198,17 @@ void MemView::Draw(int index)
 			if (showAddress) { line.append_num(read, 4, 16).append(' ');  }
 			if (showHex) {
 				uint16_t bytes = read;
+				if (heatMode != Heat_Off && IsHeatmapEnabled()) {
+					ImVec2 p = ImGui::GetCursorScreenPos();
+					p.x += fontCharWidth * (showAddress ? 5 : 0);
+					ImDrawList* draw = ImGui::GetWindowDrawList();
+					for (uint32_t c = 0; c<spanWin; ++c) {
+						if (uint32_t col = HeatColor(uint16_t(bytes+c))) {
+							ImVec2 h(p.x + fontCharWidth * 3 * c, p.y);
+							draw->AddRectFilled(h, ImVec2(h.x+fontCharWidth*2, h.y+fontCharHeight), col);
+						}
+					}
+				}
 				for (uint32_t c = 0; c<spanWin; ++c) {
 					line.append_num(Get6502Byte(bytes++), 2, 16).append(' ');
 				}
@@ -242,6 +285,7 @@ void MemView::WriteConfig(UserData& config)
 	config.AddValue(strref("showAddress"), config.OnOff(showAddress));
 	config.AddValue(strref("showHex"), config.OnOff(showHex));
 	config.AddValue(strref("showText"), config.OnOff(showText));
+	config.AddValue(strref("heat"), heatMode);
 }
 
 void MemView::ReadConfig(strref config)
@@ -264,6 +308,9 @@ void MemView::ReadConfig(strref config)
 			showHex = !value.same_str("Off");
 		} else if (name.same_str("showText")&&type==CPT_Value) {
 			showText = !value.same_str("Off");
+		} else if (name.same_str("heat")&&type==CPT_Value) {
+			heatMode = (int)value.atoi();
+			if (heatMode != Heat_Off) { EnableHeatmap(true); }
 		}
 	}
 }
@@ -11,6 +11,7 @@ struct MemView {
 	uint32_t spanValue;
 
 	int cursor[2];
+	int heatMode;
 
 	MemView();
 
@@ -26,7 +27,14 @@ struct MemView {
 	bool open;
 	bool evalAddress;
 
+	enum HeatMode {
+		Heat_Off,
+		Heat_Recent,
+		Heat_Frequent
+	};
+
 	void SetAddr(uint16_t addr);
+	uint32_t HeatColor(uint16_t addr);
 	void Draw(int index);
 	void WriteConfig(UserData& config);
 	void ReadConfig(strref config);
@@ -1,3 +1,13 @@
+#include <stdlib.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+#include <string.h>
 #include "platform.h"
 
 void IBMutexInit(IBMutex* mutex, const char* name)
@@ -71,4 +81,275 @@ bool IBDestroyThread(IBThread* thread)
 #endif
 }
 
+int IBNumCores()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+#endif
+}
+
+struct IBParallelJob {
+	IBParallelFunc func;
+	void* user;
+	int index;
+	bool started;
+	IBThread thread;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI IBParallelRun(void* data)
+{
+	IBParallelJob* job = (IBParallelJob*)data;
+	job->func(job->user, job->index);
+	return 0;
+}
+#else
+static void* IBParallelRun(void* data)
+{
+	IBParallelJob* job = (IBParallelJob*)data;
+	job->func(job->user, job->index);
+	return nullptr;
+}
+#endif
+
+void IBParallelFor(int count, IBParallelFunc func, void* user)
+{
+	if (count <= 0) { return; }
+	IBParallelJob* jobs = count > 1 ? (IBParallelJob*)calloc(count, sizeof(IBParallelJob)) : nullptr;
+	if (!jobs) {
+		for (int i = 0; i < count; ++i) { func(user, i); }
+		return;
+	}
+	for (int i = 1; i < count; ++i) {
+		IBParallelJob& job = jobs[i];
+		job.func = func;
+		job.user = user;
+		job.index = i;
+#ifdef _WIN32
+		job.thread = CreateThread(nullptr, 0, IBParallelRun, &job, 0, nullptr);
+		job.started = job.thread != nullptr;
+#else
+		job.started = pthread_create(&job.thread, nullptr, IBParallelRun, &job) == 0;
+#endif
+		if (!job.started) { func(user, i); }
+	}
+	func(user, 0);
+	for (int i = 1; i < count; ++i) {
+		if (!jobs[i].started) { continue; }
+#ifdef _WIN32
+		WaitForSingleObject(jobs[i].thread, INFINITE);
+		CloseHandle(jobs[i].thread);
+#else
+		pthread_join(jobs[i].thread, nullptr);
+#endif
+	}
+	free(jobs);
+}
+
+bool IBMapFile(IBMappedFile* map, const char* filename, size_t size)
+{
+	bool write = size != 0;
+	map->data = nullptr;
+	map->size = 0;
+#ifdef _WIN32
+	map->map = NULL;
+	map->file = CreateFileA(filename, GENERIC_READ | (write ? GENERIC_WRITE : 0), FILE_SHARE_READ, NULL,
+							write ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (map->file == INVALID_HANDLE_VALUE) { return false; }
+	if (!write) {
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(map->file, &fileSize) || !fileSize.QuadPart) {
+			CloseHandle(map->file);
+			return false;
+		}
+		size = (size_t)fileSize.QuadPart;
+	}
+	// a writable mapping larger than the file grows the file
+	map->map = CreateFileMappingA(map->file, NULL, write ? PAGE_READWRITE : PAGE_READONLY,
+								  (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+	if (map->map) {
+		map->data = MapViewOfFile(map->map, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	}
+	if (!map->data) {
+		if (map->map) { CloseHandle(map->map); }
+		CloseHandle(map->file);
+		return false;
+	}
+#else
+	map->fd = open(filename, write ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (map->fd < 0) { return false; }
+	struct stat st;
+	if (fstat(map->fd, &st) != 0 || (!write && !st.st_size) ||
+		(write && (size_t)st.st_size < size && ftruncate(map->fd, size) != 0)) {
+		close(map->fd);
+		return false;
+	}
+	if (!write) { size = (size_t)st.st_size; }
+	void* data = mmap(nullptr, size, write ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, map->fd, 0);
+	if (data == MAP_FAILED) {
+		close(map->fd);
+		return false;
+	}
+	map->data = data;
+#endif
+	map->size = size;
+	return true;
+}
 
+void IBUnmapFile(IBMappedFile* map, size_t truncateTo)
+{
+	if (!map->data) { return; }
+#ifdef _WIN32
+	UnmapViewOfFile(map->data);
+	CloseHandle(map->map);
+	if (truncateTo) {
+		LARGE_INTEGER pos;
+		pos.QuadPart = (LONGLONG)truncateTo;
+		if (SetFilePointerEx(map->file, pos, NULL, FILE_BEGIN)) { SetEndOfFile(map->file); }
+	}
+	CloseHandle(map->file);
+#else
+	munmap(map->data, map->size);
+	if (truncateTo && ftruncate(map->fd, truncateTo) != 0) {}
+	close(map->fd);
+#endif
+	map->data = nullptr;
+	map->size = 0;
+}
+
+#define IB_WATCH_MAX_FILES 8
+#define IB_WATCH_MAX_PATH 260
+
+struct IBFileWatch {
+	int count;
+	const char* name[IB_WATCH_MAX_FILES];		// file name part of path
+	char path[IB_WATCH_MAX_FILES][IB_WATCH_MAX_PATH];
+#ifdef _WIN32
+	HANDLE dir[IB_WATCH_MAX_FILES];				// shared between files in the same folder
+	FILETIME written[IB_WATCH_MAX_FILES];
+#else
+	int fd;
+	int wd[IB_WATCH_MAX_FILES];
+#endif
+};
+
+#ifdef _WIN32
+static FILETIME IBFileWriteTime(const char* filename)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (GetFileAttributesExA(filename, GetFileExInfoStandard, &attr)) { return attr.ftLastWriteTime; }
+	FILETIME none = {};
+	return none;
+}
+#endif
+
+IBFileWatch* IBCreateFileWatch(const char** filenames, int count)
+{
+	IBFileWatch* watch = (IBFileWatch*)calloc(1, sizeof(IBFileWatch));
+	if (!watch) { return nullptr; }
+#ifndef _WIN32
+	watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch->fd < 0) {
+		free(watch);
+		return nullptr;
+	}
+#endif
+	// every file keeps its index in changed[], files that can't be watched never change
+	watch->count = count < IB_WATCH_MAX_FILES ? count : IB_WATCH_MAX_FILES;
+	for (int i = 0; i < watch->count; ++i) {
+#ifndef _WIN32
+		watch->wd[i] = -1;
+#endif
+		size_t len = strlen(filenames[i]);
+		if (!len || len >= IB_WATCH_MAX_PATH) { continue; }
+		memcpy(watch->path[i], filenames[i], len + 1);
+		char* name = watch->path[i] + len;
+		while (name > watch->path[i] && name[-1] != '/' && name[-1] != '\\') { --name; }
+		watch->name[i] = name;
+		char dir[IB_WATCH_MAX_PATH];
+		size_t dirLen = name - watch->path[i];
+		memcpy(dir, watch->path[i], dirLen);
+		if (!dirLen) { dir[dirLen++] = '.'; }
+		dir[dirLen] = 0;
+#ifdef _WIN32
+		for (int d = 0; d < i && !watch->dir[i]; ++d) {
+			if (watch->dir[d] && (watch->name[d] - watch->path[d]) == (int)(name - watch->path[i]) && !_strnicmp(watch->path[d], watch->path[i], name - watch->path[i])) {
+				watch->dir[i] = watch->dir[d];
+			}
+		}
+		if (!watch->dir[i]) {
+			HANDLE h = FindFirstChangeNotificationA(dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+			if (h == INVALID_HANDLE_VALUE) { continue; }
+			watch->dir[i] = h;
+		}
+		watch->written[i] = IBFileWriteTime(watch->path[i]);
+#else
+		// the same folder added again returns the same descriptor
+		watch->wd[i] = inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+#endif
+	}
+	return watch;
+}
+
+bool IBPollFileWatch(IBFileWatch* watch, bool* changed)
+{
+	bool any = false;
+	for (int i = 0; i < watch->count; ++i) { changed[i] = false; }
+#ifdef _WIN32
+	// a folder notification only says something changed, compare write times to find the files
+	bool signaled[IB_WATCH_MAX_FILES] = {};
+	for (int i = 0; i < watch->count; ++i) {
+		if (!watch->dir[i]) { continue; }
+		bool shared = false;
+		for (int d = 0; d < i; ++d) {
+			if (watch->dir[d] == watch->dir[i]) { signaled[i] = signaled[d]; shared = true; break; }
+		}
+		if (!shared && WaitForSingleObject(watch->dir[i], 0) == WAIT_OBJECT_0) {
+			signaled[i] = true;
+			FindNextChangeNotification(watch->dir[i]);
+		}
+		if (signaled[i]) {
+			FILETIME written = IBFileWriteTime(watch->path[i]);
+			if (CompareFileTime(&written, &watch->written[i]) != 0) {
+				watch->written[i] = written;
+				changed[i] = any = true;
+			}
+		}
+	}
+#else
+	// events are only sent once a file is closed after writing or moved in place
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(watch->fd, buf, sizeof(buf))) > 0) {
+		for (char* ptr = buf; ptr < buf + len; ) {
+			const struct inotify_event* event = (const struct inotify_event*)ptr;
+			for (int i = 0; i < watch->count && event->len; ++i) {
+				if (watch->wd[i] >= 0 && watch->wd[i] == event->wd && !strcmp(watch->name[i], event->name)) { changed[i] = any = true; }
+			}
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
+	}
+#endif
+	return any;
+}
+
+void IBDestroyFileWatch(IBFileWatch* watch)
+{
+	if (!watch) { return; }
+#ifdef _WIN32
+	for (int i = 0; i < watch->count; ++i) {
+		if (!watch->dir[i]) { continue; }
+		bool shared = false;
+		for (int d = 0; d < i; ++d) { shared = shared || watch->dir[d] == watch->dir[i]; }
+		if (!shared) { FindCloseChangeNotification(watch->dir[i]); }
+	}
+#else
+	close(watch->fd);
+#endif
+	free(watch);
+}
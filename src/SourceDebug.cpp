@@ -4,6 +4,7 @@
 #include "Sym.h"
 #include "ViceConnect.h"
 #include "Listing.h"
+#include "TextFile.h"
 #include <malloc.h>
 #include <vector>
 
@@ -13,115 +14,290 @@
 //	Segments => segment names, addresses & line numbers
 //	Labels => segment, name, address
 
-struct SourceDebugLine {
-	const char* line;
-	uint8_t len;		// no purpose in showing >255 chars
-	uint8_t spaces;		// for easy white space scaling
+// The parsed debug info is compiled into a flat table with one compact line
+// reference per address, so finding the source of an address is one load.
+// Each source file also maps its lines back to the address range they built.
+struct SourceLineRef {
+	uint32_t line;		// 1 based, 0 = no source at this address
+	uint16_t file;
 	uint8_t block;		// not quite sure how blocks are useful but..
+	uint8_t segment;	// earlier segments own their addresses while loading
 };
 
-struct SourceDebugSegment {
-	enum { MAX_SEG_NAME_LEN = 64 };
-	uint16_t addrFirst, addrLast;
-	SourceDebugLine* lines;
-	strref* blockNames;	// indexed by lines->block
-	strref name;
+struct SourceLineRange {
+	uint16_t first, last;	// first > last if the line built no code
+};
+
+// Source files are mapped the first time a line is shown and their line
+// offsets are built then. When the mapped total goes over the budget the
+// least recently used files are unmapped again along with their offsets,
+// the file may have changed by the time it is mapped again.
+struct SourceDebugFile {
+	strown<MAX_PATH> path;
+	IBMappedFile map;
+	uint64_t lastUse;
+	bool missing;						// could not be mapped, don't retry every frame
+	std::vector<uint32_t> lineOffsets;	// line index -> buffer offset
+	std::vector<SourceLineRange> lineRanges;	// sized by the highest line in the debug info
+};
+
+struct SourceBlockName {
+	uint32_t offset, length;	// in SourceDebug::nameText
+	uint32_t segment;			// blocks are only shared within a segment
 };
 
 struct SourceDebug {
-	std::vector<SourceDebugSegment> segments; // contains blocks which contains lines
-	std::vector<void*> files; // segments reference strings in these files directly
+	SourceLineRef* addrToSource;			// 64K entries
+	std::vector<SourceDebugFile*> files;
+	std::vector<SourceBlockName> blockNames;	// indexed by SourceLineRef::block
+	std::vector<char> nameText;				// block names, the debug file is closed after loading
 };
 
 SourceDebug* sSourceDebug = nullptr;
 
+static size_t sSourceMemoryBudget = 64 * 1024 * 1024;
+static size_t sSourceMappedBytes = 0;
+static uint64_t sSourceUseCount = 0;
+
+static void UnmapSource(SourceDebugFile* src)
+{
+	if (src->map.data) {
+		sSourceMappedBytes -= src->map.size;
+		IBUnmapFile(&src->map);
+	}
+	src->lineOffsets.clear();
+	src->lineOffsets.shrink_to_fit();
+}
+
+// unmap least recently used sources until the mapped total fits, except keep
+static void TrimSources(const SourceDebugFile* keep)
+{
+	while (sSourceDebug && sSourceMappedBytes > sSourceMemoryBudget) {
+		SourceDebugFile* oldest = nullptr;
+		for (size_t f = 0, n = sSourceDebug->files.size(); f < n; ++f) {
+			SourceDebugFile* src = sSourceDebug->files[f];
+			if (src && src != keep && src->map.data && (!oldest || src->lastUse < oldest->lastUse)) { oldest = src; }
+		}
+		if (!oldest) { break; }
+		UnmapSource(oldest);
+	}
+}
+
+static SourceDebugFile* UseSource(uint16_t file)
+{
+	if (file >= sSourceDebug->files.size()) { return nullptr; }
+	SourceDebugFile* src = sSourceDebug->files[file];
+	if (!src || src->missing) { return nullptr; }
+	if (!src->map.data) {
+		if (!IBMapFile(&src->map, src->path.c_str())) {
+			src->missing = true;
+			return nullptr;
+		}
+		sSourceMappedBytes += src->map.size;
+		const char* start = (const char*)src->map.data;
+		strref read(start, (strl_t)src->map.size);
+		src->lineOffsets.reserve(read.count_lines());
+		while (read) {
+			strref num_line = read.next_line();
+			src->lineOffsets.push_back((uint32_t)(num_line.get() - start));
+		}
+		TrimSources(src);
+	}
+	src->lastUse = ++sSourceUseCount;
+	return src;
+}
+
+static strref SourceLine(const SourceDebugFile* file, uint32_t line)
+{
+	if (!file || !file->map.data || !line || line > file->lineOffsets.size()) { return strref(); }
+	strref text((const char*)file->map.data, (strl_t)file->map.size);
+	text += file->lineOffsets[line - 1];
+	return text.get_line();
+}
+
+// the returned text stays valid until the next call, other sources may be unmapped then
 strref GetSourceAt(uint16_t addr, int &spaces)
 {
 	if (sSourceDebug) {
-		for (size_t s = 0, n = sSourceDebug->segments.size(); s < n; ++s) {
-			const SourceDebugSegment& seg = sSourceDebug->segments[s];
-			if (seg.addrFirst <= addr && seg.addrLast >= addr) {
-				const SourceDebugLine& line = seg.lines[addr - seg.addrFirst];
-				if (line.line) {
-					spaces = line.spaces;
-					return strref(line.line, (strl_t)line.len);
-				}
+		const SourceLineRef& ref = sSourceDebug->addrToSource[addr];
+		if (ref.line) {
+			strref line = SourceLine(UseSource(ref.file), ref.line);
+			int indent = 0;
+			while (line && line.get_first() <= 0x20 && indent < 255) {
+				indent += line.get_first() == '\t' ? 4 : 1;
+				++line;
+			}
+			if (line) {
+				spaces = indent < 255 ? indent : 255;
+				return strref(line.get(), line.get_len() < 256 ? line.get_len() : 255);
 			}
 		}
 	}
 	return strref();
 }
 
-void ShutdownSourceDebug()
+void SetSourceMemoryBudget(size_t bytes)
 {
-	if (SourceDebug* dbg = sSourceDebug) {
-		sSourceDebug = nullptr;
-		while (dbg->segments.size()) {
-			SourceDebugSegment& seg = dbg->segments[dbg->segments.size() - 1];
-			free(seg.lines);
-			free(seg.blockNames);
-			dbg->segments.pop_back();
+	sSourceMemoryBudget = bytes;
+	TrimSources(nullptr);
+}
+
+size_t GetSourceMemoryBudget(size_t *mapped)
+{
+	if (mapped) { *mapped = sSourceMappedBytes; }
+	return sSourceMemoryBudget;
+}
+
+bool GetSourceLocation(uint16_t addr, strref &file, uint32_t &line, strref &block)
+{
+	if (sSourceDebug) {
+		const SourceLineRef& ref = sSourceDebug->addrToSource[addr];
+		if (ref.line) {
+			file = sSourceDebug->files[ref.file]->path.get_strref();
+			line = ref.line;
+			block.clear();
+			if (ref.block < 255 && ref.block < sSourceDebug->blockNames.size()) {
+				const SourceBlockName& name = sSourceDebug->blockNames[ref.block];
+				block = strref(sSourceDebug->nameText.data() + name.offset, (strl_t)name.length);
+			}
+			return true;
 		}
-		while (dbg->files.size()) {
-			free(dbg->files[dbg->files.size() - 1]);
-			dbg->files.pop_back();
+	}
+	return false;
+}
+
+// file matches the end of a source path, so just the file name is enough
+bool GetSourceLineAddress(strref file, uint32_t line, uint16_t &first, uint16_t &last)
+{
+	if (sSourceDebug && line) {
+		for (size_t f = 0, n = sSourceDebug->files.size(); f < n; ++f) {
+			const SourceDebugFile* src = sSourceDebug->files[f];
+			if (!src || line > src->lineRanges.size()) { continue; }
+			strref path = src->path.get_strref();
+			if (path.get_len() < file.get_len() || !path.get_substr(path.get_len() - file.get_len(), file.get_len()).same_str(file)) { continue; }
+			if (path.get_len() > file.get_len()) {
+				char sep = path[path.get_len() - file.get_len() - 1];
+				if (sep != '/' && sep != '\\') { continue; }
+			}
+			const SourceLineRange& range = src->lineRanges[line - 1];
+			if (range.first <= range.last) {
+				first = range.first;
+				last = range.last;
+				return true;
+			}
 		}
-		free(dbg);
 	}
+	return false;
 }
 
-void* LoadFile(const char* filename, size_t* size)
+static void FreeSourceDebug(SourceDebug* dbg)
 {
-	FILE *f;
-	if (fopen_s(&f, filename, "rb") == 0 && f) {
-		fseek(f, 0, SEEK_END);
-		*size = ftell(f);
-		fseek(f, 0, SEEK_SET);
-		if (void *voidbuf = malloc(*size)) {
-			fread(voidbuf, *size, 1, f);
-			fclose(f);
-			return voidbuf;
-		} else {
-			fclose(f);
+	for (size_t f = 0; f < dbg->files.size(); ++f) {
+		if (dbg->files[f]) {
+			UnmapSource(dbg->files[f]);
+			delete dbg->files[f];
 		}
 	}
-	return nullptr;
+	free(dbg->addrToSource);
+	delete dbg;
 }
 
-// These structs are for parsing the XML, gets converted to a SourceDebug when all is available
+void ShutdownSourceDebug()
+{
+	if (SourceDebug* dbg = sSourceDebug) {
+		sSourceDebug = nullptr;
+		FreeSourceDebug(dbg);
+	}
+}
 
-struct ParseDebugSource {
-	void* file;
-	size_t size;
-	// temp line index -> buffer offset
-	std::vector<uint32_t> lineOffsets;
+// The XML is read in one pass and each block line is written straight into
+// the address table as it arrives. Segments are numbered in file order and
+// an address written by an earlier segment is not replaced by a later one,
+// within a segment the last line for an address wins.
+struct ParseDebugText {
+	strref path; // the path from the filename with the trailing slash, or empty
+	strref segment;
+	std::vector<strref> segments;	// names in the order first seen
+	SourceDebug* dbg;
 };
 
-struct ParseDebugLine {
-	strref line;
-	uint16_t first, last;
-};
+// a segment that appears again keeps the precedence of its first appearance
+static uint32_t DebugSegmentIndex(ParseDebugText* parse)
+{
+	for (size_t s = 0, n = parse->segments.size(); s < n; ++s) {
+		if (parse->segments[s].same_str(parse->segment)) { return (uint32_t)s; }
+	}
+	parse->segments.push_back(parse->segment);
+	return (uint32_t)(parse->segments.size() - 1);
+}
 
-struct ParseDebugBlock {
-	strref name;
-	std::vector<ParseDebugLine> lines;
-};
+// blocks with the same name in the same segment share an index, 255 = unnamed
+static uint8_t DebugBlockIndex(SourceDebug* dbg, strref name, uint32_t segment)
+{
+	for (size_t b = 0, n = dbg->blockNames.size(); b < n; ++b) {
+		const SourceBlockName& blk = dbg->blockNames[b];
+		if (blk.segment == segment && strref(dbg->nameText.data() + blk.offset, (strl_t)blk.length).same_str_case(name)) {
+			return b < 255 ? (uint8_t)b : 255;
+		}
+	}
+	SourceBlockName blk = { (uint32_t)dbg->nameText.size(), (uint32_t)name.get_len(), segment };
+	dbg->nameText.insert(dbg->nameText.end(), name.get(), name.get() + name.get_len());
+	dbg->blockNames.push_back(blk);
+	return dbg->blockNames.size() <= 255 ? (uint8_t)(dbg->blockNames.size() - 1) : 255;
+}
 
-struct ParseDebugSegment {
-	strref name;
-	std::vector<ParseDebugBlock*> blocks;
-};
+static void AddDebugLine(SourceDebug* dbg, uint32_t row, uint16_t file, uint16_t first, uint16_t last, uint8_t block, uint8_t segment)
+{
+	if (first > last) { return; }
+	SourceDebugFile* src = dbg->files[file];
+	if (row > src->lineRanges.size()) {
+		SourceLineRange none = { 0xffff, 0x0000 };
+		src->lineRanges.resize(row, none);
+	}
+	for (uint32_t a = first; a <= last; ++a) {
+		SourceLineRef& ref = dbg->addrToSource[a];
+		if (!ref.line || ref.segment >= segment) {
+			ref.line = row;
+			ref.file = file;
+			ref.block = block;
+			ref.segment = segment;
+		}
+	}
+	// keep the lowest contiguous range built by the line
+	SourceLineRange& range = src->lineRanges[row - 1];
+	if (range.first > range.last || first < range.first) {
+		range.first = first;
+		range.last = last;
+	} else if (first == (range.last + 1)) {
+		range.last = last;
+	}
+}
 
-struct ParseDebugText {
-	strref path; // the path from the filename with the trailing slash, or empty
-	strref segment;
-	std::vector<ParseDebugSource*> files;
-	std::vector<ParseDebugSegment*> segments;
-};
+// reads one comma separated number of a block line, stops at the end of the line
+static bool DebugField(const char* &text, const char* end, uint32_t base, uint32_t &value)
+{
+	while (text < end && (*text == ' ' || *text == '\t' || *text == '\r')) { ++text; }
+	if (text < end && *text == '$') { ++text; }
+	const char* first = text;
+	value = 0;
+	while (text < end) {
+		uint32_t c = (uint8_t)*text, d;
+		if (c >= '0' && c <= '9') { d = c - '0'; }
+		else if (base == 16 && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') { d = (c | 0x20) - 'a' + 10; }
+		else { break; }
+		if (value < 0x10000000) { value = value * base + d; }
+		++text;
+	}
+	if (text == first) { return false; }
+	while (text < end && (*text == ' ' || *text == '\t' || *text == '\r')) { ++text; }
+	if (text < end && *text == ',') { ++text; }
+	return true;
+}
 
 bool C64DbgXMLCB(void* user, strref tag_or_data, const strref* tag_stack, int size_stack, XML_TYPE type)
 {
 	ParseDebugText* parse = (ParseDebugText*)user;
+	SourceDebug* dbg = parse->dbg;
 
 	if (type == XML_TYPE_TEXT && size_stack) {
 		if (tag_stack->get_word().same_str("Sources")) {
@@ -129,76 +305,41 @@ bool C64DbgXMLCB(void* user, strref tag_or_data, const strref* tag_stack, int si
 			while (strref line = tag_or_data.line()) {
 				strref idstr = line.split_token_trim(',');
 				uint32_t id = (uint32_t)idstr.atoi();
-				strown<MAX_PATH> file;
-				if (line.find(':') < 0) { file.append(parse->path); }
-				file.append(line);
-				while (parse->files.size() <= id) { parse->files.push_back(nullptr); }
-				ParseDebugSource* source = new ParseDebugSource();
-				parse->files[id] = source;
-				source->file = LoadFile(file.c_str(), &source->size);
-				if (source->file) {
-					const char* start = (const char*)source->file;
-					strref read(start, (strl_t)source->size);
-					source->lineOffsets.reserve(read.count_lines());
-					while (read) {
-						strref num_line = read.next_line();
-						source->lineOffsets.push_back((uint32_t)(num_line.get() - start));
-					}
-				}
+				if (id >= 0xffff) { continue; }
+				if (dbg->files.size() <= id) { dbg->files.resize(id + 1, nullptr); }
+				if (dbg->files[id]) { continue; }
+				SourceDebugFile* source = new SourceDebugFile();
+				if (line.find(':') < 0) { source->path.append(parse->path); }
+				source->path.append(line);
+				source->map.data = nullptr;
+				source->map.size = 0;
+				source->lastUse = 0;
+				source->missing = false;
+				dbg->files[id] = source;
 			}
 		} else if (tag_stack->get_word().same_str("Block")) {
-			ParseDebugSegment* seg = nullptr;
-			for (size_t s = 0; s < parse->segments.size(); ++s) {
-				if (parse->segments[s]->name.same_str(parse->segment)) {
-					seg = parse->segments[s]; break;
-				}
-			}
-			if (!seg) {
-				seg = new ParseDebugSegment;
-				seg->name = parse->segment;
-				parse->segments.push_back(seg);
-			}
-			strref blockName = XMLFindAttr(tag_or_data, strref("name"));
-			ParseDebugBlock* block = nullptr;
-			for (size_t b = 0; b < seg->blocks.size(); ++b) {
-				if (seg->blocks[b]->name.same_str_case(blockName)) {
-					block = seg->blocks[b]; break;
-				}
-			}
-			if (!block) {
-				block = new ParseDebugBlock;
-				block->name = blockName;
-				seg->blocks.push_back(block);
-			}
-			while (strref line = tag_or_data.line()) {
-				strref start = line.split_token_trim(',');
-				strref last = line.split_token_trim(',');
-				strref file = line.split_token_trim(',');
-				strref row = line.split_token_trim(','); // line is now col, last line, last col
-				if (start && last && file && row) {
-					if (start.get_first() == '$') { ++start; }
-					if (last.get_first() == '$') { ++last; }
-					size_t file_num = file.atoui();
-					if (file_num < parse->files.size()) {
-						ParseDebugSource* source = parse->files[file_num];
-						size_t row_num = row.atoui();
-						if (row_num && source->file && row_num <= source->lineOffsets.size()) {
-							strref srcTxt = strref((const char*)source->file, strl_t(source->size));
-							srcTxt += source->lineOffsets[row_num - 1];	// debug lines start at 1!
-							strref srcLine = srcTxt.get_line();
-							if (srcLine) {
-								ParseDebugLine dbgLine = { srcLine, (uint16_t)start.ahextoui(), (uint16_t)last.ahextoui() };
-								block->lines.push_back(dbgLine);
-							}
-						}
-					}
+			uint32_t segIndex = DebugSegmentIndex(parse);
+			uint8_t block = DebugBlockIndex(dbg, XMLFindAttr(*tag_stack, strref("name")), segIndex);
+			uint8_t segment = segIndex < 255 ? (uint8_t)segIndex : 255;
+			// lines are start, end, file, line, col, last line, last col
+			const char* text = tag_or_data.get();
+			const char* end = text + tag_or_data.get_len();
+			while (text < end) {
+				uint32_t start, last, file, row;
+				bool valid = DebugField(text, end, 16, start) && DebugField(text, end, 16, last) &&
+					DebugField(text, end, 10, file) && DebugField(text, end, 10, row);
+				// sources are not read here, lines past the end of a file show nothing later
+				if (valid && file < dbg->files.size() && dbg->files[file] && row && row < 0x1000000) {
+					AddDebugLine(dbg, row, (uint16_t)file, (uint16_t)start, (uint16_t)last, block, segment);
 				}
+				while (text < end && *text != '\n') { ++text; }
+				if (text < end) { ++text; }
 			}
 		} else if (tag_stack->get_word().same_str("Labels")) {
 			tag_or_data.trim_whitespace();
 			if (tag_or_data) {
 				ViceSetUpdateSymbols(false);
-				ShutdownSymbols();
+				ResetSymbols();
 				while (strref label = tag_or_data.line()) {
 					strref seg = label.split_token_trim(',');
 					strref addr = label.split_token_trim(',');
@@ -207,6 +348,7 @@ bool C64DbgXMLCB(void* user, strref tag_or_data, const strref* tag_stack, int si
 						AddSymbol((uint16_t)addr.ahextoui(), label.get(), label.get_len());
 					}
 				}
+				SortSymbols();
 			}
 		}
 	} else if (type == XML_TYPE_TAG_OPEN) {
@@ -223,84 +365,18 @@ void ReadC64DbgSrc(const char* filename)
 	parse.path = strref(filename).before_last('/', '\\');
 	parse.segment.clear(); // just in case there are blocks without segments I guess
 	if (parse.path.get_len()) { parse.path = strref(parse.path.get(), parse.path.get_len() + 1); }
-	size_t size;
-	if (void* voidbuf = LoadFile(filename, &size)) {
-		if (ParseXML(strref((const char*)voidbuf, (strl_t)size), C64DbgXMLCB, &parse)) {
+	TextFile text;
+	if (OpenTextFile(text, filename)) {
+		SourceDebug* dbg = new SourceDebug;
+		dbg->addrToSource = (SourceLineRef*)calloc(0x10000, sizeof(SourceLineRef));
+		parse.dbg = dbg;
+		if (ParseXML(text.text, C64DbgXMLCB, &parse)) {
 			ShutdownSourceDebug();
 			ShutdownListing();
-
-			SourceDebug* dbg = new SourceDebug;
 			sSourceDebug = dbg;
-
-			// remember the file pointers for later cleanup
-			dbg->files.reserve(parse.files.size());
-			for (size_t f = 0; f < parse.files.size(); ++f) { dbg->files.push_back(parse.files[f]->file); }
-
-			// segments depend on if they have data or not, could be empty.
-			for (size_t s = 0; s < parse.segments.size(); ++s) {
-				ParseDebugSegment* seg = parse.segments[s];
-
-				// determine address range of segment
-				uint16_t addrFirst = 0xffff, addrLast = 0x0000;
-				for (size_t b = 0; b < seg->blocks.size(); ++b) {
-					ParseDebugBlock* blk = seg->blocks[b];
-					for (size_t l = 0; l < blk->lines.size(); ++l) {
-						ParseDebugLine* lin = &blk->lines[l];
-						if (addrFirst > lin->first) { addrFirst = lin->first; }
-						if (addrLast < lin->last) { addrLast = lin->last; }
-					}
-				}
-
-				// segment not empty -> add it!
-				if (addrFirst <= addrLast) {
-					dbg->segments.push_back(SourceDebugSegment());
-					SourceDebugSegment* segSrc = &dbg->segments[dbg->segments.size() - 1];
-					segSrc->addrFirst = addrFirst;
-					segSrc->addrLast = addrLast;
-					segSrc->lines = (SourceDebugLine*)calloc(addrLast + 1 - addrFirst, sizeof(SourceDebugLine));
-					segSrc->blockNames = (strref*)calloc(seg->blocks.size(), sizeof(strref));
-					segSrc->name = seg->name;
-					for (size_t b = 0; b < seg->blocks.size(); ++b) {
-						ParseDebugBlock* blk = seg->blocks[b];
-						// copy block name
-						segSrc->blockNames[b] = blk->name;
-						// fill in addresses with line info
-						for (size_t l = 0; l < blk->lines.size(); ++l) {
-							ParseDebugLine* lin = &blk->lines[l];
-							uint16_t ft = lin->first, lt = lin->last;
-							if (ft < lt) {
-								for (uint16_t a = ft; a <= lt; ++a) {
-									SourceDebugLine* ln = segSrc->lines + (a-addrFirst);
-									ln->block = (uint8_t)b;
-									strref lineStr = lin->line;
-									uint8_t spaces = 0;
-									while (lineStr.get_first() <= 0x20 && spaces < 255) {
-										if (lineStr.get_first() == '\t') { spaces += 4; } else { ++spaces; }
-										++lineStr;
-									}
-									ln->spaces = spaces;
-									ln->line = lineStr.get();
-									ln->len = lineStr.get_len() < 256 ? lineStr.get_len() : 255;
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-		// clear up ParseDebugText
-		while (parse.files.size()) {
-			delete parse.files[parse.files.size() - 1];
-			parse.files.pop_back();
-		}
-		while (parse.segments.size()) {
-			ParseDebugSegment* segment = parse.segments[parse.segments.size() - 1];
-			while (segment->blocks.size()) {
-				delete segment->blocks[segment->blocks.size() - 1];
-				segment->blocks.pop_back();
-			}
-			parse.segments.pop_back();
+		} else {
+			FreeSourceDebug(dbg);
 		}
+		CloseTextFile(text);
 	}
 }
-
@@ -1,7 +1,11 @@
 #pragma once
 
 void ReadC64DbgSrc(const char* filename);
+// the returned text is only valid until the next call
 strref GetSourceAt(uint16_t addr, int &spaces);
 void ShutdownSourceDebug();
-
-
+bool GetSourceLocation(uint16_t addr, strref &file, uint32_t &line, strref &block);
+bool GetSourceLineAddress(strref file, uint32_t line, uint16_t &first, uint16_t &last);
+// source text is mapped on demand, files beyond the budget are unmapped least recently used first
+void SetSourceMemoryBudget(size_t bytes);
+size_t GetSourceMemoryBudget(size_t *mapped = nullptr);
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include <string.h>
+#include "TextFile.h"
+
+enum {
+	TEXT_CHUNK_MIN_SIZE = 256 * 1024,	// smaller files are not worth a thread
+	TEXT_CHUNK_MAX = 64
+};
+
+struct TextChunkJob {
+	TextChunkFunc func;
+	void* user;
+	strref* chunks;
+};
+
+static strref SkipBOM(strref text)
+{
+	if (text.get_len() >= 3 && (uint8_t)text[0] == 0xef && (uint8_t)text[1] == 0xbb && (uint8_t)text[2] == 0xbf) { text += 3; }
+	return text;
+}
+
+bool OpenTextFile(TextFile& file, const char* filename)
+{
+	file.text.clear();
+	if (!IBMapFile(&file.map, filename)) { return false; }
+	file.text = SkipBOM(strref((const char*)file.map.data, (strl_t)file.map.size));
+	return true;
+}
+
+void CloseTextFile(TextFile& file)
+{
+	IBUnmapFile(&file.map);
+	file.text.clear();
+}
+
+void* LoadTextFile(const char* filename, size_t* size)
+{
+	IBMappedFile map;
+	if (!IBMapFile(&map, filename)) { return nullptr; }
+	void* copy = malloc(map.size);
+	if (copy) {
+		memcpy(copy, map.data, map.size);
+		*size = map.size;
+	}
+	IBUnmapFile(&map);
+	return copy;
+}
+
+int TextChunkCount(strref text)
+{
+	int chunks = (int)(text.get_len() / TEXT_CHUNK_MIN_SIZE);
+	int cores = IBNumCores();
+	if (chunks > cores) { chunks = cores; }
+	if (chunks > TEXT_CHUNK_MAX) { chunks = TEXT_CHUNK_MAX; }
+	return chunks < 1 ? 1 : chunks;
+}
+
+static void ParseTextChunk(void* user, int index)
+{
+	TextChunkJob* job = (TextChunkJob*)user;
+	job->func(job->user, index, job->chunks[index]);
+}
+
+void ParseTextChunks(strref text, int numChunks, TextChunkFunc func, void* user)
+{
+	if (numChunks < 1) { return; }
+	if (numChunks > TEXT_CHUNK_MAX) { numChunks = TEXT_CHUNK_MAX; }
+
+	// split evenly, then move each split forward past the next line break
+	strref chunks[TEXT_CHUNK_MAX];
+	const char* start = text.get();
+	const char* end = text.get() + text.get_len();
+	for (int c = 0; c < numChunks; ++c) {
+		const char* split = c == (numChunks - 1) ? end : text.get() + (text.get_len() / numChunks) * (c + 1);
+		if (split < start) { split = start; }
+		while (split > text.get() && split < end && split[-1] != '\n') { ++split; }
+		chunks[c] = strref(start, strl_t(split - start));
+		start = split;
+	}
+
+	TextChunkJob job = { func, user, chunks };
+	IBParallelFor(numChunks, ParseTextChunk, &job);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "platform.h"
+#include "struse/struse.h"
+
+// Text files (symbols, listings, debug info) are memory mapped and split at
+// line boundaries so each chunk can be parsed on its own thread. Results are
+// collected per chunk and merged in file order by the caller.
+
+struct TextFile {
+	IBMappedFile map;
+	strref text;	// file contents after any utf-8 bom
+};
+
+typedef void (*TextChunkFunc)(void* user, int chunk, strref text);
+
+// read only map, the file stays locked on Windows until closed
+bool OpenTextFile(TextFile& file, const char* filename);
+void CloseTextFile(TextFile& file);
+
+// owned copy of a file for text that outlives the load, free() when done
+void* LoadTextFile(const char* filename, size_t* size);
+
+// number of chunks worth splitting this text into
+int TextChunkCount(strref text);
+void ParseTextChunks(strref text, int numChunks, TextChunkFunc func, void* user);
@@ -0,0 +1,455 @@
+// Execution trace recording to a memory mapped file and reading it back
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struse/struse.h"
+#include "machine.h"
+#include "Trace.h"
+
+#define TRACE_VERSION 2
+#define TRACE_GROW_SIZE (16*1024*1024)	// trace files grow in steps of this size
+#define TRACE_P_MASK 0xcf				// the B and unused flags are not compared
+#define TRACE_ALIGN_SEARCH 0x100000		// records to search for the first pc of the other trace
+
+static const char sTraceID[8] = "IBTRACE";
+
+static TraceWriter sRecorder;
+
+static size_t TraceBlockOffset(uint64_t block)
+{
+	return sizeof(TraceHeader) + (size_t)block * TRACE_BLOCK_SIZE;
+}
+
+static inline uint64_t TraceRegsKey(const TraceRecord &r)
+{
+	return r.pc | (uint64_t(r.op) << 16) | (uint64_t(r.a) << 24) | (uint64_t(r.x) << 32) |
+		(uint64_t(r.y) << 40) | (uint64_t(r.s) << 48) | (uint64_t(r.p & TRACE_P_MASK) << 56);
+}
+
+static inline uint64_t TraceHashStep(uint64_t hash, uint64_t value)
+{
+	hash = (hash ^ value) * 1099511628211ULL;
+	return hash ^ (hash >> 29);
+}
+
+static void TraceBlockHash(const TraceRecord *rec, uint64_t num, uint64_t &regs, uint64_t &mem)
+{
+	regs = mem = 14695981039346656037ULL;
+	for (uint64_t i = 0; i < num; ++i, ++rec) {
+		regs = TraceHashStep(regs, TraceRegsKey(*rec));
+		if (rec->flags & TRF_Write) { mem = TraceHashStep(mem, rec->addr | (uint64_t(rec->value) << 16) | (i << 24)); }
+	}
+}
+
+//
+// TraceWriter
+//
+
+bool TraceWriter::Open(const char *filename, uint32_t flags)
+{
+	Close();
+
+	strovl fileName(name, sizeof(name));
+	fileName.copy(filename);
+	fileName.c_str();
+	if (!IBMapFile(&file, name, TRACE_GROW_SIZE)) { return false; }
+
+	TraceHeader *header = (TraceHeader*)file.data;
+	memset(header, 0, sizeof(TraceHeader));
+	memcpy(header->id, sTraceID, sizeof(header->id));
+	header->version = TRACE_VERSION;
+	header->recordSize = sizeof(TraceRecord);
+	header->flags = flags;
+
+	blockUsed = 0;
+	lastCycle = 0;
+	records = 0;
+	cycle = 0;
+	index.clear();
+	return true;
+}
+
+// grows the file so that end bytes fit, the writer is closed if that fails
+static bool TraceFileFit(TraceWriter &writer, size_t end)
+{
+	if (end > writer.file.size) {
+		size_t size = writer.file.size;
+		while (size < end) { size += TRACE_GROW_SIZE; }
+		IBUnmapFile(&writer.file);
+		if (!IBMapFile(&writer.file, writer.name, size)) { return false; }
+	}
+	return true;
+}
+
+void TraceWriter::Flush()
+{
+	if (!blockUsed || !IsOpen()) { return; }
+	uint64_t blockIndex = (records - 1) / TRACE_BLOCK_RECORDS;
+	size_t offs = TraceBlockOffset(blockIndex);
+	size_t bytes = blockUsed * sizeof(TraceRecord);
+	if (!TraceFileFit(*this, offs + bytes)) { return; }
+	memcpy((uint8_t*)file.data + offs, block, bytes);
+	TraceBlockHash(block, blockUsed, index.back().regsHash, index.back().memHash);
+	((TraceHeader*)file.data)->records = records;
+	if (blockUsed == TRACE_BLOCK_RECORDS) { blockUsed = 0; }
+}
+
+TraceRecord* TraceWriter::Add(uint32_t recCycle)
+{
+	if (blockUsed == TRACE_BLOCK_RECORDS) { Flush(); }
+	if (!IsOpen()) { return nullptr; }
+
+	cycle = records ? (cycle + (uint32_t)(recCycle - lastCycle)) : recCycle;
+	lastCycle = recCycle;
+	if (!blockUsed) {
+		TraceBlockIndex blockIndex = { cycle, 0, 0 };
+		index.push_back(blockIndex);
+	}
+	TraceRecord *rec = block + blockUsed++;
+	rec->cycle = recCycle;
+	++records;
+	return rec;
+}
+
+void TraceWriter::Close()
+{
+	if (!IsOpen()) { return; }
+	Flush();
+
+	// append the sparse index so readers don't need to scan the blocks
+	size_t end = 0;
+	if (IsOpen()) {
+		size_t indexOffset = TraceBlockOffset(0) + (size_t)records * sizeof(TraceRecord);
+		size_t indexSize = index.size() * sizeof(TraceBlockIndex);
+		if (TraceFileFit(*this, indexOffset + indexSize)) {
+			if (indexSize) { memcpy((uint8_t*)file.data + indexOffset, &index[0], indexSize); }
+			TraceHeader *header = (TraceHeader*)file.data;
+			header->records = records;
+			header->indexOffset = indexOffset;
+			header->blocks = (uint32_t)index.size();
+			end = indexOffset + indexSize;
+		}
+	}
+	IBUnmapFile(&file, end);
+	index.clear();
+	blockUsed = 0;
+}
+
+//
+// Recording from the emulator
+//
+
+bool StartTrace(const char *filename)
+{
+	return sRecorder.Open(filename);
+}
+
+void StopTrace()
+{
+	sRecorder.Close();
+}
+
+bool IsTraceRecording()
+{
+	return sRecorder.IsOpen();
+}
+
+uint64_t GetTraceRecordCount()
+{
+	return sRecorder.records;
+}
+
+void TraceInstruction(const Regs &before, uint8_t op, uint32_t cycle, uint16_t addr, uint8_t value, uint8_t flags)
+{
+	if (TraceRecord *rec = sRecorder.Add(cycle)) {
+		rec->pc = before.PC;
+		rec->addr = addr;
+		rec->op = op;
+		rec->a = before.A;
+		rec->x = before.X;
+		rec->y = before.Y;
+		rec->s = before.S;
+		rec->p = before.P;
+		rec->value = value;
+		rec->flags = flags;
+	}
+}
+
+//
+// TraceReader
+//
+
+bool TraceReader::Open(const char *filename)
+{
+	Close();
+	if (!IBMapFile(&file, filename)) { return false; }
+
+	header = (const TraceHeader*)file.data;
+	if (file.size < sizeof(TraceHeader) || memcmp(header->id, sTraceID, sizeof(sTraceID)) ||
+		header->recordSize != sizeof(TraceRecord)) {
+		Close();
+		return false;
+	}
+	records = (const TraceRecord*)((const uint8_t*)file.data + sizeof(TraceHeader));
+
+	// a trace that was not closed cleanly may claim more records than were written
+	count = header->records;
+	uint64_t fit = (file.size - sizeof(TraceHeader)) / sizeof(TraceRecord);
+	if (count > fit) { count = fit; }
+
+	uint64_t blocks = (count + TRACE_BLOCK_RECORDS - 1) / TRACE_BLOCK_RECORDS;
+	if (header->version == TRACE_VERSION && header->indexOffset && header->blocks == blocks &&
+		(header->indexOffset + blocks * sizeof(TraceBlockIndex)) <= file.size) {
+		const TraceBlockIndex *stored = (const TraceBlockIndex*)((const uint8_t*)file.data + header->indexOffset);
+		index.assign(stored, stored + blocks);
+	} else {
+		// rebuild from the records, a block spans far less than 2^32 cycles
+		index.resize((size_t)blocks);
+		uint64_t cycle = 0;
+		for (uint64_t b = 0; b < blocks; ++b) {
+			const TraceRecord *first = records + b * TRACE_BLOCK_RECORDS;
+			cycle = b ? (cycle + (uint32_t)(first->cycle - first[-(int)TRACE_BLOCK_RECORDS].cycle)) : first->cycle;
+			uint64_t num = (count - b * TRACE_BLOCK_RECORDS) < TRACE_BLOCK_RECORDS ? (count - b * TRACE_BLOCK_RECORDS) : TRACE_BLOCK_RECORDS;
+			TraceBlockIndex &entry = index[(size_t)b];
+			entry.cycle = cycle;
+			TraceBlockHash(first, num, entry.regsHash, entry.memHash);
+		}
+	}
+	return true;
+}
+
+void TraceReader::Close()
+{
+	IBUnmapFile(&file);
+	header = nullptr;
+	records = nullptr;
+	count = 0;
+	index.clear();
+}
+
+uint64_t TraceReader::Cycle(uint64_t i) const
+{
+	if (i >= count) { return 0; }
+	uint64_t block = i / TRACE_BLOCK_RECORDS;
+	return index[(size_t)block].cycle + (uint32_t)(records[i].cycle - records[block * TRACE_BLOCK_RECORDS].cycle);
+}
+
+uint64_t TraceReader::FindCycle(uint64_t cycle) const
+{
+	if (!count) { return 0; }
+
+	// last block starting at or before cycle
+	size_t lo = 0, hi = index.size();
+	while ((hi - lo) > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (index[mid].cycle <= cycle) { lo = mid; }
+		else { hi = mid; }
+	}
+
+	// first record in the block at or after cycle
+	uint64_t first = lo * TRACE_BLOCK_RECORDS;
+	uint64_t last = first + TRACE_BLOCK_RECORDS;
+	if (last > count) { last = count; }
+	while (first < last) {
+		uint64_t mid = (first + last) / 2;
+		if (Cycle(mid) < cycle) { first = mid + 1; }
+		else { last = mid; }
+	}
+	return first;
+}
+
+//
+// VICE trace import
+//
+
+static bool ParseViceReg(strref line, const char *name, uint8_t &value)
+{
+	int pos = line.find_case(name);
+	if (pos < 0) { return false; }
+	line += pos + (int)strlen(name);
+	value = (uint8_t)line.get_substr(0, 2).ahextoui();
+	return true;
+}
+
+// .C:080d  8D 20 D0    STA $D020      - A:00 X:00 Y:0A SP:f3 ..-..I.C   12345678
+static bool ParseViceTraceLine(strref line, TraceRecord &rec, bool &hasCycle)
+{
+	line.skip_whitespace();
+	if (line.get_first() == '.') { ++line; }
+	if (line.get_len() < 10 || line[1] != ':' || !strref::is_hex(line[2])) { return false; }
+	line += 2;
+	rec.pc = (uint16_t)line.get_substr(0, 4).ahextoui();
+	line += 4;
+	line.skip_whitespace();
+	rec.op = (uint8_t)line.get_substr(0, 2).ahextoui();
+
+	int regs = line.find_case(" A:");
+	if (regs < 0) { return false; }
+	line += regs;
+	if (!ParseViceReg(line, " A:", rec.a) || !ParseViceReg(line, " X:", rec.x) ||
+		!ParseViceReg(line, " Y:", rec.y) || !ParseViceReg(line, "SP:", rec.s)) {
+		return false;
+	}
+
+	// flags are shown as NV-BDIZC with '.' for a clear flag
+	line += line.find_case("SP:") + 5;
+	line.skip_whitespace();
+	rec.p = 0;
+	for (int b = 0; b < 8; ++b) {
+		if (line[b] != '.') { rec.p |= 0x80 >> b; }
+	}
+	line += 8;
+	line.skip_whitespace();
+	hasCycle = line && strref::is_number(line.get_first());
+	rec.cycle = hasCycle ? (uint32_t)line.atoui() : 0;
+	return true;
+}
+
+bool ImportViceTrace(const char *textFile, const char *traceFile)
+{
+	IBMappedFile text;
+	if (!IBMapFile(&text, textFile)) { return false; }
+
+	TraceWriter *writer = new TraceWriter;
+	bool ok = writer->Open(traceFile, TRH_NoMemory);
+	if (ok) {
+		strref parse((const char*)text.data, (strl_t)text.size);
+		bool anyCycle = false;
+		while (parse) {
+			TraceRecord rec;
+			bool hasCycle = false;
+			if (ParseViceTraceLine(parse.next_line(), rec, hasCycle)) {
+				anyCycle = anyCycle || hasCycle;
+				if (TraceRecord *add = writer->Add(rec.cycle)) {
+					rec.addr = 0;
+					rec.value = 0;
+					rec.flags = 0;
+					*add = rec;
+				}
+			}
+		}
+		if (!anyCycle && writer->IsOpen()) { ((TraceHeader*)writer->file.data)->flags |= TRH_NoCycles; }
+		ok = writer->IsOpen() && writer->records;
+		writer->Close();
+	}
+	delete writer;
+	IBUnmapFile(&text);
+	return ok;
+}
+
+bool OpenTrace(TraceReader &reader, const char *filename)
+{
+	if (reader.Open(filename)) { return true; }
+
+	// not a trace file, try importing it as a VICE text trace next to the original
+	strown<MAX_PATH> imported(filename);
+	imported.append(".ibtrace");
+	return ImportViceTrace(filename, imported.c_str()) && reader.Open(imported.c_str());
+}
+
+//
+// Trace diff
+//
+
+static void TraceDiffLine(const TraceReader &trace, uint64_t i, const char *prefix, TraceDiffPrint print, void *user)
+{
+	const TraceRecord *rec = trace.Record(i);
+	if (!rec) { return; }
+	strown<160> line(prefix);
+	line.append_num((uint32_t)i, 10, 10);
+	if (!(trace.Flags() & TRH_NoCycles)) { line.append(" @").append_num((uint32_t)trace.Cycle(i), 10, 10); }
+	line.append(" $").append_num(rec->pc, 4, 16).append(' ').append_num(rec->op, 2, 16);
+	line.append(" A:").append_num(rec->a, 2, 16).append(" X:").append_num(rec->x, 2, 16);
+	line.append(" Y:").append_num(rec->y, 2, 16).append(" S:").append_num(rec->s, 2, 16);
+	line.append(" P:").append_num(rec->p, 2, 16);
+	if (rec->flags & TRF_Write) { line.append(" $").append_num(rec->addr, 4, 16).append('<').append_num(rec->value, 2, 16); }
+	print(line.c_str(), user);
+}
+
+static bool TraceRecordsMatch(const TraceRecord &a, const TraceRecord &b, bool memory)
+{
+	if (TraceRegsKey(a) != TraceRegsKey(b)) { return false; }
+	if (memory && ((a.flags ^ b.flags) & TRF_Write)) { return false; }
+	return !memory || !(a.flags & TRF_Write) || (a.addr == b.addr && a.value == b.value);
+}
+
+int TraceDiff(const char *traceA, const char *traceB, int context, TraceDiffPrint print, void *user)
+{
+	TraceReader a, b;
+	if (!OpenTrace(a, traceA)) { print("Could not read first trace", user); return -1; }
+	if (!OpenTrace(b, traceB)) { print("Could not read second trace", user); return -1; }
+
+	bool memory = !((a.Flags() | b.Flags()) & TRH_NoMemory);
+	uint64_t numA = a.NumRecords(), numB = b.NumRecords();
+	strown<160> msg;
+
+	// traces captured from different start points are aligned on the first pc of the first trace
+	uint64_t offs = 0;
+	if (numA && numB && a.Record(0)->pc != b.Record(0)->pc) {
+		while (offs < numB && offs < TRACE_ALIGN_SEARCH && b.Record(offs)->pc != a.Record(0)->pc) { ++offs; }
+		if (offs == numB || offs == TRACE_ALIGN_SEARCH) { offs = 0; }
+		else {
+			msg.copy("Second trace aligned by skipping ");
+			msg.append_num((uint32_t)offs, 0, 10).append(" instructions");
+			print(msg.c_str(), user);
+		}
+	}
+	uint64_t num = numA < (numB - offs) ? numA : (numB - offs);
+
+	// skip blocks with matching hashes, stored hashes can only be used when the blocks line up
+	uint64_t i = 0;
+	while (i < num) {
+		uint64_t block = i / TRACE_BLOCK_RECORDS;
+		uint64_t left = num - i < TRACE_BLOCK_RECORDS ? num - i : TRACE_BLOCK_RECORDS;
+		uint64_t regsA, memA, regsB, memB;
+		if (!offs && left == TRACE_BLOCK_RECORDS) {
+			regsA = a.index[(size_t)block].regsHash; memA = a.index[(size_t)block].memHash;
+			regsB = b.index[(size_t)block].regsHash; memB = b.index[(size_t)block].memHash;
+		} else {
+			TraceBlockHash(a.Record(i), left, regsA, memA);
+			TraceBlockHash(b.Record(i + offs), left, regsB, memB);
+		}
+		if (regsA != regsB || (memory && memA != memB)) { break; }
+		i += left;
+	}
+
+	// find the first record that differs in the block
+	while (i < num && TraceRecordsMatch(*a.Record(i), *b.Record(i + offs), memory)) { ++i; }
+
+	if (i == num) {
+		if (numA == (numB - offs)) {
+			msg.copy("Traces match for ");
+			msg.append_num((uint32_t)num, 0, 10).append(" instructions");
+			print(msg.c_str(), user);
+			return 0;
+		}
+		msg.copy("Traces match until the ");
+		msg.append(numA < (numB - offs) ? "first" : "second");
+		msg.append(" trace ends after ").append_num((uint32_t)num, 0, 10).append(" instructions");
+		print(msg.c_str(), user);
+		return 1;
+	}
+
+	const TraceRecord *ra = a.Record(i), *rb = b.Record(i + offs);
+	msg.copy("First divergence at instruction ");
+	msg.append_num((uint32_t)i, 0, 10).append(':');
+	if (ra->pc != rb->pc) { msg.append(" PC"); }
+	if (ra->op != rb->op) { msg.append(" opcode"); }
+	if (ra->a != rb->a) { msg.append(" A"); }
+	if (ra->x != rb->x) { msg.append(" X"); }
+	if (ra->y != rb->y) { msg.append(" Y"); }
+	if (ra->s != rb->s) { msg.append(" S"); }
+	if ((ra->p ^ rb->p) & TRACE_P_MASK) { msg.append(" P"); }
+	if (memory && !TraceRecordsMatch(*ra, *rb, memory) && TraceRegsKey(*ra) == TraceRegsKey(*rb)) { msg.append(" memory write"); }
+	print(msg.c_str(), user);
+
+	uint64_t first = i > (uint64_t)context ? i - context : 0;
+	for (uint64_t c = first; c <= i + context && c < numA; ++c) {
+		TraceDiffLine(a, c, c == i ? "A>" : "A ", print, user);
+		TraceDiffLine(b, c + offs, c == i ? "B>" : "B ", print, user);
+	}
+	return 1;
+}
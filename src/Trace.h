@@ -0,0 +1,109 @@
+#pragma once
+// Execution trace recording to a memory mapped file and reading it back
+#include <stdint.h>
+#include <vector>
+#include "platform.h"
+
+struct Regs;
+
+// fixed width record per executed instruction, registers are before execution
+struct TraceRecord {
+	uint32_t cycle;		// low 32 bits of the cycle count, see TraceReader::Cycle
+	uint16_t pc;
+	uint16_t addr;		// effective address if TRF_Addr is set
+	uint8_t op;
+	uint8_t a, x, y, s, p;
+	uint8_t value;		// value read or written at the effective address
+	uint8_t flags;
+};
+
+enum TraceRecordFlags {
+	TRF_Addr = 1,		// addr and value are valid
+	TRF_Write = 2,		// instruction wrote value to addr
+};
+
+enum TraceHeaderFlags {
+	TRH_NoMemory = 1,	// records have no effective address (imported)
+	TRH_NoCycles = 2,	// records have no cycle counts (imported)
+};
+
+#define TRACE_BLOCK_SIZE 0x10000
+#define TRACE_BLOCK_RECORDS (TRACE_BLOCK_SIZE / sizeof(TraceRecord))
+
+struct TraceHeader {
+	char id[8];				// "IBTRACE", zero terminated
+	uint32_t version;
+	uint32_t recordSize;
+	uint64_t records;
+	uint64_t indexOffset;	// sparse block index written when the trace is closed, 0 if missing
+	uint32_t blocks;
+	uint32_t flags;			// TraceHeaderFlags
+	uint8_t pad[24];
+};
+
+// one entry per block of TRACE_BLOCK_RECORDS records
+struct TraceBlockIndex {
+	uint64_t cycle;			// full cycle count of the first record in the block
+	uint64_t regsHash;		// pc, opcode and registers of all records in the block
+	uint64_t memHash;		// memory writes of all records in the block
+};
+
+// writes blocks of records to a growing memory mapped file
+struct TraceWriter {
+	IBMappedFile file;
+	char name[MAX_PATH];
+	TraceRecord block[TRACE_BLOCK_RECORDS];
+	uint32_t blockUsed;
+	uint32_t lastCycle;
+	uint64_t records;
+	uint64_t cycle;			// full cycle count of the most recent record
+	std::vector<TraceBlockIndex> index;
+
+	TraceWriter() : blockUsed(0), lastCycle(0), records(0), cycle(0) { file.data = nullptr; file.size = 0; }
+	~TraceWriter() { Close(); }
+
+	bool Open(const char *filename, uint32_t flags = 0);
+	void Close();
+	bool IsOpen() const { return file.data != nullptr; }
+	TraceRecord* Add(uint32_t cycle);	// returns the record to fill in, nullptr if the file failed
+	void Flush();						// writes out the current block and its hashes
+};
+
+// recording from the emulator
+bool StartTrace(const char *filename);
+void StopTrace();
+bool IsTraceRecording();
+uint64_t GetTraceRecordCount();
+void TraceInstruction(const Regs &before, uint8_t op, uint32_t cycle, uint16_t addr, uint8_t value, uint8_t flags);
+
+// reading, maps the file and seeks using the sparse index
+struct TraceReader {
+	IBMappedFile file;
+	const TraceHeader *header;
+	const TraceRecord *records;
+	uint64_t count;
+	std::vector<TraceBlockIndex> index;
+
+	TraceReader() : header(nullptr), records(nullptr), count(0) { file.data = nullptr; file.size = 0; }
+	~TraceReader() { Close(); }
+
+	bool Open(const char *filename);
+	void Close();
+
+	uint32_t Flags() const { return header ? header->flags : 0; }
+	uint64_t NumRecords() const { return count; }
+	const TraceRecord* Record(uint64_t index) const { return index < count ? records + index : nullptr; }
+	uint64_t Cycle(uint64_t index) const;		// 64 bit cycle count of a record
+	uint64_t FindCycle(uint64_t cycle) const;	// first record at or after cycle, NumRecords() if none
+};
+
+// converts a VICE cpu history / trace log (".C:0810  A9 00  LDA #$00  A:00 X:00 Y:0A SP:f3 ..-..I.C") to a trace file
+bool ImportViceTrace(const char *textFile, const char *traceFile);
+
+// opens a trace file, importing it first if it is a VICE text trace
+bool OpenTrace(TraceReader &reader, const char *filename);
+
+// reports the first record where pc, registers or memory writes diverge,
+// returns 0 if the traces match, 1 on divergence and -1 if a trace could not be read
+typedef void(*TraceDiffPrint)(const char *line, void *user);
+int TraceDiff(const char *traceA, const char *traceB, int context, TraceDiffPrint print, void *user);
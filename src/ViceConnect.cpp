@@ -363,6 +363,7 @@ void ViceConnect::connectionThread()
 	char line[512];
 	int offs = 0;
 	bool next_line_is_trace_address = false;
+	bool sortSymbols = false;	// labels arrive over several receives, sorted between them
 
 	sViceExit[0] = 0;
 
@@ -424,6 +425,11 @@ void ViceConnect::connectionThread()
 			free(sendCmd);
 		}
 
+		if (sortSymbols) {
+			SortSymbols();
+			sortSymbols = false;
+		}
+
 		int bytesReceived = recv(s, recvBuf, RECEIVE_SIZE, 0);
 		if (bytesReceived==SOCKET_ERROR) {
 			if (WSAGetLastError()==WSAETIMEDOUT) {
@@ -557,13 +563,14 @@ void ViceConnect::connectionThread()
 						case '$':
 							if (lineParse.get_len()>6&&lineParse[5]==' ' && lineParse[6]=='.' && viceUpdatesSymbols) {
 								if (viceReloadSymbols) {
-									ShutdownSymbols();
+									ResetSymbols();
 									viceReloadSymbols = false;
 								}
 								uint16_t addr = uint16_t(lineParse.get_substr(1, 4).ahextou64());
 								strref name = lineParse+6;
 								name.trim_whitespace();
 								AddSymbol(addr, name.get(), name.get_len());
+								sortSymbols = true;
 							}
 							break;
 						case 'B':
@@ -5,6 +5,14 @@
 #include "ViceConnect.h"
 #include "Expressions.h"
 #include "machine.h"
+#include "CallGraph.h"
+#include "Trace.h"
+#include "sym.h"
+#include "ImGui_Helper.h"
+#include "Breakpoints.h"
+#include "SourceDebug.h"
+#include "Listing.h"
+#include "FileDialog.h"
 #include "platform.h"
 
 static const strref command_separator(" $");
@@ -293,6 +301,28 @@ void ViceConsole::FlushLogSafe()
 	}
 	safeItems.clear();
 	IBMutexRelease(&logSafe_mutex);
+
+	// tracepoint hits are formatted here rather than in the cpu thread
+	TraceLogRecord record;
+	while (PopTraceLog(record)) {
+		const Tracepoint *tp = GetTracepoints();
+		strref names;
+		for (int t = 0, n = GetNumTracepoints(); t < n; ++t) {
+			if (tp[t].id == record.id) { names = strref(tp[t].text); break; }
+		}
+		strown<256> line;
+		line.sprintf("TP %d $%04x @%u:", record.id, record.pc, record.cycle);
+		for (uint8_t v = 0; v < record.numValues; ++v) {
+			strref name = names.split_token_trim(',');
+			int value = record.values[v];
+			if (v) { line.append(','); }
+			line.append(' ').append(name);
+			line.sprintf_append("%s%s$%x", name ? "=" : "", value < 0 ? "-" : "", value < 0 ? -value : value);
+		}
+		Items.push_back(Strdup(line.c_str()));
+		ScrollToBottom = true;
+	}
+	if (uint32_t dropped = GetTraceLogDropped()) { AddLog("%u tracepoint records dropped", dropped); }
 }
 
 void ViceConsole::Draw()
@@ -417,6 +447,19 @@ void ViceConsole::ExecCommand(const char* command_line)
 			// forward command to vice
 			if (ViceConnected()) {
 				ViceSend(line.get(), line.get_len());
+			} else if (c == VICE_IGNORE) {
+				// without VICE ignore counts and temporary breakpoints apply to the local breakpoints
+				param.trim_whitespace();
+				uint32_t id = (uint32_t)param.split_token_trim(' ').atoi();
+				uint32_t count = param ? (uint32_t)param.atoi() : 1;
+				if (SetBPIgnore(id, count)) { AddLog("Ignoring the next %u hits of breakpoint %u", count, id); }
+				else { AddLog("No breakpoint %u", id); }
+			} else if (c == VICE_UNTIL || c == VICE_UN) {
+				param.trim_whitespace();
+				strown<64> addr(param);
+				if (!addr) { CPUGo(); }
+				else if (SetTempPCBreakpoint((uint16_t)ValueFromExpression(addr.c_str())) != ~0U) { CPUGo(); }
+				else { AddLog("Too many breakpoints"); }
 			} else {
 				AddLog("Vice is not connected\n");
 			}
@@ -461,6 +504,264 @@ void ViceConsole::ExecCommand(const char* command_line)
 		} else {
 			AddLog("= $%x", value);
 		}
+	} else if (cmd.same_str("heat")) {
+		if (param.same_str("on")) { EnableHeatmap(true); }
+		else if (param.same_str("off")) { EnableHeatmap(false); }
+		else if (param.same_str("clear")) { ClearHeatmap(); }
+		AddLog("Heatmap collection is %s", IsHeatmapEnabled() ? "on" : "off");
+	} else if (cmd.same_str("callgraph") || cmd.same_str("cg")) {
+		strref arg = param.split_token_trim(' ');
+		if (arg.same_str("on")) { EnableCallGraph(true); }
+		else if (arg.same_str("off")) { EnableCallGraph(false); }
+		else if (IsCPURunning()) { AddLog("Stop the CPU to clear or read the call graph"); return; }
+		else if (arg.same_str("clear")) { ResetCallGraph(); }
+		else if (arg.same_str("save")) {
+			strown<MAX_PATH> file(param);
+			if (!file) { file.copy("callgraph.txt"); }
+			if (SaveCallGraph(file.c_str())) { AddLog("Saved collapsed call stacks to %s", file.c_str()); }
+			else { AddLog("Could not save call graph to %s", file.c_str()); }
+			return;
+		} else if (arg.same_str("top")) {
+			int num = param ? (int)param.atoi() : 10;
+			if (!ReportCallGraph(num, [](const char *path, uint32_t calls, uint64_t total, uint32_t longest, void *user) {
+				((ViceConsole*)user)->AddLog("%6u max %10llu total %8u calls: %s", longest, (unsigned long long)total, calls, path);
+			}, this)) { AddLog("No calls recorded"); }
+			return;
+		}
+		AddLog("Call graph recording is %s", IsCallGraphEnabled() ? "on" : "off");
+	} else if (cmd.same_str("tracerec")) {
+		if (IsCPURunning()) { AddLog("Stop the CPU to start or stop trace recording"); return; }
+		if (param.same_str("off")) {
+			uint64_t records = GetTraceRecordCount();
+			StopTrace();
+			AddLog("Trace recording stopped after %llu instructions", (unsigned long long)records);
+		} else if (param) {
+			strown<MAX_PATH> file(param);
+			if (StartTrace(file.c_str())) { AddLog("Recording execution trace to %s", file.c_str()); }
+			else { AddLog("Could not create trace file %s", file.c_str()); }
+		} else {
+			AddLog("Trace recording is %s", IsTraceRecording() ? "on" : "off");
+		}
+	} else if (cmd.same_str("traceshow")) {
+		// traceshow <file> [#index | @cycle] [count]
+		strown<MAX_PATH> file(param.split_token_trim(' '));
+		TraceReader trace;
+		if (!OpenTrace(trace, file.c_str())) { AddLog("Could not open trace file %s", file.c_str()); return; }
+		uint64_t first = 0;
+		if (param.get_first() == '#') { ++param; first = param.split_token_trim(' ').atoui(); }
+		else if (param.get_first() == '@') { ++param; first = trace.FindCycle(param.split_token_trim(' ').atoui()); }
+		uint64_t num = param ? param.atoui() : 16;
+		AddLog("%llu instructions", (unsigned long long)trace.NumRecords());
+		for (uint64_t i = first; i < (first + num) && i < trace.NumRecords(); ++i) {
+			const TraceRecord *rec = trace.Record(i);
+			strown<128> line;
+			line.append_num((uint32_t)i, 8, 10).append(' ').append_num((uint32_t)trace.Cycle(i), 10, 10);
+			line.append(" $").append_num(rec->pc, 4, 16).append(' ').append_num(rec->op, 2, 16);
+			line.append(" A:").append_num(rec->a, 2, 16).append(" X:").append_num(rec->x, 2, 16);
+			line.append(" Y:").append_num(rec->y, 2, 16).append(" S:").append_num(rec->s, 2, 16);
+			line.append(" P:").append_num(rec->p, 2, 16);
+			if (rec->flags & TRF_Addr) {
+				line.append((rec->flags & TRF_Write) ? " $" : " ($").append_num(rec->addr, 4, 16);
+				line.append((rec->flags & TRF_Write) ? "<" : ")=").append_num(rec->value, 2, 16);
+			}
+			AddLog(line.c_str());
+		}
+	} else if (cmd.same_str("tracediff")) {
+		// tracediff <file a> <file b> [context]
+		strown<MAX_PATH> fileA(param.split_token_trim(' '));
+		strown<MAX_PATH> fileB(param.split_token_trim(' '));
+		int context = param ? (int)param.atoi() : 3;
+		TraceDiff(fileA.c_str(), fileB.c_str(), context, [](const char *line, void *user) {
+			((ViceConsole*)user)->AddLog("%s", line);
+		}, this);
+	} else if (cmd.same_str("bus")) {
+		if (param.same_str("on") || param.same_str("off")) {
+			SetBusCycleMode(param.same_str("on"));
+			AddLog("Bus cycle mode is %s", IsBusCycleMode() ? "on" : "off");
+			return;
+		}
+		static const char *accessNames[] = { "read", "write", "dummy read", "dummy write" };
+		const BusCycle *bus;
+		int num = GetLastBusCycles(&bus);
+		if (!IsBusCycleMode()) { AddLog("Bus cycle mode is off"); }
+		for (int i = 0; i < num; ++i) {
+			AddLog("%u: %s $%04x = $%02x", bus[i].cycle, accessNames[bus[i].access], bus[i].addr, bus[i].value);
+		}
+	} else if (cmd.same_str("fork")) {
+		// fork [list] | fork <n> go [count]/to <addr>/poke <addr> <value>/stop/regs/mem <addr>/discard
+		Machine &machine = GetMachine();
+		strref arg = param.split_token_trim(' ');
+		if (!arg) {
+			if (machine.Fork()) { AddLog("Fork %d of the current state", machine.GetNumForks() - 1); }
+			else { AddLog("Could not fork, stop the CPU first"); }
+			return;
+		} else if (arg.same_str("list")) {
+			for (int f = 0; f < machine.GetNumForks(); ++f) {
+				Machine *fork = machine.GetFork(f);
+				const Regs &r = fork->GetRegs();
+				AddLog("%d: PC=$%04x %u cycles, %d pages copied%s", f, r.PC, fork->GetCycles(), fork->GetPrivatePages(), fork->IsRunning() ? ", running" : "");
+			}
+			if (!machine.GetNumForks()) { AddLog("No forks"); }
+			return;
+		}
+		int index = (int)arg.atoi();
+		Machine *fork = machine.GetFork(index);
+		if (!fork) { AddLog("No fork %d", index); return; }
+		arg = param.split_token_trim(' ');
+		if (arg.same_str("stop")) { fork->Stop(); }
+		else if (arg.same_str("discard")) {
+			if (machine.DiscardFork(fork)) { AddLog("Discarded fork %d", index); }
+			else { AddLog("Can't discard fork %d while the CPU is running", index); }
+			return;
+		} else if (fork->IsRunning()) { AddLog("Fork %d is running", index); return; }
+		else if (arg.same_str("go")) { fork->Go(param ? (uint32_t)param.atoi() : 0); }
+		else if (arg.same_str("to")) {
+			strown<64> addr(param);
+			fork->RunTo((uint16_t)ValueFromExpression(addr.c_str()));
+		} else if (arg.same_str("poke")) {
+			strown<64> addr(param.split_token_trim(' '));
+			strown<64> value(param);
+			fork->SetByte((uint16_t)ValueFromExpression(addr.c_str()), (uint8_t)ValueFromExpression(value.c_str()));
+		} else if (arg.same_str("mem")) {
+			strown<64> addrExp(param);
+			uint16_t addr = (uint16_t)ValueFromExpression(addrExp.c_str());
+			strown<128> memStr;
+			memStr.append_num(addr, 4, 16).append(':');
+			for (int b = 0; b < 16; ++b) { memStr.append(' ').append_num(fork->GetByte(uint16_t(addr + b)), 2, 16); }
+			AddLog(memStr.c_str());
+			return;
+		}
+		const Regs &r = fork->GetRegs();
+		AddLog("Fork %d: PC=$%04x A=$%02x X=$%02x Y=$%02x S=$%02x P=$%02x %u cycles%s", index, r.PC, r.A, r.X, r.Y, r.S, r.P,
+			   fork->GetCycles(), fork->IsRunning() ? ", running" : "");
+	} else if (cmd.same_str("writes") || cmd.same_str("revwrite")) {
+		// writes <addr> [count] lists writes in the undo history, revwrite <addr> [end] steps back to the most recent
+		strown<64> addr(param.split_token_trim(' '));
+		if (!addr) { AddLog("Missing address"); return; }
+		uint16_t watch = (uint16_t)ValueFromExpression(addr.c_str());
+		if (IsCPURunning()) { AddLog("Stop the CPU first"); return; }
+		if (cmd.same_str("revwrite")) {
+			ReverseStop stop;
+			stop.start = stop.end = watch;
+			if (param) { stop.end = (uint16_t)ValueFromExpression(strown<64>(param.split_token_trim(' ')).c_str()); }
+			stop.writes = true;
+			stop.breakpoints = false;
+			stop.cond = nullptr;
+			if (!CPUReverseUntil(stop)) { AddLog("No write to $%04x-$%04x in the history", stop.start, stop.end); }
+			return;
+		}
+		UndoWrite writes[64];
+		int count = param ? (int)param.atoi() : 16;
+		if (count < 1 || count > 64) { count = 64; }
+		int found = FindHistoryWrites(watch, writes, count);
+		for (int w = 0; w < found; ++w) {
+			AddLog("%d steps back: $%04x $%02x -> $%02x", writes[w].stepsBack, writes[w].pc, writes[w].before, writes[w].after);
+		}
+		if (!found) { AddLog("No write to $%04x in the history", watch); }
+	} else if (cmd.same_str("revcond")) {
+		// step back to the most recent state where the expression is true, memory reads see the past values
+		uint8_t rpn[512];
+		if (!param) { AddLog("Missing condition"); return; }
+		if (IsCPURunning()) { AddLog("Stop the CPU first"); return; }
+		BuildExpression(param.get(), rpn, sizeof(rpn));
+		ReverseStop stop;
+		stop.start = stop.end = 0;
+		stop.writes = false;
+		stop.breakpoints = true;
+		stop.cond = rpn;
+		if (!CPUReverseUntil(stop)) { AddLog("Condition not met in the history"); }
+	} else if (cmd.same_str("tp")) {
+		// tp <addr> <exp>[, <exp>..] | tp [list] | tp del <id>/all
+		strref arg = param.split_token_trim(' ');
+		if (!arg || arg.same_str("list")) {
+			const Tracepoint *tp = GetTracepoints();
+			for (int t = 0, n = GetNumTracepoints(); t < n; ++t) {
+				AddLog("%d: $%04x %s", tp[t].id, tp[t].pc, tp[t].text);
+			}
+			if (!GetNumTracepoints()) { AddLog("No tracepoints"); }
+		} else if (arg.same_str("del")) {
+			RemoveTracepoint(param.same_str("all") ? ~0U : (uint32_t)param.atoi());
+		} else {
+			strown<64> addr(arg);
+			strown<TRACEPOINT_TEXT> exps(param);
+			uint32_t id = AddTracepoint((uint16_t)ValueFromExpression(addr.c_str()), exps.c_str());
+			if (id == ~0U) { AddLog("Too many tracepoints"); }
+			else { AddLog("Tracepoint %d added", id); }
+		}
+	} else if (cmd.same_str("bplist")) {
+		uint16_t *pBP;
+		uint32_t *pID;
+		uint16_t nDS;
+		uint16_t nBP = GetPCBreakpointsID(&pBP, &pID, nDS);
+		for (uint16_t b = 0; b < (nBP + nDS); ++b) {
+			BreakpointHits info;
+			if (!GetBPHits(pID[b], info)) { continue; }
+			strown<128> desc;
+			desc.sprintf("%u: $%04x hits %u", pID[b], pBP[b], info.hits);
+			if (info.ignore) { desc.sprintf_append(", ignore %u", info.ignore); }
+			if (info.every > 1) { desc.sprintf_append(", every %u", info.every); }
+			if (info.temporary) { desc.append(", temporary"); }
+			if (b >= nBP) { desc.append(", disabled"); }
+			AddLog(desc.c_str());
+		}
+		if (!(nBP + nDS)) { AddLog("No breakpoints"); }
+	} else if (cmd.same_str("bpevery")) {
+		uint32_t id = (uint32_t)param.split_token_trim(' ').atoi();
+		if (!SetBPEvery(id, (uint16_t)param.atoi())) { AddLog("No breakpoint %u", id); }
+	} else if (cmd.same_str("bpreset")) {
+		ResetBPHits(param ? (uint32_t)param.atoi() : ~0U);
+	} else if (cmd.same_str("tbreak")) {
+		strown<64> addr(param);
+		uint32_t id = SetTempPCBreakpoint((uint16_t)ValueFromExpression(addr.c_str()));
+		if (id == ~0U) { AddLog("Too many breakpoints"); }
+		else { AddLog("Temporary breakpoint %u", id); }
+	} else if (cmd.same_str("srcbp")) {
+		// file name may contain a drive colon so the line number is after the last one
+		strref file = param.before_last(':');
+		uint32_t lineNum = (uint32_t)param.after_last(':').atoi();
+		uint16_t first, last;
+		if (!file || !lineNum) { AddLog("Usage: srcbp <file>:<line>"); }
+		else if (!GetSourceLineAddress(file, lineNum, first, last)) { AddLog("No code for line %u of " STRREF_FMT, lineNum, STRREF_ARG(file)); }
+		else {
+			SetViceBP(first, first, -1, true, VBP_Break, false);
+			AddLog("Breakpoint at $%04x (line builds $%04x-$%04x)", first, first, last);
+		}
+	} else if (cmd.same_str("src")) {
+		strown<64> addrStr(param);
+		uint16_t addr = addrStr ? (uint16_t)ValueFromExpression(addrStr.c_str()) : GetRegs().PC;
+		strref file, block;
+		uint32_t lineNum;
+		int spaces;
+		if (GetSourceLocation(addr, file, lineNum, block)) {
+			strref text = GetSourceAt(addr, spaces);
+			AddLog("$%04x " STRREF_FMT ":%u%s" STRREF_FMT, addr, STRREF_ARG(file), lineNum, block ? " in " : "", STRREF_ARG(block));
+			AddLog("  " STRREF_FMT, STRREF_ARG(text));
+		} else {
+			AddLog("No source for $%04x", addr);
+		}
+	} else if (cmd.same_str("lst")) {
+		strown<64> addrStr(param);
+		uint16_t addr = addrStr ? (uint16_t)ValueFromExpression(addrStr.c_str()) : GetRegs().PC;
+		int count = GetListingCount(addr);
+		if (!count) { AddLog("No listing for $%04x", addr); }
+		for (int i = 0; i < count; ++i) {
+			strref section;
+			strref text = GetListingAt(addr, i, &section);
+			AddLog("$%04x " STRREF_FMT ": " STRREF_FMT, addr, STRREF_ARG(section), STRREF_ARG(text));
+		}
+	} else if (cmd.same_str("hotreload")) {
+		if (param.same_str("on")) { SetHotReload(true); }
+		else if (param.same_str("off")) { SetHotReload(false); }
+		const HotReloadStats& stats = GetHotReloadStats();
+		AddLog("Hot reload %s, %u reloads", GetHotReload() ? "on" : "off", stats.reloads);
+		if (stats.reloads) {
+			AddLog("Last: %u bytes patched in %u ranges, files $%x, %u.%03u ms", stats.bytes, stats.ranges, stats.files, stats.micros / 1000, stats.micros % 1000);
+		}
+	} else if (cmd.same_str("srcmem")) {
+		if (param) { SetSourceMemoryBudget((size_t)param.atoi() * 1024 * 1024); }
+		size_t mapped;
+		size_t budget = GetSourceMemoryBudget(&mapped);
+		AddLog("Source files mapped: %u KB, budget %u MB", (uint32_t)(mapped / 1024), (uint32_t)(budget / (1024 * 1024)));
 	} else if (cmd.same_str("font")) {
 		SelectFont((int)param.atoi());
 	} else if (cmd.same_str("hist") || cmd.same_str("history")) {
@@ -476,6 +777,29 @@ void ViceConsole::ExecCommand(const char* command_line)
 		AddLog(" font <size> - set font size 0-4");
 		AddLog(" sync - redo copy machine state from VICE");
 		AddLog(" eval <exp> - evaluate an expression");
+		AddLog(" heat on/off/clear - collect memory access heatmap");
+		AddLog(" callgraph/cg on/off/clear/top <n>/save <file> - record call paths, save as collapsed stacks");
+		AddLog(" tracerec <file>/off - record an execution trace to a file");
+		AddLog(" traceshow <file> [#index|@cycle] [count] - list records from a trace file");
+		AddLog(" tracediff <file a> <file b> [context] - find the first divergence between two traces");
+		AddLog(" bus [on/off] - sub-instruction timing, lists the bus cycles of the last instruction");
+		AddLog(" fork [list] - copy-on-write fork of the current state to try changes on");
+		AddLog(" fork <n> go [count]/to <addr>/poke <addr> <value>/mem <addr>/stop/discard - run or inspect a fork");
+		AddLog(" writes <addr> [count] - list the most recent writes to an address in the undo history");
+		AddLog(" revwrite <addr> [end] - step back to before the most recent write to an address or range");
+		AddLog(" revcond <exp> - step back to the most recent state where an expression is true or a breakpoint hits");
+		AddLog(" tp <addr> <exp>[, <exp>..] - log expressions each time the pc reaches addr without stopping");
+		AddLog(" tp [list]/del <id>/del all - list or remove tracepoints");
+		AddLog(" bplist - list local breakpoints with hit counts");
+		AddLog(" bpevery <id> <n> - only stop on every nth hit of a breakpoint");
+		AddLog(" bpreset [id] - clear hit and ignore counts");
+		AddLog(" tbreak <addr> - breakpoint that is removed the first time it stops");
+		AddLog(" src [addr] - show the source file and line for an address, default pc");
+		AddLog(" srcbp <file>:<line> - breakpoint at the first address built by a source line");
+		AddLog(" lst [addr] - show the listing lines of every section for an address, default pc");
+		AddLog(" hotreload [on/off] - reload the binary, symbols, listing and debug info when the files change");
+		AddLog(" srcmem [MB] - show or set how much source text may stay mapped");
+		AddLog(" ignore <id> [count]/until <addr> - handled locally when VICE is not connected");
 		AddLog(" history/hist - show previous commands");
 		AddLog(" clear - clear the console");
 	}
@@ -510,6 +834,12 @@ int ViceConsole::TextEditCallback(ImGuiInputTextCallbackData* data)
 	switch (data->EventFlag) {
 		case ImGuiInputTextFlags_CallbackCompletion:
 		{
+			SymbolSearchResult matches[16];
+			int numMatches = CompleteSymbolInput(data, matches, 16);
+			if (numMatches > 1) {
+				AddLog("Possible matches:\n");
+				for (int m = 0; m < numMatches; ++m) { AddLog("- $%04x %s\n", matches[m].address, matches[m].name); }
+			}
 			break;
 		}
 		case ImGuiInputTextFlags_CallbackHistory:
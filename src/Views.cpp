@@ -7,6 +7,7 @@
 #include "GfxView.h"
 #include "WatchView.h"
 #include "BreakView.h"
+#include "LabelView.h"
 #include "ToolBar.h"
 #include "machine.h"
 #include "Image.h"
@@ -14,6 +15,7 @@
 #include "CodeControl.h"
 #include "ViceConnect.h"
 #include "FileDialog.h"
+#include "SourceDebug.h"
 #include "..\Data\C64_Pro_Mono-STYLE.ttf.h"
 
 // font sizes
@@ -48,6 +50,7 @@ struct IceBroViews {
 	GfxView gfxView[gfxViewCount];
 	WatchView watchView[watchViewCount];
 	BreakView breakView;
+	LabelView labelView;
 	TimeView timeView;
 	ToolBar toolBar;
 	ImFont* aFonts[sNumFontSizes];
@@ -55,6 +58,7 @@ struct IceBroViews {
 	IceBroViews() {}
 
 	void FocusPC();
+	void FocusAddress(uint16_t addr);
 	void LoadViews();
 	void SaveViews();
 	void DrawViews();
@@ -111,6 +115,11 @@ void FocusPC()
 	if (sViews) { sViews->FocusPC(); }
 }
 
+void FocusAddress(uint16_t addr)
+{
+	if (sViews) { sViews->FocusAddress(addr); }
+}
+
 
 void UpdateMainWindowWidthHeight(int width, int height)
 {
@@ -129,6 +138,7 @@ void ViewsWriteConfig(UserData& config)
 	config.AddValue(strref("fontSize"), currFont);
 	config.AddValue(strref("width"), windowWidth);
 	config.AddValue(strref("height"), windowHeight);
+	config.AddValue(strref("sourceMemoryMB"), (int)(GetSourceMemoryBudget() / (1024 * 1024)));
 }
 
 void ViewsReadConfig(strref config)
@@ -143,6 +153,8 @@ void ViewsReadConfig(strref config)
 			windowWidth = (int)value.atoi();
 		} else if (name.same_str("height") && type == CPT_Value) {
 			windowHeight = (int)value.atoi();
+		} else if (name.same_str("sourceMemoryMB") && type == CPT_Value) {
+			SetSourceMemoryBudget((size_t)value.atoi() * 1024 * 1024);
 		}
 	}
 }
@@ -158,6 +170,15 @@ void IceBroViews::FocusPC()
 	}
 }
 
+void IceBroViews::FocusAddress(uint16_t addr)
+{
+	for (int c = 0; c < codeViewCount; ++c) {
+		if (!disAsmView[c].fixedAddress && disAsmView[c].open) {
+			disAsmView[c].SetAddr(addr);
+		}
+	}
+}
+
 void IceBroViews::LoadViews()
 {
 	FILE* f;
@@ -194,6 +215,8 @@ void IceBroViews::LoadViews()
 				}
 			} else if (name.same_str("RegisterView") && type == CPT_Struct) {
 				regView.ReadConfig(value);
+			} else if (name.same_str("LabelView") && type == CPT_Struct) {
+				labelView.ReadConfig(value);
 			} else if (name.same_str("TimeView") && type == CPT_Struct) {
 				timeView.ReadConfig(value);
 			} else if (name.same_str("ScreenView") && type == CPT_Array) {
@@ -254,6 +277,10 @@ void IceBroViews::SaveViews()
 	regView.WriteConfig(conf);
 	conf.EndStruct();
 
+	conf.BeginStruct(strref("LabelView"));
+	labelView.WriteConfig(conf);
+	conf.EndStruct();
+
 	conf.BeginStruct(strref("TimeView"));
 	timeView.WriteConfig(conf);
 	conf.EndStruct();
@@ -346,6 +373,7 @@ void IceBroViews::DrawViews()
 		CheckLoadKickDebug();
 		CheckSymFileLoad();
 		CheckLoadViceCommand();
+		CheckHotReload();
 
 		{
 			if (ImGui::BeginMainMenuBar()) {
@@ -406,6 +434,7 @@ void IceBroViews::DrawViews()
 						ImGui::EndMenu();
 					}
 					if (ImGui::MenuItem("Breakpoints", NULL, breakView.open)) { breakView.open = !breakView.open; }
+					if (ImGui::MenuItem("Labels", NULL, labelView.open)) { labelView.open = !labelView.open; }
 					if (ImGui::MenuItem("TimeView", NULL, timeView.open)) { timeView.open = !timeView.open; }
 					if (ImGui::MenuItem("Toolbar", NULL, toolBar.open)) { toolBar.open = !toolBar.open; }
 					ImGui::EndMenu();
@@ -442,6 +471,8 @@ void IceBroViews::DrawViews()
 
 	breakView.Draw();
 
+	labelView.Draw();
+
 	ImGui::PopFont();
 }
 
@@ -6,6 +6,7 @@ extern float fontCharWidth;
 extern float fontCharHeight;
 
 void FocusPC();
+void FocusAddress(uint16_t addr);
 void UpdateMainWindowWidthHeight( int width, int height );
 int GetMainWindowWidthHeight( int *width );
 void ViewsWriteConfig( UserData& config );
@@ -10,12 +10,20 @@
 #include "Expressions.h"
 #include "machine.h"
 #include "Config.h"
+#include "sym.h"
+#include "ImGui_Helper.h"
 
 WatchView::WatchView() : open( false ), rebuildAll( false ), recalcAll( false )
 {
 	numExpressions = 0;
 	editExpression = -1;
 	prevWidth = 0;
+	for( int i = 0; i < MaxExp; ++i ) {
+		memset( deps[ i ].pages, 0, sizeof( deps[ i ].pages ) );
+		deps[ i ].writeGen = 0;
+		deps[ i ].symbolGen = 0;
+		deps[ i ].usesRegs = false;
+	}
 }
 
 static void DrawBlueTextLine()
@@ -44,9 +52,39 @@ void WatchView::Evaluate( int index )
 
 	rpnExp[index].set_len( BuildExpression( expression.get(), (uint8_t*)rpnExp[index].charstr(), rpnExp[index].cap() ) );
 	types[ index ] = type;
+	deps[ index ].symbolGen = GetSymbolGeneration();
+	deps[ index ].usesRegs = ExpressionUsesRegs( (const uint8_t*)rpnExp[ index ].get() );
 	EvaluateItem( index );
 }
 
+static void WatchDepRange( WatchView::WatchDeps &dep, int addr, int bytes )
+{
+	for( int page = ( addr & 0xffff ) >> 8, last = ( ( addr + bytes - 1 ) & 0xffff ) >> 8; ; page = ( page + 1 ) & 0xff ) {
+		dep.pages[ page >> 6 ] |= 1ULL << ( page & 63 );
+		if( page == last ) { break; }
+	}
+}
+
+static uint8_t WatchGetByte( uint16_t addr, void *user )
+{
+	WatchDepRange( *(WatchView::WatchDeps*)user, addr, 1 );
+	return Get6502Byte( addr );
+}
+
+bool WatchView::InputsChanged( int index )
+{
+	WatchDeps &dep = deps[ index ];
+	if( dep.symbolGen != GetSymbolGeneration() ) { return true; }
+	if( dep.usesRegs && dep.regs != GetRegs() ) { return true; }
+	for( int p = 0; p < 4; ++p ) {
+		uint64_t bits = dep.pages[ p ];
+		for( int page = p * 64; bits; ++page, bits >>= 1 ) {
+			if( ( bits & 1 ) && int32_t( GetPageWriteGeneration( (uint8_t)page ) - dep.writeGen ) > 0 ) { return true; }
+		}
+	}
+	return false;
+}
+
 void WatchView::EvaluateItem( int index )
 {
 	if( index<0 || index >= MaxExp )
@@ -54,9 +92,13 @@ void WatchView::EvaluateItem( int index )
 
 	uint8_t *rpn = (uint8_t*)rpnExp[ index ].charstr();
 	strown<64> buf;
+	WatchDeps &dep = deps[ index ];
+	memset( dep.pages, 0, sizeof( dep.pages ) );
+	dep.writeGen = GetWriteGeneration();
+	dep.regs = GetRegs();
 	if( rpn && rpn[ 0 ] ) {
+		int result = EvalExpression( rpn, dep.regs, WatchGetByte, &dep );
 		if( types[ index ] == WT_NORMAL ) {
-			int result = EvalExpression( rpn );
 			if( result < 0 ) {
 				buf.append( '-' );
 				result = -result;
@@ -70,15 +112,17 @@ void WatchView::EvaluateItem( int index )
 			} else
 				buf.append_num( result, 2, 16 );
 		} else if( types[ index ] == WT_BYTES ) {
-			int addr = EvalExpression( rpn );
+			int addr = result;
 			buf.append( '$' ).append_num( addr, 4, 16 );
 			int num_bytes = int( ( (ImGui::GetWindowWidth() - ImGui::GetColumnWidth()) - 6 * fontCharWidth ) / (3 * fontCharWidth) );
+			if( num_bytes > 0 ) { WatchDepRange( dep, addr, num_bytes ); }
 			for( int b = 0; b < num_bytes && buf.left() > 3; b++ ) {
 				buf.append( ' ' );
 				buf.append_num( Get6502Byte( addr++ ), 2, 16 );
 			}
 		} else {
-			int addr = EvalExpression( rpn );
+			int addr = result;
+			WatchDepRange( dep, addr, 3 );
 			int disChars = 0, branchTrg = 0;
 			buf.append( '$' ).append_num( addr, 4, 16 ).append( ' ' );
 			Disassemble( addr, buf.charend(), buf.left(), disChars, branchTrg, true, true );
@@ -157,8 +201,11 @@ void WatchView::Draw( int index )
 		if( i != editExpression ) {
 			if( ( i & 1 ) == 0 ) { DrawBlueTextLine(); }
 			ImGui::Text( expressions[ i ].c_str() );
-			if( MemoryChange() ) { Evaluate( i ); }
-		} else if( ImGui::InputText( "exp", expressions[ i ].charstr(), expressions[ i ].cap(), ImGuiInputTextFlags_EnterReturnsTrue ) ) {
+			if( MemoryChange() && InputsChanged( i ) ) {
+				if( deps[ i ].symbolGen != GetSymbolGeneration() ) { Evaluate( i ); }
+				else { EvaluateItem( i ); }
+			}
+		} else if( ImGui::InputText( "exp", expressions[ i ].charstr(), expressions[ i ].cap(), ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CallbackCompletion, SymbolCompletionCallback ) ) {
 			expressions[ i ].set_len( (strl_t)strlen( expressions[ i ].get() ));
 			Evaluate( i );
 			if( i >= numExpressions ) { numExpressions = i + 1; }
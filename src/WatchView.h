@@ -1,4 +1,5 @@
 #pragma once
+#include "machine.h"
 struct UserData;
 
 struct WatchView
@@ -13,6 +14,16 @@ struct WatchView
 		MaxExp = 128
 	};
 
+	// inputs of the most recent evaluation, a watch is only evaluated
+	// again when one of these changed
+	struct WatchDeps {
+		uint64_t pages[ 4 ];	// memory pages read
+		uint32_t writeGen;		// machine write generation at evaluation
+		uint32_t symbolGen;		// labels are resolved when the expression is built
+		Regs regs;				// registers at evaluation if the expression reads any
+		bool usesRegs;
+	};
+
 	int numExpressions;
 	int editExpression;
 	int prevWidth;
@@ -20,6 +31,7 @@ struct WatchView
 	strown<64> rpnExp[ MaxExp ];
 	strown<64> results[ MaxExp ];
 	WatchType types[ MaxExp ];
+	WatchDeps deps[ MaxExp ];
 	bool open;
 	bool rebuildAll;
 	bool recalcAll;
@@ -30,6 +42,8 @@ struct WatchView
 
 	void EvaluateItem( int index );
 
+	bool InputsChanged( int index );
+
 	void WriteConfig( UserData & config );
 
 	void ReadConfig( strref config );
@@ -129,26 +129,37 @@ public:
 
 	// illegal opcodes
 
-	void SLO(uint16_t arg) { r.T = 0xff; }
-	void ANC(uint16_t arg) { r.T = 0xff; }
-	void RLA(uint16_t arg) { r.T = 0xff; }
-	void AAC(uint16_t arg) { r.T = 0xff; }
-	void ISC(uint16_t arg) { r.T = 0xff; }
-	void SBI(uint16_t arg) { r.T = 0xff; }
-	void DCP(uint16_t arg) { r.T = 0xff; }
-	void SRE(uint16_t arg) { r.T = 0xff; }
-	void ALR(uint16_t arg) { r.T = 0xff; }
-	void RRA(uint16_t arg) { r.T = 0xff; }
-	void ARR(uint16_t arg) { r.T = 0xff; }
-	void SAX(uint16_t arg) { r.T = 0xff; }
-	void LAX(uint16_t arg) { r.T = 0xff; }
-	void AXS(uint16_t arg) { r.T = 0xff; }
-	void LAS(uint16_t arg) { r.T = 0xff; }
-	void AHX(uint16_t arg) { r.T = 0xff; }
-	void SHX(uint16_t arg) { r.T = 0xff; }
-	void TAS(uint16_t arg) { r.T = 0xff; }
-	void SHY(uint16_t arg) { r.T = 0xff; }
-	void XAA(uint16_t arg) { r.T = 0xff; }
+	void SLO(uint16_t arg);
+	void ANC(uint16_t arg);
+	void RLA(uint16_t arg);
+	void AAC(uint16_t arg) { ANC(arg); }
+	void ISC(uint16_t arg);
+	void SBI(uint16_t arg) { SBC(arg); }
+	void DCP(uint16_t arg);
+	void SRE(uint16_t arg);
+	void ALR(uint16_t arg);
+	void RRA(uint16_t arg);
+	void ARR(uint16_t arg);
+	void SAX(uint16_t arg);
+	void LAX(uint16_t arg);
+	void LXA(uint16_t arg);
+	void AXS(uint16_t arg);
+	void LAS(uint16_t arg);
+	void AHX(uint16_t arg);
+	void SHX(uint16_t arg);
+	void TAS(uint16_t arg);
+	void SHY(uint16_t arg);
+	void XAA(uint16_t arg);
+
+	void IGN(uint16_t arg);
+
+	// shared by the documented and illegal instructions
+	void AddA(uint8_t m);
+	void SubA(uint8_t m);
+	void Compare(uint8_t reg, uint8_t m);
+	void StoreHigh(uint16_t arg, uint8_t index, uint8_t value);
+	void Branch(uint16_t arg);
+	void JSRBus();
 
 	// Registers
 	Regs r;
@@ -156,15 +167,57 @@ public:
 	// read/write callbacks
 	CBGetByte GetByte;
 	CBSetByte SetByte;
+	void *user;
+
+	// bus cycle mode reports every access including dummy reads and writes
+	CBBusCycle BusCycle;
+	uint8_t busCycle;
+	uint8_t lastWrite;
+	bool indexedRead;	// instruction only reads its operand, odd time in the opcode table
+
+	inline uint8_t Rd(uint16_t addr) {
+		uint8_t value = GetByte(addr, user);
+		if (BusCycle) { BusCycle(addr, value, busCycle++, BUS_READ, user); }
+		return value;
+	}
+	inline void Wr(uint16_t addr, uint8_t value) {
+		if (BusCycle) { BusCycle(addr, value, busCycle++, BUS_WRITE, user); }
+		SetByte(addr, value, user);
+		lastWrite = value;
+	}
+	inline void Dummy(uint16_t addr) {
+		if (BusCycle) { BusCycle(addr, GetByte(addr, user), busCycle++, BUS_DUMMY_READ, user); }
+	}
+	// indexed modes read before the high byte is fixed, reads skip this if no page was crossed
+	inline void IndexDummy(uint8_t l, uint8_t h, uint8_t index) {
+		if (!indexedRead || (l + index) >= 0x100) { Dummy((uint16_t(h) << 8) | uint8_t(l + index)); }
+	}
+	// read-modify-write instructions write back the unmodified value first
+	inline uint8_t RdModify(uint16_t addr) {
+		uint8_t value = Rd(addr);
+		if (BusCycle) {
+			BusCycle(addr, value, busCycle++, BUS_DUMMY_WRITE, user);
+			SetByte(addr, value, user);
+		}
+		return value;
+	}
 
 	// indirect page boundary crossed
 	bool penalty;
 
+	// taken branch landed on another page
+	bool branchPage;
+
 	// set up class for stepping or setting status
-	cpu(const Regs &regs, CBGetByte read, CBSetByte write) : penalty(false) {
+	cpu(const Regs &regs, CBGetByte read, CBSetByte write, void *cbUser, CBBusCycle bus = nullptr) : penalty(false), branchPage(false) {
 		r = regs;
 		GetByte = read;
 		SetByte = write;
+		user = cbUser;
+		BusCycle = bus;
+		busCycle = 0;
+		lastWrite = 0;
+		indexedRead = false;
 	}
 
 	// actions
@@ -178,317 +231,333 @@ cpu::Opcode table[256] = {
 	{ &cpu::BRK, 0x0e, AM_NON },
 	{ &cpu::ORA, 0x0c, AM_ZP_REL_X },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::SLO, 0xff, AM_ZP_REL_X },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::SLO, 0x10, AM_ZP_REL_X },
+	{ &cpu::IGN, 0x06, AM_ZP },
 	{ &cpu::ORA, 0x06, AM_ZP },
 	{ &cpu::ASL, 0x0a, AM_ZP },
-	{ &cpu::SLO, 0xff, AM_ZP },
+	{ &cpu::SLO, 0x0a, AM_ZP },
 	{ &cpu::PHP, 0x06, AM_NON },
 	{ &cpu::ORA, 0x04, AM_IMM },
 	{ &cpu::ASLA, 0x04, AM_NON },
-	{ &cpu::ANC, 0xff, AM_IMM },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::ANC, 0x04, AM_IMM },
+	{ &cpu::IGN, 0x08, AM_ABS },
 	{ &cpu::ORA, 0x08, AM_ABS },
 	{ &cpu::ASL, 0x0c, AM_ABS },
-	{ &cpu::SLO, 0xff, AM_ABS },
+	{ &cpu::SLO, 0x0c, AM_ABS },
 	{ &cpu::BPL, 0x05, AM_BRANCH },
 	{ &cpu::ORA, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::SLO, 0xff, AM_ZP_Y_REL },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::SLO, 0x10, AM_ZP_Y_REL },
+	{ &cpu::IGN, 0x08, AM_ZP_X },
 	{ &cpu::ORA, 0x08, AM_ZP_X },
 	{ &cpu::ASL, 0x0c, AM_ZP_X },
-	{ &cpu::SLO, 0xff, AM_ZP_X },
+	{ &cpu::SLO, 0x0c, AM_ZP_X },
 	{ &cpu::CLC, 0x04, AM_NON },
 	{ &cpu::ORA, 0x09, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::SLO, 0xff, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::NOP, 0x04, AM_NON },
+	{ &cpu::SLO, 0x0e, AM_ABS_Y },
+	{ &cpu::IGN, 0x09, AM_ABS_X },
 	{ &cpu::ORA, 0x09, AM_ABS_X },
 	{ &cpu::ASL, 0x0e, AM_ABS_X },
-	{ &cpu::SLO, 0xff, AM_ABS_X },
+	{ &cpu::SLO, 0x0e, AM_ABS_X },
 	{ &cpu::JSR, 0x0c, AM_ABS },
 	{ &cpu::AND, 0x0c, AM_ZP_REL_X },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::RLA, 0xff, AM_ZP_REL_X },
+	{ &cpu::RLA, 0x10, AM_ZP_REL_X },
 	{ &cpu::BIT, 0x06, AM_ZP },
 	{ &cpu::AND, 0x06, AM_ZP },
 	{ &cpu::ROL, 0x0a, AM_ZP },
-	{ &cpu::RLA, 0xff, AM_ZP },
+	{ &cpu::RLA, 0x0a, AM_ZP },
 	{ &cpu::PLP, 0x08, AM_NON },
 	{ &cpu::AND, 0x04, AM_IMM },
 	{ &cpu::ROLA, 0x04, AM_ACC },
-	{ &cpu::AAC, 0xff, AM_IMM },
+	{ &cpu::AAC, 0x04, AM_IMM },
 	{ &cpu::BIT, 0x08, AM_ABS },
 	{ &cpu::AND, 0x08, AM_ABS },
 	{ &cpu::ROL, 0x0c, AM_ABS },
-	{ &cpu::RLA, 0xff, AM_ABS },
+	{ &cpu::RLA, 0x0c, AM_ABS },
 	{ &cpu::BMI, 0x05, AM_BRANCH },
 	{ &cpu::AND, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::RLA, 0xff, AM_ZP_Y_REL },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::RLA, 0x10, AM_ZP_Y_REL },
+	{ &cpu::IGN, 0x08, AM_ZP_X },
 	{ &cpu::AND, 0x08, AM_ZP_X },
 	{ &cpu::ROL, 0x0c, AM_ZP_X },
-	{ &cpu::RLA, 0xff, AM_ZP_X },
+	{ &cpu::RLA, 0x0c, AM_ZP_X },
 	{ &cpu::SEC, 0x04, AM_NON },
 	{ &cpu::AND, 0x09, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::RLA, 0xff, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::NOP, 0x04, AM_NON },
+	{ &cpu::RLA, 0x0e, AM_ABS_Y },
+	{ &cpu::IGN, 0x09, AM_ABS_X },
 	{ &cpu::AND, 0x09, AM_ABS_X },
 	{ &cpu::ROL, 0x0e, AM_ABS_X },
-	{ &cpu::RLA, 0xff, AM_ABS_X },
+	{ &cpu::RLA, 0x0e, AM_ABS_X },
 	{ &cpu::RTI, 0x0c, AM_NON },
 	{ &cpu::EOR, 0x0c, AM_ZP_REL_X },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::SRE, 0xff, AM_ZP_REL_X },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::SRE, 0x10, AM_ZP_REL_X },
+	{ &cpu::IGN, 0x06, AM_ZP },
 	{ &cpu::EOR, 0x06, AM_ZP },
 	{ &cpu::LSR, 0x0a, AM_ZP },
-	{ &cpu::SRE, 0xff, AM_ZP },
+	{ &cpu::SRE, 0x0a, AM_ZP },
 	{ &cpu::PHA, 0x06, AM_NON },
 	{ &cpu::EOR, 0x04, AM_IMM },
 	{ &cpu::LSRA, 0x04, AM_ACC },
-	{ &cpu::ALR, 0xff, AM_IMM },
+	{ &cpu::ALR, 0x04, AM_IMM },
 	{ &cpu::JMP, 0x06, AM_ABS },
 	{ &cpu::EOR, 0x08, AM_ABS },
 	{ &cpu::LSR, 0x0c, AM_ABS },
-	{ &cpu::SRE, 0xff, AM_ABS },
+	{ &cpu::SRE, 0x0c, AM_ABS },
 	{ &cpu::BVC, 0x05, AM_BRANCH },
 	{ &cpu::EOR, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::SRE, 0xff, AM_ZP_Y_REL },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::SRE, 0x10, AM_ZP_Y_REL },
+	{ &cpu::IGN, 0x08, AM_ZP_X },
 	{ &cpu::EOR, 0x08, AM_ZP_X },
 	{ &cpu::LSR, 0x0c, AM_ZP_X },
-	{ &cpu::SRE, 0xff, AM_ZP_X },
+	{ &cpu::SRE, 0x0c, AM_ZP_X },
 	{ &cpu::CLI, 0x04, AM_NON },
 	{ &cpu::EOR, 0x09, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::SRE, 0xff, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::NOP, 0x04, AM_NON },
+	{ &cpu::SRE, 0x0e, AM_ABS_Y },
+	{ &cpu::IGN, 0x09, AM_ABS_X },
 	{ &cpu::EOR, 0x09, AM_ABS_X },
 	{ &cpu::LSR, 0x0e, AM_ABS_X },
-	{ &cpu::SRE, 0xff, AM_ABS_X },
+	{ &cpu::SRE, 0x0e, AM_ABS_X },
 	{ &cpu::RTS, 0x0c, AM_NON },
 	{ &cpu::ADC, 0x0c, AM_ZP_REL_X },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::RRA, 0xff, AM_ZP_REL_X },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::RRA, 0x10, AM_ZP_REL_X },
+	{ &cpu::IGN, 0x06, AM_ZP },
 	{ &cpu::ADC, 0x06, AM_ZP },
 	{ &cpu::ROR, 0x0a, AM_ZP },
-	{ &cpu::RRA, 0xff, AM_ZP },
+	{ &cpu::RRA, 0x0a, AM_ZP },
 	{ &cpu::PLA, 0x08, AM_NON },
 	{ &cpu::ADC, 0x04, AM_IMM },
 	{ &cpu::RORA, 0x04, AM_ACC },
-	{ &cpu::ARR, 0xff, AM_IMM },
+	{ &cpu::ARR, 0x04, AM_IMM },
 	{ &cpu::JMP, 0x0a, AM_REL },
 	{ &cpu::ADC, 0x08, AM_ABS },
 	{ &cpu::ROR, 0x0c, AM_ABS },
-	{ &cpu::RRA, 0xff, AM_ABS },
+	{ &cpu::RRA, 0x0c, AM_ABS },
 	{ &cpu::BVS, 0x05, AM_BRANCH },
 	{ &cpu::ADC, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::RRA, 0xff, AM_ZP_Y_REL },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::RRA, 0x10, AM_ZP_Y_REL },
+	{ &cpu::IGN, 0x08, AM_ZP_X },
 	{ &cpu::ADC, 0x08, AM_ZP_X },
 	{ &cpu::ROR, 0x0c, AM_ZP_X },
-	{ &cpu::RRA, 0xff, AM_ZP_X },
+	{ &cpu::RRA, 0x0c, AM_ZP_X },
 	{ &cpu::SEI, 0x04, AM_NON },
 	{ &cpu::ADC, 0x09, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::RRA, 0xff, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::NOP, 0x04, AM_NON },
+	{ &cpu::RRA, 0x0e, AM_ABS_Y },
+	{ &cpu::IGN, 0x09, AM_ABS_X },
 	{ &cpu::ADC, 0x09, AM_ABS_X },
 	{ &cpu::ROR, 0x0e, AM_ABS_X },
-	{ &cpu::RRA, 0xff, AM_ABS_X },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::RRA, 0x0e, AM_ABS_X },
+	{ &cpu::IGN, 0x04, AM_IMM },
 	{ &cpu::STA, 0x0c, AM_ZP_REL_X },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::SAX, 0xff, AM_ZP_REL_Y },
+	{ &cpu::IGN, 0x04, AM_IMM },
+	{ &cpu::SAX, 0x0c, AM_ZP_REL_X },
 	{ &cpu::STY, 0x06, AM_ZP },
 	{ &cpu::STA, 0x06, AM_ZP },
 	{ &cpu::STX, 0x06, AM_ZP },
-	{ &cpu::SAX, 0xff, AM_ZP },
+	{ &cpu::SAX, 0x06, AM_ZP },
 	{ &cpu::DEY, 0x04, AM_NON },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::IGN, 0x04, AM_IMM },
 	{ &cpu::TXA, 0x04, AM_NON },
-	{ &cpu::XAA, 0xff, AM_IMM },
+	{ &cpu::XAA, 0x04, AM_IMM },
 	{ &cpu::STY, 0x08, AM_ABS },
 	{ &cpu::STA, 0x08, AM_ABS },
 	{ &cpu::STX, 0x08, AM_ABS },
-	{ &cpu::SAX, 0xff, AM_ABS },
+	{ &cpu::SAX, 0x08, AM_ABS },
 	{ &cpu::BCC, 0x05, AM_BRANCH },
 	{ &cpu::STA, 0x0c, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::AHX, 0xff, AM_ZP_REL_Y },
+	{ &cpu::AHX, 0x0c, AM_ZP_Y_REL },
 	{ &cpu::STY, 0x08, AM_ZP_X },
 	{ &cpu::STA, 0x08, AM_ZP_X },
 	{ &cpu::STX, 0x08, AM_ZP_Y },
-	{ &cpu::SAX, 0xff, AM_ZP_Y },
+	{ &cpu::SAX, 0x08, AM_ZP_Y },
 	{ &cpu::TYA, 0x04, AM_NON },
 	{ &cpu::STA, 0x0a, AM_ABS_Y },
 	{ &cpu::TXS, 0x04, AM_NON },
-	{ &cpu::TAS, 0xff, AM_ABS_Y },
-	{ &cpu::SHY, 0xff, AM_ABS_X },
+	{ &cpu::TAS, 0x0a, AM_ABS_Y },
+	{ &cpu::SHY, 0x0a, AM_ABS_X },
 	{ &cpu::STA, 0x0a, AM_ABS_X },
-	{ &cpu::SHX, 0xff, AM_ABS_Y },
-	{ &cpu::AHX, 0xff, AM_ABS_Y },
+	{ &cpu::SHX, 0x0a, AM_ABS_Y },
+	{ &cpu::AHX, 0x0a, AM_ABS_Y },
 	{ &cpu::LDY, 0x04, AM_IMM },
 	{ &cpu::LDA, 0x0c, AM_ZP_REL_X },
 	{ &cpu::LDX, 0x04, AM_IMM },
-	{ &cpu::LAX, 0xff, AM_ZP_REL_Y },
+	{ &cpu::LAX, 0x0c, AM_ZP_REL_X },
 	{ &cpu::LDY, 0x06, AM_ZP },
 	{ &cpu::LDA, 0x06, AM_ZP },
 	{ &cpu::LDX, 0x06, AM_ZP },
-	{ &cpu::LAX, 0xff, AM_ZP },
+	{ &cpu::LAX, 0x06, AM_ZP },
 	{ &cpu::TAY, 0x04, AM_NON },
 	{ &cpu::LDA, 0x04, AM_IMM },
 	{ &cpu::TAX, 0x04, AM_NON },
-	{ &cpu::LAX, 0xff, AM_IMM },
+	{ &cpu::LXA, 0x04, AM_IMM },
 	{ &cpu::LDY, 0x08, AM_ABS },
 	{ &cpu::LDA, 0x08, AM_ABS },
 	{ &cpu::LDX, 0x08, AM_ABS },
-	{ &cpu::LAX, 0xff, AM_ABS },
+	{ &cpu::LAX, 0x08, AM_ABS },
 	{ &cpu::BCS, 0x05, AM_BRANCH },
 	{ &cpu::LDA, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::LAX, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::LDY, 0x08, AM_ZP_X },
 	{ &cpu::LDA, 0x08, AM_ZP_X },
 	{ &cpu::LDX, 0x08, AM_ZP_Y },
-	{ &cpu::LAX, 0xff, AM_ZP_Y },
+	{ &cpu::LAX, 0x08, AM_ZP_Y },
 	{ &cpu::CLV, 0x04, AM_NON },
 	{ &cpu::LDA, 0x09, AM_ABS_Y },
 	{ &cpu::TSX, 0x04, AM_NON },
-	{ &cpu::LAS, 0xff, AM_ABS_Y },
+	{ &cpu::LAS, 0x09, AM_ABS_Y },
 	{ &cpu::LDY, 0x09, AM_ABS_X },
 	{ &cpu::LDA, 0x09, AM_ABS_X },
 	{ &cpu::LDX, 0x09, AM_ABS_Y },
-	{ &cpu::LAX, 0xff, AM_ABS_Y },
+	{ &cpu::LAX, 0x09, AM_ABS_Y },
 	{ &cpu::CPY, 0x04, AM_IMM },
 	{ &cpu::CMP, 0x0c, AM_ZP_REL_X },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::DCP, 0xff, AM_ZP_REL_X },
+	{ &cpu::IGN, 0x04, AM_IMM },
+	{ &cpu::DCP, 0x10, AM_ZP_REL_X },
 	{ &cpu::CPY, 0x06, AM_ZP },
 	{ &cpu::CMP, 0x06, AM_ZP },
 	{ &cpu::DEC, 0x0a, AM_ZP },
-	{ &cpu::DCP, 0xff, AM_ZP },
+	{ &cpu::DCP, 0x0a, AM_ZP },
 	{ &cpu::INY, 0x04, AM_NON },
 	{ &cpu::CMP, 0x04, AM_IMM },
 	{ &cpu::DEX, 0x04, AM_NON },
-	{ &cpu::AXS, 0xff, AM_IMM },
+	{ &cpu::AXS, 0x04, AM_IMM },
 	{ &cpu::CPY, 0x08, AM_ABS },
 	{ &cpu::CMP, 0x08, AM_ABS },
 	{ &cpu::DEC, 0x0c, AM_ABS },
-	{ &cpu::DCP, 0xff, AM_ABS },
+	{ &cpu::DCP, 0x0c, AM_ABS },
 	{ &cpu::BNE, 0x05, AM_BRANCH },
 	{ &cpu::CMP, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::DCP, 0xff, AM_ZP_Y_REL },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::DCP, 0x10, AM_ZP_Y_REL },
+	{ &cpu::IGN, 0x08, AM_ZP_X },
 	{ &cpu::CMP, 0x08, AM_ZP_X },
 	{ &cpu::DEC, 0x0c, AM_ZP_X },
-	{ &cpu::DCP, 0xff, AM_ZP_X },
+	{ &cpu::DCP, 0x0c, AM_ZP_X },
 	{ &cpu::CLD, 0x04, AM_NON },
 	{ &cpu::CMP, 0x09, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::DCP, 0xff, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::NOP, 0x04, AM_NON },
+	{ &cpu::DCP, 0x0e, AM_ABS_Y },
+	{ &cpu::IGN, 0x09, AM_ABS_X },
 	{ &cpu::CMP, 0x09, AM_ABS_X },
 	{ &cpu::DEC, 0x0e, AM_ABS_X },
-	{ &cpu::DCP, 0xff, AM_ABS_X },
+	{ &cpu::DCP, 0x0e, AM_ABS_X },
 	{ &cpu::CPX, 0x04, AM_IMM },
 	{ &cpu::SBC, 0x0c, AM_ZP_REL_X },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::ISC, 0xff, AM_ZP_REL_X },
+	{ &cpu::IGN, 0x04, AM_IMM },
+	{ &cpu::ISC, 0x10, AM_ZP_REL_X },
 	{ &cpu::CPX, 0x06, AM_ZP },
 	{ &cpu::SBC, 0x06, AM_ZP },
 	{ &cpu::INC, 0x0a, AM_ZP },
-	{ &cpu::ISC, 0xff, AM_ZP },
+	{ &cpu::ISC, 0x0a, AM_ZP },
 	{ &cpu::INX, 0x04, AM_NON },
 	{ &cpu::SBC, 0x04, AM_IMM },
 	{ &cpu::NOP, 0x04, AM_NON },
-	{ &cpu::SBI, 0xff, AM_IMM },
+	{ &cpu::SBI, 0x04, AM_IMM },
 	{ &cpu::CPX, 0x08, AM_ABS },
 	{ &cpu::SBC, 0x08, AM_ABS },
 	{ &cpu::INC, 0x0c, AM_ABS },
-	{ &cpu::ISC, 0xff, AM_ABS },
+	{ &cpu::ISC, 0x0c, AM_ABS },
 	{ &cpu::BEQ, 0x05, AM_BRANCH },
 	{ &cpu::SBC, 0x0b, AM_ZP_Y_REL },
 	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::ISC, 0xff, AM_ZP_Y_REL },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::ISC, 0x10, AM_ZP_Y_REL },
+	{ &cpu::IGN, 0x08, AM_ZP_X },
 	{ &cpu::SBC, 0x08, AM_ZP_X },
 	{ &cpu::INC, 0x0c, AM_ZP_X },
-	{ &cpu::ISC, 0xff, AM_ZP_X },
+	{ &cpu::ISC, 0x0c, AM_ZP_X },
 	{ &cpu::SED, 0x04, AM_NON },
 	{ &cpu::SBC, 0x09, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
-	{ &cpu::ISC, 0xff, AM_ABS_Y },
-	{ &cpu::INV, 0xff, AM_NON },
+	{ &cpu::NOP, 0x04, AM_NON },
+	{ &cpu::ISC, 0x0e, AM_ABS_Y },
+	{ &cpu::IGN, 0x09, AM_ABS_X },
 	{ &cpu::SBC, 0x09, AM_ABS_X },
 	{ &cpu::INC, 0x0e, AM_ABS_X },
-	{ &cpu::ISC, 0xff, AM_ABS_X },
+	{ &cpu::ISC, 0x0e, AM_ABS_X },
 };
 
 uint16_t cpu::GetArg(AddressModes mode) {
 	uint16_t l, h;
 	switch (mode) {
 		case AM_ACC:
+			Dummy(r.PC);
 			return 0;
 
 		case AM_IMM:
 			return r.PC++;
 
 		case AM_ABS:
-			l = GetByte(r.PC++);
-			h = GetByte(r.PC++);
+			l = Rd(r.PC++);
+			h = Rd(r.PC++);
 			return l + (h << 8);
 
 		case AM_ZP:
-			return GetByte(r.PC++);
+			return Rd(r.PC++);
 
 		case AM_NON:
+			Dummy(r.PC);
 			return 0;
 
 		case AM_BRANCH:
-			return r.PC + int8_t(GetByte(r.PC++));
+			// read the offset before adding it, r.PC + Rd(r.PC++) is unsequenced and
+			// the offset is relative to the next instruction
+			l = Rd(r.PC++);
+			return r.PC + int8_t(l);
 
 		case AM_REL:
-			l = GetByte(r.PC++);
-			h = GetByte(r.PC++);
-			return GetByte((h << 8) | l) + (GetByte((h << 8) | ((l+1)&0xff))<<8);
+			l = Rd(r.PC++);
+			h = Rd(r.PC++);
+			return Rd((h << 8) | l) + (Rd((h << 8) | ((l+1)&0xff))<<8);
 
 		case AM_ZP_X:
-			return (GetByte(r.PC++) + r.X) & 0xff;
+			l = Rd(r.PC++);
+			Dummy(l);
+			return (l + r.X) & 0xff;
 
 		case AM_ZP_Y:
-			return (GetByte(r.PC++) + r.Y) & 0xff;
+			l = Rd(r.PC++);
+			Dummy(l);
+			return (l + r.Y) & 0xff;
 
 		case AM_ABS_X:
-			l = GetByte(r.PC++);
-			h = GetByte(r.PC++);
+			l = Rd(r.PC++);
+			h = Rd(r.PC++);
 			penalty = (l+r.X)>=0x100;
+			if (BusCycle) { IndexDummy(l, h, r.X); }
 			return l + (h << 8) + r.X;
 
 		case AM_ABS_Y:
-			l = GetByte(r.PC++);
-			h = GetByte(r.PC++);
+			l = Rd(r.PC++);
+			h = Rd(r.PC++);
 			penalty = (l+r.Y)>=0x100;
+			if (BusCycle) { IndexDummy(l, h, r.Y); }
 			return l + (h << 8) + r.Y;
 
 		case AM_ZP_REL_X:
-			l = (GetByte(r.PC++) + r.X) & 0xff;
+			l = Rd(r.PC++);
+			Dummy(l);
+			l = (l + r.X) & 0xff;
 			h = (l + 1) & 0xff;
-			return GetByte(l) + (GetByte(h) << 8);
+			return Rd(l) + (Rd(h) << 8);
 
 		case AM_ZP_Y_REL:
-			l = GetByte(r.PC++);
+			l = Rd(r.PC++);
 			h = (l + 1) & 0xff;
+			l = Rd(l);
+			h = Rd(h);
 			penalty = (l + r.Y) >= 0x100;
-			return GetByte(l) + (GetByte(h) << 8) + r.Y;
+			if (BusCycle) { IndexDummy(l, h, r.Y); }
+			return l + (h << 8) + r.Y;
 	}
 	return 0;
 }
@@ -498,7 +567,7 @@ Regs cpu::Reset()
 	r.A = 0;
 	r.Y = 0;
 	r.X = 0;
-	r.PC = (GetByte(addr_reset_h) << 8) + GetByte(addr_reset_l);
+	r.PC = (Rd(addr_reset_h) << 8) + Rd(addr_reset_l);
 	r.S = 0xFD;
 	r.P |= F_U;
 	r.T = 6;
@@ -507,79 +576,121 @@ Regs cpu::Reset()
 
 void cpu::Push(uint8_t byte)
 {	
-	SetByte(0x0100 + r.S, byte);
+	Wr(0x0100 + r.S, byte);
 	r.S--;
 }
 
 uint8_t cpu::Pop()
 {
 	r.S++;
-	return GetByte(0x0100 + r.S);
+	return Rd(0x0100 + r.S);
 }
 
 Regs cpu::IRQ()
 {
 	if(!ChkI()) {
+		Dummy(r.PC);
+		Dummy(r.PC);
 		ClearFlag(F_B);
 		Push((r.PC >> 8) & 0xff);
 		Push(r.PC & 0xff);
 		Push(r.P);
 		SetFlag(F_I);
-		r.PC = (GetByte(addr_irq_h) << 8) + GetByte(addr_irq_l);
+		r.PC = (Rd(addr_irq_h) << 8) + Rd(addr_irq_l);
 	}
 	return r;
 }
 
 Regs cpu::NMI()
 {
+	Dummy(r.PC);
+	Dummy(r.PC);
 	ClearFlag(F_B);
 	Push((r.PC >> 8) & 0xff);
 	Push(r.PC & 0xff);
 	Push(r.P);
 	SetFlag(F_I);
-	r.PC = (GetByte(addr_nmi_h) << 8) + GetByte(addr_nmi_l);
+	r.PC = (Rd(addr_nmi_h) << 8) + Rd(addr_nmi_l);
 	return r;
 }
 
 Regs cpu::Step()
 {
 	if (r.T != 0xff) {
-		Opcode &instruction = table[GetByte(r.PC++)];
-		(this->*instruction.code)(GetArg((AddressModes)instruction.mode));
+		Opcode &instruction = table[Rd(r.PC++)];
+		indexedRead = !!(instruction.time & 1);
+		if (BusCycle && instruction.code == &cpu::JSR)
+			JSRBus();
+		else
+			(this->*instruction.code)(GetArg((AddressModes)instruction.mode));
 		if (r.T != 0xff) {
-			r.T = instruction.time == 0xff ?
-				0xff : ((instruction.time>>1) + (penalty ? (instruction.time&1) : 0));
+			// in bus cycle mode every cycle is one access, which includes the branch page crossing cycle
+			if (BusCycle && instruction.time != 0xff)
+				r.T = busCycle;
+			else
+				r.T = instruction.time == 0xff ?
+					0xff : ((instruction.time>>1) + (penalty ? (instruction.time&1) : 0) + (branchPage ? 1 : 0));
 		}
 	}
 	return r;
 }
 
-void cpu::ADC(uint16_t arg)
+void cpu::AddA(uint8_t m)
 {
-	uint8_t m = GetByte(arg);
-	uint16_t tmp = m + r.A + (ChkC() ? 1 : 0);
+	uint16_t c = ChkC() ? 1 : 0;
+	uint16_t tmp = r.A + m + c;
 	EvlZ(tmp);
 	if (ChkD()) {
-		if (((r.A & 0xF) + (m & 0xF) + (ChkC() ? 1 : 0)) > 9)
-			tmp += 6;
+		// NMOS decimal mode, N and V come from the intermediate result
+		tmp = (r.A & 0xf) + (m & 0xf) + c;
+		if (tmp > 9) { tmp += 6; }
+		tmp = (tmp > 0xf ? ((tmp & 0xf) + 0x10) : tmp) + (r.A & 0xf0) + (m & 0xf0);
 		EvlN(tmp);
-		int16_t vr = int16_t(int8_t(r.A)) + int16_t(int8_t(m+(r.P&1)));
-		SetFlag(vr<-0x80 || vr>=0x80, F_V);
-		if (tmp > 0x99)
-			tmp += 96;
-		SetC(tmp > 0x99);
+		SetFlag(!!((r.A ^ tmp) & ~(r.A ^ m) & 0x80), F_V);
+		if ((tmp & 0x1f0) > 0x90) { tmp += 0x60; }
+		SetC((tmp & 0xff0) > 0xf0);
 	} else {
 		EvlN(tmp);
-		int16_t vr = int16_t(int8_t(r.A)) + int16_t(int8_t(m+(r.P&1)));
-		SetFlag(vr<-0x80 || vr>=0x80, F_V);
+		SetFlag(!!((r.A ^ tmp) & ~(r.A ^ m) & 0x80), F_V);
 		SetC(tmp > 0xff);
 	}
 	r.A = tmp & 0xff;
 }
 
+void cpu::SubA(uint8_t m)
+{
+	uint16_t b = ChkC() ? 0 : 1;
+	uint16_t tmp = r.A - m - b;
+	EvlN(tmp);
+	EvlZ(tmp);
+	SetFlag(!!((r.A ^ tmp) & (r.A ^ m) & 0x80), F_V);
+	SetC(tmp < 0x100);
+	if (ChkD()) {
+		// flags are the same as in binary mode on NMOS
+		uint16_t lo = (r.A & 0xf) - (m & 0xf) - b;
+		if (lo & 0x10) { tmp = ((lo - 6) & 0xf) | ((r.A & 0xf0) - (m & 0xf0) - 0x10); }
+		else { tmp = (lo & 0xf) | ((r.A & 0xf0) - (m & 0xf0)); }
+		if (tmp & 0x100) { tmp -= 0x60; }
+	}
+	r.A = tmp & 0xff;
+}
+
+void cpu::Compare(uint8_t reg, uint8_t m)
+{
+	uint16_t tmp = reg - m;
+	SetC(tmp < 0x100);
+	EvlN(tmp);
+	EvlZ(tmp);
+}
+
+void cpu::ADC(uint16_t arg)
+{
+	AddA(Rd(arg));
+}
+
 void cpu::AND(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = Rd(arg);
 	uint8_t res = m & r.A;
 	EvlN(res);
 	EvlZ(res);
@@ -588,13 +699,13 @@ void cpu::AND(uint16_t arg)
 
 void cpu::ASL(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = RdModify(arg);
 	SetC(!!(m & 0x80));
 	m <<= 1;
 	m &= 0xff;
 	EvlN(m);
 	EvlZ(m);
-	SetByte(arg, m);
+	Wr(arg, m);
 }
 
 void cpu::ASLA(uint16_t arg)
@@ -607,11 +718,22 @@ void cpu::ASLA(uint16_t arg)
 	r.A = m;
 }
 
+// taken branches read the next opcode and the unfixed address on a page crossing
+void cpu::Branch(uint16_t arg)
+{
+	Dummy(r.PC);
+	if ((r.PC ^ arg) & 0xff00) {
+		Dummy((r.PC & 0xff00) | (arg & 0xff));
+		branchPage = true;
+	}
+	r.PC = arg;
+	penalty = true;
+}
+
 void cpu::BCC(uint16_t arg)
 {
 	if (!ChkC()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
@@ -619,22 +741,20 @@ void cpu::BCC(uint16_t arg)
 void cpu::BCS(uint16_t arg)
 {
 	if (ChkC()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
 void cpu::BEQ(uint16_t arg)
 {
 	if (ChkZ()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
 void cpu::BIT(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = Rd(arg);
 	uint8_t res = m & r.A;
 	EvlN(res);
 	r.P = (r.P & 0x3F) | (uint8_t)(m & 0xC0);
@@ -644,24 +764,21 @@ void cpu::BIT(uint16_t arg)
 void cpu::BMI(uint16_t arg)
 {
 	if (ChkN()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
 void cpu::BNE(uint16_t arg)
 {
 	if (!ChkZ()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
 void cpu::BPL(uint16_t arg)
 {
 	if (!ChkN()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
@@ -672,22 +789,20 @@ void cpu::BRK(uint16_t arg)
 	Push(r.PC & 0xff);
 	Push(r.P | F_B);
 	SetFlag(F_I);
-	r.PC = (GetByte(addr_irq_h) << 8) + GetByte(addr_irq_l);
+	r.PC = (Rd(addr_irq_h) << 8) + Rd(addr_irq_l);
 }
 
 void cpu::BVC(uint16_t arg)
 {
 	if (!ChkV()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
 void cpu::BVS(uint16_t arg)
 {
 	if (ChkV()) {
-		r.PC = arg;
-		penalty = true;
+		Branch(arg);
 	}
 }
 
@@ -713,35 +828,26 @@ void cpu::CLV(uint16_t arg)
 
 void cpu::CMP(uint16_t arg)
 {
-	uint16_t tmp = r.A - GetByte(arg);
-	SetC(tmp < 0x100);
-	EvlN(tmp);
-	EvlZ(tmp);
+	Compare(r.A, Rd(arg));
 }
 
 void cpu::CPX(uint16_t arg)
 {
-	uint16_t tmp = r.X - GetByte(arg);
-	SetC(tmp < 0x100);
-	EvlN(tmp);
-	EvlZ(tmp);
+	Compare(r.X, Rd(arg));
 }
 
 void cpu::CPY(uint16_t arg)
 {
-	uint16_t tmp = r.Y - GetByte(arg);
-	SetC(tmp < 0x100);
-	EvlN(tmp);
-	EvlZ(tmp);
+	Compare(r.Y, Rd(arg));
 }
 
 void cpu::DEC(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = RdModify(arg);
 	m = (m - 1) & 0xff;
 	EvlN(m);
 	EvlZ(m);
-	SetByte(arg, m);
+	Wr(arg, m);
 }
 
 void cpu::DEX(uint16_t arg)
@@ -764,7 +870,7 @@ void cpu::DEY(uint16_t arg)
 
 void cpu::EOR(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = Rd(arg);
 	m = r.A ^ m;
 	EvlN(m);
 	EvlZ(m);
@@ -773,11 +879,11 @@ void cpu::EOR(uint16_t arg)
 
 void cpu::INC(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = RdModify(arg);
 	m = (m + 1) & 0xff;
 	EvlN(m);
 	EvlZ(m);
-	SetByte(arg, m);
+	Wr(arg, m);
 }
 
 void cpu::INX(uint16_t arg)
@@ -811,9 +917,19 @@ void cpu::JSR(uint16_t arg)
 	r.PC = arg;
 }
 
+// jsr pushes the return address before fetching the high byte of the target
+void cpu::JSRBus()
+{
+	uint16_t l = Rd(r.PC++);
+	Dummy(0x100 + r.S);
+	Push((r.PC >> 8) & 0xff);
+	Push(r.PC & 0xff);
+	r.PC = l | (uint16_t(Rd(r.PC)) << 8);
+}
+
 void cpu::LDA(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = Rd(arg);
 	EvlN(m);
 	EvlZ(m);
 	r.A = m;
@@ -821,7 +937,7 @@ void cpu::LDA(uint16_t arg)
 
 void cpu::LDX(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = Rd(arg);
 	EvlN(m);
 	EvlZ(m);
 	r.X = m;
@@ -829,7 +945,7 @@ void cpu::LDX(uint16_t arg)
 
 void cpu::LDY(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = Rd(arg);
 	EvlN(m);
 	EvlZ(m);
 	r.Y = m;
@@ -837,12 +953,12 @@ void cpu::LDY(uint16_t arg)
 
 void cpu::LSR(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = RdModify(arg);
 	SetC(m & 0x01);
 	m >>= 1;
 	ClearFlag(F_N);
 	EvlZ(m);
-	SetByte(arg, m);
+	Wr(arg, m);
 }
 
 void cpu::LSRA(uint16_t arg)
@@ -861,7 +977,7 @@ void cpu::NOP(uint16_t arg)
 
 void cpu::ORA(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
+	uint8_t m = Rd(arg);
 	m = r.A | m;
 	EvlN(m);
 	EvlZ(m);
@@ -880,6 +996,7 @@ void cpu::PHP(uint16_t arg)
 
 void cpu::PLA(uint16_t arg)
 {
+	Dummy(0x100 + r.S);
 	r.A = Pop();
 	EvlN(r.A);
 	EvlZ(r.A);
@@ -887,20 +1004,21 @@ void cpu::PLA(uint16_t arg)
 
 void cpu::PLP(uint16_t arg)
 {
+	Dummy(0x100 + r.S);
 	r.P = Pop();
 	SetFlag(F_U);
 }
 
 void cpu::ROL(uint16_t arg)
 {
-	uint16_t m = GetByte(arg);
+	uint16_t m = RdModify(arg);
 	m <<= 1;
 	if (ChkC()) m |= 0x01;
 	SetC(m > 0xff);
 	m &= 0xff;
 	EvlN(m);
 	EvlZ(m);
-	SetByte(arg, (uint8_t)m);
+	Wr(arg, (uint8_t)m);
 }
 
 void cpu::ROLA(uint16_t arg)
@@ -917,14 +1035,14 @@ void cpu::ROLA(uint16_t arg)
 
 void cpu::ROR(uint16_t arg)
 {
-	uint16_t m = GetByte(arg);
+	uint16_t m = RdModify(arg);
 	if (ChkC()) m |= 0x100;
 	SetC(m & 0x01);
 	m >>= 1;
 	m &= 0xff;
 	EvlN(m);
 	EvlZ(m);
-	SetByte(arg, (uint8_t)m);
+	Wr(arg, (uint8_t)m);
 }
 
 void cpu::RORA(uint16_t arg)
@@ -942,6 +1060,7 @@ void cpu::RORA(uint16_t arg)
 void cpu::RTI(uint16_t arg)
 {
 	uint8_t lo, hi;
+	Dummy(0x100 + r.S);
 	r.P = Pop();
 	lo = Pop();
 	hi = Pop();
@@ -951,26 +1070,16 @@ void cpu::RTI(uint16_t arg)
 void cpu::RTS(uint16_t arg)
 {
 	uint8_t lo, hi;
+	Dummy(0x100 + r.S);
 	lo = Pop();
 	hi = Pop();
-	r.PC = ((hi << 8) | lo) + 1;
+	r.PC = (hi << 8) | lo;
+	Dummy(r.PC++);
 }
 
 void cpu::SBC(uint16_t arg)
 {
-	uint8_t m = GetByte(arg);
-	uint16_t tmp = r.A - m - (ChkC() ? 0 : 1);
-	EvlN(tmp);
-	EvlZ(tmp);
-	int16_t vr = int16_t(int8_t(r.A)) - int16_t(int8_t(m-((~r.P)&1)));
-	SetFlag(vr<-0x80 || vr>=0x80, F_V);
-	if (ChkD()) {
-		if ( ((r.A & 0x0f) - (ChkC() ? 0 : 1)) < (arg & 0x0f)) tmp -= 6;
-		if (tmp > 0x99)
-			tmp -= 0x60;
-	}
-	SetC(tmp < 0x100);
-	r.A = (tmp & 0xff);
+	SubA(Rd(arg));
 }
 
 void cpu::SEC(uint16_t arg)
@@ -990,17 +1099,17 @@ void cpu::SEI(uint16_t arg)
 
 void cpu::STA(uint16_t arg)
 {
-	SetByte(arg, r.A);
+	Wr(arg, r.A);
 }
 
 void cpu::STX(uint16_t arg)
 {
-	SetByte(arg, r.X);
+	Wr(arg, r.X);
 }
 
 void cpu::STY(uint16_t arg)
 {
-	SetByte(arg, r.Y);
+	Wr(arg, r.Y);
 }
 
 void cpu::TAX(uint16_t arg)
@@ -1049,32 +1158,191 @@ void cpu::TYA(uint16_t arg)
 }
 
 
+//
+// Illegal opcodes, NMOS 6510 behavior
+//
+
+// the read-modify-write combinations use the written value instead of reading it again
+void cpu::SLO(uint16_t arg)
+{
+	ASL(arg);
+	r.A |= lastWrite;
+	EvlN(r.A);
+	EvlZ(r.A);
+}
+
+void cpu::RLA(uint16_t arg)
+{
+	ROL(arg);
+	r.A &= lastWrite;
+	EvlN(r.A);
+	EvlZ(r.A);
+}
+
+void cpu::SRE(uint16_t arg)
+{
+	LSR(arg);
+	r.A ^= lastWrite;
+	EvlN(r.A);
+	EvlZ(r.A);
+}
+
+void cpu::RRA(uint16_t arg)
+{
+	ROR(arg);
+	AddA(lastWrite);
+}
+
+void cpu::DCP(uint16_t arg)
+{
+	DEC(arg);
+	Compare(r.A, lastWrite);
+}
+
+void cpu::ISC(uint16_t arg)
+{
+	INC(arg);
+	SubA(lastWrite);
+}
+
+// nop variants with an operand still read it
+void cpu::IGN(uint16_t arg)
+{
+	Rd(arg);
+}
+
+void cpu::SAX(uint16_t arg)
+{
+	Wr(arg, r.A & r.X);
+}
+
+void cpu::LAX(uint16_t arg)
+{
+	LDA(arg);
+	r.X = r.A;
+}
+
+void cpu::ANC(uint16_t arg)
+{
+	AND(arg);
+	SetC(ChkN());
+}
+
+void cpu::ALR(uint16_t arg)
+{
+	AND(arg);
+	LSRA(arg);
+}
+
+void cpu::ARR(uint16_t arg)
+{
+	uint8_t m = r.A & Rd(arg);
+	uint8_t res = (m >> 1) | (ChkC() ? 0x80 : 0);
+	EvlN(res);
+	EvlZ(res);
+	if (ChkD()) {
+		SetFlag(!!((res ^ m) & 0x40), F_V);
+		if (((m & 0xf) + (m & 0x1)) > 5) { res = (res & 0xf0) | ((res + 6) & 0xf); }
+		SetC(((m & 0xf0) + (m & 0x10)) > 0x50);
+		if (ChkC()) { res += 0x60; }
+	} else {
+		SetC(!!(res & 0x40));
+		SetFlag(!!((res ^ (res << 1)) & 0x40), F_V);
+	}
+	r.A = res;
+}
+
+void cpu::AXS(uint16_t arg)
+{
+	uint16_t tmp = (r.A & r.X) - Rd(arg);
+	SetC(tmp < 0x100);
+	EvlN(tmp);
+	EvlZ(tmp);
+	r.X = tmp & 0xff;
+}
+
+void cpu::LAS(uint16_t arg)
+{
+	uint8_t m = Rd(arg) & r.S;
+	EvlN(m);
+	EvlZ(m);
+	r.A = r.X = r.S = m;
+}
+
+// unstable, uses the constant most commonly seen on a C64
+void cpu::LXA(uint16_t arg)
+{
+	uint8_t m = (r.A | 0xee) & Rd(arg);
+	EvlN(m);
+	EvlZ(m);
+	r.A = r.X = m;
+}
+
+void cpu::XAA(uint16_t arg)
+{
+	uint8_t m = (r.A | 0xee) & r.X & Rd(arg);
+	EvlN(m);
+	EvlZ(m);
+	r.A = m;
+}
+
+// stores value & (high byte of base address + 1), if the index
+// crossed a page the result replaces the high byte of the address
+void cpu::StoreHigh(uint16_t arg, uint8_t index, uint8_t value)
+{
+	uint16_t base = arg - index;
+	value &= (uint8_t)((base >> 8) + 1);
+	if ((base ^ arg) & 0xff00) { arg = (arg & 0xff) | (uint16_t(value) << 8); }
+	Wr(arg, value);
+}
+
+void cpu::AHX(uint16_t arg)
+{
+	StoreHigh(arg, r.Y, r.A & r.X);
+}
+
+void cpu::SHX(uint16_t arg)
+{
+	StoreHigh(arg, r.Y, r.X);
+}
+
+void cpu::SHY(uint16_t arg)
+{
+	StoreHigh(arg, r.X, r.Y);
+}
+
+void cpu::TAS(uint16_t arg)
+{
+	r.S = r.A & r.X;
+	StoreHigh(arg, r.Y, r.S);
+}
+
 //
 // External interface
 //
 
 
-Regs Step6502(const Regs &r, CBGetByte read, CBSetByte write)
+Regs Step6502(const Regs &r, CBGetByte read, CBSetByte write, void *user, CBBusCycle bus)
 {
-	cpu mos(r, read, write);
+	cpu mos(r, read, write, user, bus);
 	return mos.Step();
 }
 
-Regs IRQ6502(const Regs &r, CBGetByte read, CBSetByte write)
+Regs IRQ6502(const Regs &r, CBGetByte read, CBSetByte write, void *user, CBBusCycle bus)
 {
-	cpu mos(r, read, write);
+	cpu mos(r, read, write, user, bus);
 	return mos.IRQ();
 }
 
-Regs NMI6502(const Regs &r, CBGetByte read, CBSetByte write)
+Regs NMI6502(const Regs &r, CBGetByte read, CBSetByte write, void *user, CBBusCycle bus)
 {
-	cpu mos(r, read, write);
+	cpu mos(r, read, write, user, bus);
 	return mos.NMI();
 }
 
-Regs Reset6502(const Regs &r, CBGetByte read, CBSetByte write)
+Regs Reset6502(const Regs &r, CBGetByte read, CBSetByte write, void *user)
 {
-	cpu mos(r, read, write);
+	cpu mos(r, read, write, user);
 	return mos.Reset();
 }
 
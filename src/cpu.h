@@ -10,12 +10,10 @@
 
 #include "machine.h"
 
-// read/write callbacks
-typedef void(*CBSetByte)(uint16_t, uint8_t);
-typedef uint8_t(*CBGetByte)(uint16_t);
-
-Regs Step6502(const Regs &r, CBGetByte read, CBSetByte write);
-Regs IRQ6502(const Regs &r, CBGetByte read, CBSetByte write);
-Regs NMI6502(const Regs &r, CBGetByte read, CBSetByte write);
-Regs Reset6502(const Regs &r, CBGetByte read, CBSetByte write);
+// read/write and bus cycle callback types are declared in machine.h
 
+// with a bus callback every access is reported including dummy reads and writes, and T counts the accesses
+Regs Step6502(const Regs &r, CBGetByte read, CBSetByte write, void *user, CBBusCycle bus = nullptr);
+Regs IRQ6502(const Regs &r, CBGetByte read, CBSetByte write, void *user, CBBusCycle bus = nullptr);
+Regs NMI6502(const Regs &r, CBGetByte read, CBSetByte write, void *user, CBBusCycle bus = nullptr);
+Regs Reset6502(const Regs &r, CBGetByte read, CBSetByte write, void *user);
@@ -8,63 +8,16 @@
 #include "sym.h"
 #include "boot_ram.h"
 #include "Expressions.h"
+#include "CallGraph.h"
+#include "Trace.h"
 #include "struse/struse.h"
 #include "platform.h"
 
 #define UNDO_BUFFER_SIZE (16*1024*1024)
-#define MAX_PC_BREAKPOINTS 256
-#define CPU_EMULATOR_THREAD_STACK 8192
+#define UNDO_CHUNK_SIZE (64*1024)		// write index granularity of the undo buffer
+#define UNDO_CHUNKS (UNDO_BUFFER_SIZE / UNDO_CHUNK_SIZE)
+#define CPU_EMULATOR_THREAD_STACK 16384
 #define THREAD_CPU_CYCLES_PER_UPDATE 8000
-#define MAX_BP_CONDITIONS 4*1024
-
-uint8_t *ram = nullptr;
-uint8_t *undo = nullptr;
-uint32_t undo_oldest = UNDO_BUFFER_SIZE - 1;
-uint32_t undo_newest = 0;
-uint32_t history_max = 0;
-uint32_t history_count = 0;
-
-bool memChange = true;
-bool memChangePrev = false;
-bool sandboxContext = false;
-Regs currRegs;
-Regs prevRegs;
-uint32_t cycles;
-// if non-zero run this many instructions
-uint32_t runCount = 0;
-
-
-struct sBPCond {
-	uint16_t offs;
-	uint16_t size;
-};
-
-// in order to easily make a snapshot of breakpoints they are organized in
-// a single array of PC breakpoints, then disabled breakpoints.
-// This makes breakpoint management a little more tiptoey but
-// checking for breakpoints is trivial and linear in memory which is more
-// desired.
-
-// breakpoints
-static uint16_t aBP_PC[MAX_PC_BREAKPOINTS];	// active breakpoints
-static uint32_t aBP_ID[MAX_PC_BREAKPOINTS];	// breakpoint IDs, for visualization
-static sBPCond aBP_CN[MAX_PC_BREAKPOINTS];	// condition bytecode
-static uint8_t aBP_EX[MAX_BP_CONDITIONS];
-static uint16_t nBP = 0;					// total number of PC breakpoints
-static uint16_t nBP_PC = 0;					// number of PC breakpoints
-static uint16_t nBP_DS = 0;					// number of disabled breakpoints
-static uint16_t nBP_EX_Len = 0;
-static uint32_t nBP_NextID = 0;
-static uint16_t runTo = 0xffff;
-static uint16_t bStopCPU = 0;
-static uint16_t bCPUIRQ = 0;
-static uint16_t bCPUNMI = 0;
-
-static IBMutex mutexBP = IBMutex_Clear;
-
-
-// runs the CPU in a thread so the UI can continue
-static IBThread hThreadCPU = IBThread_Clear;
 
 static const char* aAddrModeFmt[] = {
 	"%s ($%02x,x)",			// 00
@@ -254,6 +207,7 @@ enum MNM_Base {
 	mnm_shx,
 	mnm_las,
 	mnm_sbi,
+	mnm_inop,
 
 	mnm_count
 };
@@ -387,6 +341,7 @@ const char *zsMNM[mnm_count]{
 	"shx",
 	"las",
 	"sbi",
+	"nop",	// illegal nop variants, listed after the real nop so the assembler picks $ea
 };
 
 struct dismnm {
@@ -400,7 +355,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_ora, AM_ZP_REL_X, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_slo, AM_ZP_REL_X, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP, 1 },
 	{ mnm_ora, AM_ZP, 1 },
 	{ mnm_asl, AM_ZP, 1 },
 	{ mnm_slo, AM_ZP, 1 },
@@ -408,7 +363,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_ora, AM_IMM, 1 },
 	{ mnm_asl, AM_NON, 0 },
 	{ mnm_anc, AM_IMM, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ABS, 2 },
 	{ mnm_ora, AM_ABS, 2 },
 	{ mnm_asl, AM_ABS, 2 },
 	{ mnm_slo, AM_ABS, 2 },
@@ -416,15 +371,15 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_ora, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_slo, AM_ZP_Y_REL, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP_X, 1 },
 	{ mnm_ora, AM_ZP_X, 1 },
 	{ mnm_asl, AM_ZP_X, 1 },
 	{ mnm_slo, AM_ZP_X, 1 },
 	{ mnm_clc, AM_NON, 0 },
 	{ mnm_ora, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_NON, 0 },
 	{ mnm_slo, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ABS_X, 2 },
 	{ mnm_ora, AM_ABS_X, 2 },
 	{ mnm_asl, AM_ABS_X, 2 },
 	{ mnm_slo, AM_ABS_X, 2 },
@@ -448,15 +403,15 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_and, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_rla, AM_ZP_Y_REL, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP_X, 1 },
 	{ mnm_and, AM_ZP_X, 1 },
 	{ mnm_rol, AM_ZP_X, 1 },
 	{ mnm_rla, AM_ZP_X, 1 },
 	{ mnm_sec, AM_NON, 0 },
 	{ mnm_and, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_NON, 0 },
 	{ mnm_rla, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ABS_X, 2 },
 	{ mnm_and, AM_ABS_X, 2 },
 	{ mnm_rol, AM_ABS_X, 2 },
 	{ mnm_rla, AM_ABS_X, 2 },
@@ -464,7 +419,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_eor, AM_ZP_REL_X, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_sre, AM_ZP_REL_X, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP, 1 },
 	{ mnm_eor, AM_ZP, 1 },
 	{ mnm_lsr, AM_ZP, 1 },
 	{ mnm_sre, AM_ZP, 1 },
@@ -480,15 +435,15 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_eor, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_sre, AM_ZP_Y_REL, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP_X, 1 },
 	{ mnm_eor, AM_ZP_X, 1 },
 	{ mnm_lsr, AM_ZP_X, 1 },
 	{ mnm_sre, AM_ZP_X, 1 },
 	{ mnm_cli, AM_NON, 0 },
 	{ mnm_eor, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_NON, 0 },
 	{ mnm_sre, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ABS_X, 2 },
 	{ mnm_eor, AM_ABS_X, 2 },
 	{ mnm_lsr, AM_ABS_X, 2 },
 	{ mnm_sre, AM_ABS_X, 2 },
@@ -496,7 +451,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_adc, AM_ZP_REL_X, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_rra, AM_ZP_REL_X, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP, 1 },
 	{ mnm_adc, AM_ZP, 1 },
 	{ mnm_ror, AM_ZP, 1 },
 	{ mnm_rra, AM_ZP, 1 },
@@ -512,28 +467,28 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_adc, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_rra, AM_ZP_Y_REL, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP_X, 1 },
 	{ mnm_adc, AM_ZP_X, 1 },
 	{ mnm_ror, AM_ZP_X, 1 },
 	{ mnm_rra, AM_ZP_X, 1 },
 	{ mnm_sei, AM_NON, 0 },
 	{ mnm_adc, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_NON, 0 },
 	{ mnm_rra, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ABS_X, 2 },
 	{ mnm_adc, AM_ABS_X, 2 },
 	{ mnm_ror, AM_ABS_X, 2 },
 	{ mnm_rra, AM_ABS_X, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_IMM, 1 },
 	{ mnm_sta, AM_ZP_REL_X, 1 },
-	{ mnm_inv, AM_NON, 0 },
-	{ mnm_sax, AM_ZP_REL_Y, 1 },
+	{ mnm_inop, AM_IMM, 1 },
+	{ mnm_sax, AM_ZP_REL_X, 1 },
 	{ mnm_sty, AM_ZP, 1 },
 	{ mnm_sta, AM_ZP, 1 },
 	{ mnm_stx, AM_ZP, 1 },
 	{ mnm_sax, AM_ZP, 1 },
 	{ mnm_dey, AM_NON, 0 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_IMM, 1 },
 	{ mnm_txa, AM_NON, 0 },
 	{ mnm_xaa, AM_IMM, 1 },
 	{ mnm_sty, AM_ABS, 2 },
@@ -543,7 +498,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_bcc, AM_BRANCH, 1 },
 	{ mnm_sta, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
-	{ mnm_ahx, AM_ZP_REL_Y, 1 },
+	{ mnm_ahx, AM_ZP_Y_REL, 1 },
 	{ mnm_sty, AM_ZP_X, 1 },
 	{ mnm_sta, AM_ZP_X, 1 },
 	{ mnm_stx, AM_ZP_Y, 1 },
@@ -559,7 +514,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_ldy, AM_IMM, 1 },
 	{ mnm_lda, AM_ZP_REL_X, 1 },
 	{ mnm_ldx, AM_IMM, 1 },
-	{ mnm_lax, AM_ZP_REL_Y, 1 },
+	{ mnm_lax, AM_ZP_REL_X, 1 },
 	{ mnm_ldy, AM_ZP, 1 },
 	{ mnm_lda, AM_ZP, 1 },
 	{ mnm_ldx, AM_ZP, 1 },
@@ -575,7 +530,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_bcs, AM_BRANCH, 1 },
 	{ mnm_lda, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_lax, AM_ZP_Y_REL, 1 },
 	{ mnm_ldy, AM_ZP_X, 1 },
 	{ mnm_lda, AM_ZP_X, 1 },
 	{ mnm_ldx, AM_ZP_Y, 1 },
@@ -590,7 +545,7 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_lax, AM_ABS_Y, 2 },
 	{ mnm_cpy, AM_IMM, 1 },
 	{ mnm_cmp, AM_ZP_REL_X, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_IMM, 1 },
 	{ mnm_dcp, AM_ZP_REL_X, 1 },
 	{ mnm_cpy, AM_ZP, 1 },
 	{ mnm_cmp, AM_ZP, 1 },
@@ -608,21 +563,21 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_cmp, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_dcp, AM_ZP_Y_REL, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP_X, 1 },
 	{ mnm_cmp, AM_ZP_X, 1 },
 	{ mnm_dec, AM_ZP_X, 1 },
 	{ mnm_dcp, AM_ZP_X, 1 },
 	{ mnm_cld, AM_NON, 0 },
 	{ mnm_cmp, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_NON, 0 },
 	{ mnm_dcp, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ABS_X, 2 },
 	{ mnm_cmp, AM_ABS_X, 2 },
 	{ mnm_dec, AM_ABS_X, 2 },
 	{ mnm_dcp, AM_ABS_X, 2 },
 	{ mnm_cpx, AM_IMM, 1 },
 	{ mnm_sbc, AM_ZP_REL_X, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_IMM, 1 },
 	{ mnm_isc, AM_ZP_REL_X, 1 },
 	{ mnm_cpx, AM_ZP, 1 },
 	{ mnm_sbc, AM_ZP, 1 },
@@ -640,29 +595,98 @@ struct dismnm a6502_ops[256] = {
 	{ mnm_sbc, AM_ZP_Y_REL, 1 },
 	{ mnm_inv, AM_NON, 0 },
 	{ mnm_isc, AM_ZP_Y_REL, 1 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ZP_X, 1 },
 	{ mnm_sbc, AM_ZP_X, 1 },
 	{ mnm_inc, AM_ZP_X, 1 },
 	{ mnm_isc, AM_ZP_X, 1 },
 	{ mnm_sed, AM_NON, 0 },
 	{ mnm_sbc, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_NON, 0 },
 	{ mnm_isc, AM_ABS_Y, 2 },
-	{ mnm_inv, AM_NON, 0 },
+	{ mnm_inop, AM_ABS_X, 2 },
 	{ mnm_sbc, AM_ABS_X, 2 },
 	{ mnm_inc, AM_ABS_X, 2 },
 	{ mnm_isc, AM_ABS_X, 2 },
 };
 
-uint8_t Get6502Byte(uint16_t addr);
-void Set6502Byte(uint16_t addr, uint8_t value);
-void Set6502ByteRecord(uint16_t addr, uint8_t value);
+static Machine sMachine;
+
+Machine& GetMachine()
+{
+	return sMachine;
+}
+
+Machine::Machine()
+{
+	ram = nullptr;
+	memset(pages, 0, sizeof(pages));
+	memset(pageShare, 0, sizeof(pageShare));
+	memset(pageWriteGen, 0, sizeof(pageWriteGen));
+	writeGen = 0;
+	parent = nullptr;
+	undo = nullptr;
+	undoChunks = nullptr;
+	memset(&undoTail, 0, sizeof(UndoChunk));
+	undoChunk = 0;
+	undo_oldest = UNDO_BUFFER_SIZE - 1;
+	undo_newest = 0;
+	history_max = 0;
+	history_count = 0;
+	primary = false;
+	memChange = true;
+	memChangePrev = false;
+	sandboxContext = false;
+	cycles = 0;
+	runCount = 0;
+	nBP = 0;
+	nBP_DS = 0;
+	nBP_EX_Len = 0;
+	nBP_NextID = 0;
+	nTP = 0;
+	tpVersion = 0;
+	memset(tpPCs, 0, sizeof(tpPCs));
+	memset(runTPPCs, 0, sizeof(runTPPCs));
+	traceLog = nullptr;
+	traceLogHead = 0;
+	traceLogTail = 0;
+	traceLogDropped = 0;
+	runTo = 0xffff;
+	bStopCPU = 0;
+	bCPUIRQ = 0;
+	bCPUNMI = 0;
+	hThreadCPU = IBThread_Clear;
+	heat = nullptr;
+	heatEnabled = false;
+	heatCycle = 0;
+	heatPC = 0;
+	heatLen = 0;
+	instWriteAddr = 0;
+	instWriteValue = 0;
+	instWrote = false;
+	busCycleMode = false;
+	busHook = nullptr;
+	busHookUser = nullptr;
+	busLogCount = 0;
+	busBase = 0;
+}
 
+Machine::~Machine()
+{
+	Shutdown();
+}
 
-void Initialize6502()
+bool Machine::Initialize(bool primaryMachine)
 {
+	primary = primaryMachine;
 	ram = (uint8_t*)calloc(64, 1024);
-	//int GetBlocks6502(struct block6502 **ppBlocks);
+	if (!ram || !AllocUndo()) {
+		free(ram);
+		ram = nullptr;
+		return false;
+	}
+	for (int p = 0; p < 256; p++)
+		pages[p] = ram + (p << 8);
+
 	struct block6502* pBlx;
 	int memBlocks = GetBlocks6502(&pBlx);
 	for (int b = 0; b < memBlocks; b++)
@@ -671,92 +695,247 @@ void Initialize6502()
 
 	memChange = true;
 
-	undo = (uint8_t*)malloc(UNDO_BUFFER_SIZE);
-	undo_oldest = UNDO_BUFFER_SIZE - 1;
-	undo_newest = 0;
-	history_max = 0;
-	history_count = 0;
-	if (undo) {
-		undo[0] = 0;
-		undo[UNDO_BUFFER_SIZE - 1] = 0;
-	}
 	IBMutexInit(&mutexBP, "6502 Context");
+	IBMutexInit(&mutexFork, "6502 Fork");
 
-	currRegs = Reset6502(currRegs, Get6502Byte, Set6502Byte);
+	currRegs = Reset6502(currRegs, GetByteCB, SetByteCB, this);
 
 	sandboxContext = true;
+	return true;
 }
 
-void Shutdown6502()
+void Machine::Shutdown()
 {
-	if (hThreadCPU) {
-		CPUStop();
-		while (hThreadCPU)
+	if (IsRunning()) {
+		Stop();
+		while (IsRunning())
 			Sleep(1);
 	}
 
+	if (!undo) { return; }
+
+	while (forks.size())
+		DiscardFork(forks.back());
+
+	if (parent) {
+		// hand shared pages back and free the copied pages
+		IBMutexLock(&parent->mutexFork);
+		for (int p = 0; p < 256; p++) {
+			if (pageShare[p]) { --parent->pageShare[p]; }
+			else { free(pages[p]); }
+			pages[p] = nullptr;
+			pageShare[p] = 0;
+		}
+		IBMutexRelease(&parent->mutexFork);
+		parent = nullptr;
+	}
+
 	IBMutexDestroy(&mutexBP);
+	IBMutexDestroy(&mutexFork);
 
 	free(ram);
 	free(undo);
+	free(undoChunks);
+	free(heat);
+	free(traceLog);
+	ram = nullptr;
+	traceLog = nullptr;
+	nTP = 0;
+	undoChunks = nullptr;
+	memset(pages, 0, sizeof(pages));
+	undo = nullptr;
+	heat = nullptr;
+	heatEnabled = false;
+	if (primary) {
+		ShutdownCallGraph();
+		StopTrace();
+	}
 }
 
-void ResetUndoBuffer()
+Machine* Machine::Fork()
 {
-	undo_oldest = UNDO_BUFFER_SIZE - 1;
-	undo_newest = 0;
-	history_max = 0;
-	history_count = 0;
-	undo[0] = 0;
+	// memory can't be shared while it is changing, forks can not be forked
+	if (IsRunning() || !undo || parent)
+		return nullptr;
+
+	Machine *fork = new Machine;
+	if (!fork->AllocUndo()) {
+		delete fork;
+		return nullptr;
+	}
+	IBMutexInit(&fork->mutexBP, "6502 Fork Context");
+	IBMutexInit(&fork->mutexFork, "6502 Fork");
+
+	IBMutexLock(&mutexFork);
+	for (int p = 0; p < 256; p++) {
+		fork->pages[p] = pages[p];
+		fork->pageShare[p] = 1;
+		++pageShare[p];
+	}
+	IBMutexRelease(&mutexFork);
+	fork->parent = this;
+
+	fork->currRegs = fork->prevRegs = currRegs;
+	fork->cycles = cycles;
+	fork->sandboxContext = true;
+	fork->busCycleMode = busCycleMode;
+
+	IBMutexLock(&mutexBP);
+	memcpy(fork->aBP_PC, aBP_PC, sizeof(aBP_PC));
+	memcpy(fork->aBP_ID, aBP_ID, sizeof(aBP_ID));
+	memcpy(fork->aBP_CN, aBP_CN, sizeof(aBP_CN));
+	memcpy(fork->aBP_EX, aBP_EX, nBP_EX_Len);
+	fork->nBP = nBP;
+	fork->nBP_DS = nBP_DS;
+	fork->nBP_EX_Len = nBP_EX_Len;
+	fork->nBP_NextID = nBP_NextID;
+	IBMutexRelease(&mutexBP);
+
+	forks.push_back(fork);
+	return fork;
 }
 
-void CheckRegChange()
+// a running parent walks its forks on writes to shared pages, so like
+// Fork() this is refused until the parent stops
+bool Machine::DiscardFork(Machine *fork)
 {
-	bool curr = memChange;
-	if (prevRegs != currRegs) {
-		prevRegs = currRegs;
-		memChange = true;
+	if (IsRunning())
+		return false;
+	for (size_t f = 0, n = forks.size(); f < n; ++f) {
+		if (forks[f] == fork) {
+			forks.erase(forks.begin() + f);
+			delete fork;	// shutdown returns the shared pages
+			return true;
+		}
 	}
-	if (memChangePrev) { memChange = true; }
-	memChangePrev = curr;
+	return false;
 }
 
-Regs& GetRegs()
+int Machine::GetPrivatePages() const
 {
-	return currRegs;
+	int count = 0;
+	if (parent) {
+		for (int p = 0; p < 256; p++) {
+			if (!pageShare[p]) { ++count; }
+		}
+	}
+	return count;
 }
 
-void SetRegs(const Regs &r)
+// a fork copies a page from its parent before writing to it
+void Machine::CopySharedPage(uint8_t page)
 {
-	currRegs = r;
+	uint8_t *copy = (uint8_t*)malloc(256);
+	if (!copy)
+		return;
+	IBMutexLock(&parent->mutexFork);
+	if (pageShare[page]) {
+		memcpy(copy, pages[page], 256);
+		pages[page] = copy;
+		pageShare[page] = 0;
+		--parent->pageShare[page];
+		copy = nullptr;
+	}
+	IBMutexRelease(&parent->mutexFork);
+	free(copy);
 }
 
-uint32_t GetCycles()
+// called before writing to a page that is shared, a fork takes a copy of
+// the page from its parent and a parent hands its forks a copy so they
+// keep seeing the memory as it was when forked
+void Machine::UnsharePage(uint8_t page)
 {
-	return cycles;
+	if (parent) {
+		CopySharedPage(page);
+		return;
+	}
+
+	// a running fork reads the page without locking so it has to stop first
+	for (size_t f = 0, n = forks.size(); f < n; ++f) {
+		Machine *fork = forks[f];
+		if (fork->pageShare[page]) {
+			if (fork->IsRunning()) {
+				fork->Stop();
+				while (fork->IsRunning())
+					Sleep(1);
+			}
+			fork->CopySharedPage(page);
+		}
+	}
 }
 
-uint8_t *Get6502Mem(uint16_t addr)
+bool Machine::AllocUndo()
 {
-	return ram + addr;
+	undo = (uint8_t*)malloc(UNDO_BUFFER_SIZE);
+	undoChunks = (UndoChunk*)malloc(UNDO_CHUNKS * sizeof(UndoChunk));
+	if (!undo || !undoChunks) {
+		free(undo);
+		free(undoChunks);
+		undo = nullptr;
+		undoChunks = nullptr;
+		return false;
+	}
+	undo[UNDO_BUFFER_SIZE - 1] = 0;
+	ResetUndoBuffer();
+	return true;
 }
 
-bool IsSandboxContext() { return sandboxContext; }
+void Machine::ResetUndoBuffer()
+{
+	undo_oldest = UNDO_BUFFER_SIZE - 1;
+	undo_newest = 0;
+	history_max = 0;
+	history_count = 0;
+	undo[0] = 0;
+	memset(undoChunks, 0, UNDO_CHUNKS * sizeof(UndoChunk));
+	memset(&undoTail, 0, sizeof(UndoChunk));
+	undoChunk = 0;
+}
 
-void SetSandboxContext(bool set) { sandboxContext = set; }
+void Machine::CheckRegChange()
+{
+	bool curr = memChange;
+	if (prevRegs != currRegs) {
+		prevRegs = currRegs;
+		memChange = true;
+	}
+	if (memChangePrev) { memChange = true; }
+	memChangePrev = curr;
+}
 
-uint8_t Get6502Byte(uint16_t addr)
+void Machine::SetByte(uint16_t addr, uint8_t value)
 {
-	return ram[addr];
+	uint8_t &mem = WriteRef(addr);
+	if (mem != value) { memChange = true; }
+	mem = value;
 }
 
-void Set6502Byte(uint16_t addr, uint8_t value)
+// writes the bytes that differ as undo records, a record counts its writes in
+// a byte so larger patches take several records that each step back on their own
+uint32_t Machine::PatchMemory(uint16_t addr, const uint8_t *data, uint32_t size)
 {
-	if (ram[addr] != value) { memChange = true; }
-	ram[addr] = value;
+	if (IsRunning() || !undo)
+		return 0;
+
+	uint32_t changed = 0, inRecord = 0;
+	for (uint32_t b = 0; b < size && (addr + b) < 0x10000; ++b) {
+		uint16_t a = uint16_t(addr + b);
+		if (GetByte(a) == data[b])
+			continue;
+		if (!inRecord) {
+			AddUndoRegs(currRegs);
+			currRegs.T = 0;	// stepping back over the patch does not take cycles
+			++history_count;
+			if (history_count > history_max) { history_max = history_count; }
+		}
+		SetByteRecordCB(a, data[b], this);
+		if (++inRecord == 254) { inRecord = 0; }
+		++changed;
+	}
+	return changed;
 }
 
-void PushUndoByte(uint8_t b)
+void Machine::PushUndoByte(uint8_t b)
 {
 	undo[undo_newest] = b;
 	uint32_t p = undo_newest;
@@ -767,17 +946,23 @@ void PushUndoByte(uint8_t b)
 		undo_oldest = undo_newest;
 }
 
-bool HaveUndoStep()
+uint8_t Machine::UndoAt(uint32_t pos) const
 {
-	if (undo[undo_newest]) {
-		uint32_t size = sizeof(Regs) + 3 * (undo[undo_newest] - 1);
-		uint32_t buf = (undo_newest - undo_oldest) % UNDO_BUFFER_SIZE;
+	return undo[pos % UNDO_BUFFER_SIZE];
+}
+
+// pos is the count byte at the end of an undo record
+bool Machine::HaveUndoRecord(uint32_t pos) const
+{
+	if (undo[pos]) {
+		uint32_t size = sizeof(Regs) + 3 * (undo[pos] - 1);
+		uint32_t buf = (pos - undo_oldest) % UNDO_BUFFER_SIZE;
 		return !buf || size <= buf;
 	}
 	return false;
 }
 
-uint8_t PopUndoByte()
+uint8_t Machine::PopUndoByte()
 {
 	if (undo_newest)
 		undo_newest--;
@@ -786,75 +971,316 @@ uint8_t PopUndoByte()
 	return undo[undo_newest];
 }
 
-void Set6502ByteRecord(uint16_t addr, uint8_t value)
+uint8_t Machine::GetByteCB(uint16_t addr, void *user)
 {
-	if (ram[addr] != value) {
-		uint8_t changes = undo[undo_newest];
-		PushUndoByte(ram[addr]);
-		PushUndoByte((uint8_t)(addr >> 8));
-		PushUndoByte((uint8_t)addr);
-		undo[undo_newest] = changes + 1;
-		ram[addr] = value;
-		memChange = true;
+	return ((Machine*)user)->GetByte(addr);
+}
+
+void Machine::SetByteCB(uint16_t addr, uint8_t value, void *user)
+{
+	((Machine*)user)->SetByte(addr, value);
+}
+
+void Machine::SetByteRecordCB(uint16_t addr, uint8_t value, void *user)
+{
+	Machine *m = (Machine*)user;
+	if (m->GetByte(addr) != value) {
+		uint8_t &mem = m->WriteRef(addr);
+		uint8_t changes = m->undo[m->undo_newest];
+		m->PushUndoByte(mem);
+		m->PushUndoByte((uint8_t)(addr >> 8));
+		m->PushUndoByte((uint8_t)addr);
+		m->undo[m->undo_newest] = changes + 1;
+		m->undoChunks[m->undoChunk].pages[addr >> 14] |= 1ULL << ((addr >> 8) & 63);
+		mem = value;
+		m->memChange = true;
+	}
+}
+
+inline void Machine::HeatTouch(uint16_t addr, int type)
+{
+	HeatCell &h = heat[addr];
+	uint32_t halves = (heatCycle - h.last[type]) / HEAT_DECAY_CYCLES;
+	uint32_t count = halves < 16 ? (h.count[type] >> halves) : 0;
+	h.count[type] = count < 0xffff ? uint16_t(count + 1) : 0xffff;
+	h.last[type] = heatCycle;
+	h.touched |= 1 << type;
+}
+
+inline void Machine::HeatInstruction(uint16_t pc, uint32_t cycle)
+{
+	heatCycle = cycle;
+	heatPC = pc;
+	const dismnm &op = a6502_ops[GetByte(pc)];
+	heatLen = op.mnemonic == mnm_inv ? 1 : (op.arg_size + 1);
+}
+
+// instrumented memory access for the heatmap and trace recording
+uint8_t Machine::GetByteInstCB(uint16_t addr, void *user)
+{
+	Machine *m = (Machine*)user;
+	if (m->heatEnabled) { m->HeatTouch(addr, uint16_t(addr - m->heatPC) < m->heatLen ? HEAT_EXEC : HEAT_READ); }
+	return m->GetByte(addr);
+}
+
+void Machine::SetByteRecordInstCB(uint16_t addr, uint8_t value, void *user)
+{
+	Machine *m = (Machine*)user;
+	if (m->heatEnabled) { m->HeatTouch(addr, HEAT_WRITE); }
+	m->instWriteAddr = addr;
+	m->instWriteValue = value;
+	m->instWrote = true;
+	SetByteRecordCB(addr, value, user);
+}
+
+void Machine::BusCycleCB(uint16_t addr, uint8_t value, uint8_t cycle, uint8_t access, void *user)
+{
+	Machine *m = (Machine*)user;
+	if (m->busLogCount < BUS_CYCLES_MAX) {
+		BusCycle &bus = m->busLog[m->busLogCount++];
+		bus.cycle = m->busBase + cycle;
+		bus.addr = addr;
+		bus.value = value;
+		bus.access = access;
+		if (m->busHook) { m->busHook(bus, m->busHookUser); }
+	}
+}
+
+// starts logging the accesses of one instruction or interrupt
+CBBusCycle Machine::BusCycleStart(uint32_t cycle)
+{
+	busLogCount = 0;
+	busBase = cycle;
+	return BusCycleCB;
+}
+
+void Machine::SetBusCycleMode(bool enable)
+{
+	busCycleMode = enable;
+	busLogCount = 0;
+}
+
+void Machine::SetBusCycleHook(BusCycleHook hook, void *user)
+{
+	busHook = hook;
+	busHookUser = user;
+}
+
+int Machine::GetLastBusCycles(const BusCycle **bus) const
+{
+	*bus = busLog;
+	return busLogCount;
+}
+
+// the default callbacks are used unless a feature needs to observe memory access
+void Machine::SelectMemAccess(bool heatRun, bool traceRun, CBGetByte &getByte, CBSetByte &setByte)
+{
+	getByte = heatRun ? GetByteInstCB : GetByteCB;
+	setByte = (heatRun || traceRun) ? SetByteRecordInstCB : SetByteRecordCB;
+}
+
+// effective address of a memory operand, memory must not have been written since
+// the instruction executed for indirect modes to resolve the same address
+bool Machine::EffectiveAddress(const Regs &r, uint16_t &addr) const
+{
+	uint8_t op = GetByte(r.PC);
+	uint8_t zp = GetByte(uint16_t(r.PC + 1));
+	uint16_t abs = zp | (uint16_t(GetByte(uint16_t(r.PC + 2))) << 8);
+	switch (a6502_ops[op].addrMode) {
+		case AM_ZP_REL_X: {
+			uint8_t z = zp + r.X;
+			addr = GetByte(z) | (uint16_t(GetByte(uint8_t(z + 1))) << 8);
+			return true;
+		}
+		case AM_ZP: addr = zp; return true;
+		case AM_ABS: addr = abs; return op != 0x20 && op != 0x4c;	// jsr and jmp don't access the address
+		case AM_ZP_Y_REL: addr = uint16_t((GetByte(zp) | (uint16_t(GetByte(uint8_t(zp + 1))) << 8)) + r.Y); return true;
+		case AM_ZP_X: addr = uint8_t(zp + r.X); return true;
+		case AM_ZP_Y: addr = uint8_t(zp + r.Y); return true;
+		case AM_ABS_Y: addr = uint16_t(abs + r.Y); return true;
+		case AM_ABS_X: addr = uint16_t(abs + r.X); return true;
+		case AM_REL: addr = abs; return true;	// jmp (ind) reads the vector
 	}
+	return false;
+}
+
+void Machine::TraceStep(const Regs &before, uint8_t op, uint32_t cycle)
+{
+	uint16_t addr = 0;
+	uint8_t value = 0, flags = 0;
+	if (instWrote) {
+		addr = instWriteAddr;
+		value = instWriteValue;
+		flags = TRF_Addr | TRF_Write;
+		instWrote = false;
+	} else if (EffectiveAddress(before, addr)) {
+		value = GetByte(addr);
+		flags = TRF_Addr;
+	}
+	TraceInstruction(before, op, cycle, addr, value, flags);
 }
 
-void CPUAddUndoRegs(Regs &regs)
+void Machine::EnableHeatmap(bool enable)
+{
+	if (enable && !heat) {
+		heat = (HeatCell*)calloc(0x10000, sizeof(HeatCell));
+		if (!heat) { return; }
+	}
+	heatEnabled = enable;
+}
+
+void Machine::ClearHeatmap()
+{
+	if (heat) { memset(heat, 0, 0x10000 * sizeof(HeatCell)); }
+}
+
+uint32_t Machine::GetHeatAge(uint16_t addr, HeatAccess type) const
+{
+	if (!heat || !(heat[addr].touched & (1 << type))) { return HEAT_NEVER; }
+	return cycles - heat[addr].last[type];
+}
+
+uint32_t Machine::GetHeatCount(uint16_t addr, HeatAccess type) const
+{
+	uint32_t age = GetHeatAge(addr, type);
+	if (age == HEAT_NEVER) { return 0; }
+	uint32_t halves = age / HEAT_DECAY_CYCLES;
+	return halves < 16 ? (heat[addr].count[type] >> halves) : 0;
+}
+
+void Machine::AddUndoRegs(Regs &regs)
 {
 	// undo[undo_newest] contains the byte size of the state change for the previous byte
+	uint32_t prev = undo_newest;
 	undo_newest = (undo_newest + 1) % UNDO_BUFFER_SIZE;
+
+	// the record is indexed by the chunk it starts in, a chunk that is
+	// entered again after the buffer wrapped starts over and its older
+	// records are the tail until they are overwritten
+	uint32_t chunk = undo_newest / UNDO_CHUNK_SIZE;
+	if (chunk != undoChunk || !undoChunks[chunk].records) {
+		if (chunk != undoChunk && undoChunks[chunk].records)
+			undoTail = undoChunks[chunk];
+		memset(&undoChunks[chunk], 0, sizeof(UndoChunk));
+		undoChunks[chunk].first = prev;
+		undoChunk = chunk;
+	}
+	++undoChunks[chunk].records;
+
 	for (size_t c = 0; c < sizeof(Regs); c++)
 		PushUndoByte(((uint8_t*)&regs)[c]);
 	undo[undo_newest] = 1;	// stored regs
 }
 
-void CPUStepInt()
+void Machine::StepInt()
 {
-	CPUAddUndoRegs(currRegs);
-	currRegs = Step6502(currRegs, Get6502Byte, Set6502ByteRecord);
-	if (currRegs.T != 0xff)
+	AddUndoRegs(currRegs);
+	Regs before = currRegs;
+	uint8_t op = GetByte(currRegs.PC);
+	bool traceRun = primary && IsTraceRecording();
+	CBBusCycle bus = busCycleMode ? BusCycleStart(cycles) : nullptr;
+	if (heatEnabled || traceRun) {
+		CBGetByte getByte;
+		CBSetByte setByte;
+		SelectMemAccess(heatEnabled, traceRun, getByte, setByte);
+		HeatInstruction(currRegs.PC, cycles);
+		instWrote = false;
+		currRegs = Step6502(currRegs, getByte, setByte, this, bus);
+	} else
+		currRegs = Step6502(currRegs, GetByteCB, SetByteRecordCB, this, bus);
+	if (currRegs.T != 0xff) {
+		if (traceRun) { TraceStep(before, op, cycles); }
 		cycles += currRegs.T;
+		if (primary && IsCallGraphEnabled()) { CallGraphStep(op, before, currRegs, cycles); }
+		if (nTP && TracepointPC(tpPCs, currRegs.PC)) { HitTracepoints(currRegs, cycles, aTP, nTP); }
+	}
 	++history_count;
 	if (history_count > history_max) { history_max = history_count; }
 	if (runCount) { --runCount; }
 }
 
-void CPUGoThread();
-void CPUReverseThread();
+bool Machine::CheckPCBreakpoint(const Regs &regs, uint16_t num, const uint16_t *cmp, const BPCond *cond, const uint8_t *expr,
+								CBGetByte read, void *user)
+{
+	for (uint16_t b = 0; b < num; b++) {
+		if (cmp[b] == regs.PC)
+			return !cond[b].size || (read ? EvalExpression(expr + cond[b].offs, regs, read, user) :
+									 EvalExpression(expr + cond[b].offs, regs, GetByteCB, this));
+	}
+	return false;
+}
 
-bool CheckPCBreakpoint(uint16_t addr, const uint16_t num = nBP, const uint16_t *cmp = aBP_PC,
-					   const struct sBPCond *cond = aBP_CN, const uint8_t *expr = aBP_EX)
+// forward execution counts the hits of a breakpoint, slot is set if it stops the cpu
+bool Machine::HitPCBreakpoint(const Regs &regs, uint16_t num, const uint16_t *cmp, BPCond *cond, const uint8_t *expr, uint16_t &slot)
 {
 	for (uint16_t b = 0; b < num; b++) {
-		if (cmp[b] == addr)
-			return !cond[b].size || EvalExpression(expr + cond[b].offs);
+		if (cmp[b] == regs.PC) {
+			BPCond &c = cond[b];
+			if (c.size && !EvalExpression(expr + c.offs, regs, GetByteCB, this))
+				return false;
+			uint32_t hit = ++c.hits;
+			if (hit <= c.ignoreTo || (c.every > 1 && (hit - c.ignoreTo) % c.every))
+				return false;
+			slot = b;
+			return true;
+		}
 	}
 	return false;
 }
 
-void CPUStepOver()
+bool Machine::HitPCBreakpoint(const Regs &regs)
+{
+	uint16_t slot;
+	if (!HitPCBreakpoint(regs, nBP, aBP_PC, aBP_CN, aBP_EX, slot))
+		return false;
+	if (aBP_CN[slot].temporary)
+		RemoveBreakpointByID(aBP_ID[slot]);
+	return true;
+}
+
+// hits the run thread counted since its copy go back to the breakpoints by id, slots may
+// have moved and the counts may have been reset in the meantime
+void Machine::PublishBPHits(const uint32_t *ids, const BPCond *cond, const uint32_t *copied, uint16_t num)
+{
+	uint16_t nBP_T = nBP + nBP_DS;
+	for (uint16_t b = 0; b < num; b++) {
+		uint32_t added = cond[b].hits - copied[b];
+		if (b < nBP_T && aBP_ID[b] == ids[b]) {
+			aBP_CN[b].hits += added;
+			continue;
+		}
+		for (uint16_t s = 0; s < nBP_T; s++) {
+			if (aBP_ID[s] == ids[b]) {
+				aBP_CN[s].hits += added;
+				break;
+			}
+		}
+	}
+}
+
+void Machine::StepOver()
 {
 	// can not step while CPU is running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
-	if (Get6502Byte(currRegs.PC) == 0x20) {
+	if (GetByte(currRegs.PC) == 0x20) {
 		uint16_t ret = currRegs.PC + 3;
 		uint32_t c = cycles;
 		do {
-			CPUStepInt();
-		} while (currRegs.PC != ret && (cycles - c) < 64 && !CheckPCBreakpoint(currRegs.PC));
+			StepInt();
+		} while (currRegs.PC != ret && (cycles - c) < 64 && !HitPCBreakpoint(currRegs));
 		if (currRegs.PC != ret) {
 			runTo = ret;
-			CPUGoThread();
+			GoThread();
 		}
 	} else
-		CPUStepInt();
+		StepInt();
 
 }
 
-bool CPUStepBackInt(Regs &regs, uint32_t &stepCycles)
+bool Machine::StepBackInt(Regs &regs, uint32_t &stepCycles)
 {
 	if (HaveUndoStep()) {
 		if (uint32_t stored = undo[undo_newest]) { // 0 means at end of buffer
@@ -869,13 +1295,27 @@ bool CPUStepBackInt(Regs &regs, uint32_t &stepCycles)
 				for (int i = 0; i < 3; i++)
 					change[i] = PopUndoByte();
 				uint16_t addr = (uint16_t(change[1]) << 8) + change[0];
-				if (ram[addr] != change[2]) { memChange = true; }
-				ram[addr] = change[2];
+				if (GetByte(addr) != change[2]) {
+					WriteRef(addr) = change[2];
+					memChange = true;
+				}
 			}
 
 			for (size_t c = 0; c < sizeof(Regs); c++)
 				((uint8_t*)&regs)[sizeof(Regs) - 1 - c] = PopUndoByte();
 			PopUndoByte();
+
+			// pages written stay marked until the chunk is empty, stepping
+			// back into the chunk holding the tail makes it the chunk again
+			UndoChunk &chunk = undoChunks[undoChunk];
+			if (chunk.records && !--chunk.records) {
+				memset(&chunk, 0, sizeof(UndoChunk));
+				undoChunk = (undoChunk + UNDO_CHUNKS - 1) % UNDO_CHUNKS;
+				if (!undoChunks[undoChunk].records && undoTail.records) {
+					undoChunks[undoChunk] = undoTail;
+					memset(&undoTail, 0, sizeof(UndoChunk));
+				}
+			}
 			return true;
 		}
 	}
@@ -883,204 +1323,424 @@ bool CPUStepBackInt(Regs &regs, uint32_t &stepCycles)
 	return false;
 }
 
-bool CPUStepBack()
+// walks the undo records newest first, only looking into chunks that wrote to the page of addr
+int Machine::FindWrites(uint16_t addr, UndoWrite *writes, int maxWrites) const
+{
+	if (IsRunning() || !undo)
+		return 0;
+
+	int found = 0;
+	uint32_t steps = 0;
+	uint8_t after = GetByte(addr);
+	uint64_t pageBit = 1ULL << ((addr >> 8) & 63);
+	uint32_t end = undo_newest;
+	uint32_t c = undoChunk;
+	for (uint32_t n = 0; n <= UNDO_CHUNKS && found < maxWrites; ++n) {
+		// the tail comes after the oldest chunk, which is the chunk it was left in
+		bool tail = n == UNDO_CHUNKS || !undoChunks[c].records;
+		const UndoChunk &chunk = tail ? undoTail : undoChunks[c];
+		if (!chunk.records)
+			break;
+		if (chunk.pages[addr >> 14] & pageBit) {
+			uint32_t pos = end, s = steps;
+			while (pos != chunk.first && found < maxWrites && HaveUndoRecord(pos)) {
+				uint32_t count = undo[pos];
+				bool hit = false;
+				uint8_t before = 0;
+				for (uint32_t w = 1; w < count; ++w) {
+					uint32_t change = pos + UNDO_BUFFER_SIZE - 3 * w;
+					uint16_t a = UndoAt(change + 2) | (uint16_t(UndoAt(change + 1)) << 8);
+					if (a == addr) {
+						before = UndoAt(change);	// the earliest change within the instruction is found last
+						hit = true;
+					}
+				}
+				uint32_t regsPos = (pos + UNDO_BUFFER_SIZE - 3 * (count - 1) - sizeof(Regs)) % UNDO_BUFFER_SIZE;
+				++s;
+				if (hit) {
+					Regs r;
+					for (size_t b = 0; b < sizeof(Regs); ++b)
+						((uint8_t*)&r)[b] = UndoAt(uint32_t(regsPos + b));
+					UndoWrite &write = writes[found++];
+					write.stepsBack = s;
+					write.pc = r.PC;
+					write.before = before;
+					write.after = after;
+					after = before;
+				}
+				pos = (regsPos + UNDO_BUFFER_SIZE - 1) % UNDO_BUFFER_SIZE;
+			}
+			if (pos != chunk.first)
+				break;	// reached the oldest record
+		}
+		if (tail)
+			break;
+		steps += chunk.records;
+		end = chunk.first;
+		c = (c + UNDO_CHUNKS - 1) % UNDO_CHUNKS;
+	}
+	return found;
+}
+
+// memory as it was at an earlier state, bytes written since come from the undo records
+struct PastMemory {
+	Machine *machine;
+	uint8_t value[0x10000];
+	uint8_t known[0x10000 / 8];
+};
+
+static uint8_t PastByteCB(uint16_t addr, void *user)
+{
+	PastMemory *past = (PastMemory*)user;
+	if (past->known[addr >> 3] & (1 << (addr & 7)))
+		return past->value[addr];
+	return past->machine->GetByte(addr);
+}
+
+// scans the undo records newest first without restoring anything, only a
+// write range can skip chunks that did not touch its pages
+uint32_t Machine::FindReverseStop(const ReverseStop &stop)
+{
+	if (IsRunning() || !undo)
+		return 0;
+
+	uint16_t lo = stop.start < stop.end ? stop.start : stop.end;
+	uint16_t hi = stop.start < stop.end ? stop.end : stop.start;
+	uint64_t mask[4] = {};
+	for (uint32_t p = lo >> 8; p <= uint32_t(hi >> 8); ++p)
+		mask[p >> 6] |= 1ULL << (p & 63);
+
+	bool breakpoints = stop.breakpoints && nBP;
+	bool scanAll = stop.cond || breakpoints;
+	PastMemory *past = nullptr;
+	if (stop.cond || (breakpoints && nBP_EX_Len)) {
+		past = (PastMemory*)malloc(sizeof(PastMemory));
+		if (!past)
+			return 0;
+		past->machine = this;
+		memset(past->known, 0, sizeof(past->known));
+	}
+	CBGetByte read = past ? PastByteCB : GetByteCB;
+	void *user = past ? (void*)past : (void*)this;
+
+	uint32_t steps = 0;
+	uint32_t end = undo_newest;
+	uint32_t c = undoChunk;
+	for (uint32_t n = 0; n <= UNDO_CHUNKS; ++n) {
+		bool tail = n == UNDO_CHUNKS || !undoChunks[c].records;
+		const UndoChunk &chunk = tail ? undoTail : undoChunks[c];
+		if (!chunk.records)
+			break;
+		if (scanAll || (stop.writes && ((chunk.pages[0] & mask[0]) | (chunk.pages[1] & mask[1]) |
+										(chunk.pages[2] & mask[2]) | (chunk.pages[3] & mask[3])))) {
+			uint32_t pos = end;
+			while (pos != chunk.first && HaveUndoRecord(pos)) {
+				uint32_t count = undo[pos];
+				bool hit = false;
+				for (uint32_t w = 1; w < count; ++w) {
+					uint32_t change = pos + UNDO_BUFFER_SIZE - 3 * w;
+					uint16_t a = UndoAt(change + 2) | (uint16_t(UndoAt(change + 1)) << 8);
+					if (stop.writes && a >= lo && a <= hi)
+						hit = true;
+					if (past) {
+						past->value[a] = UndoAt(change);
+						past->known[a >> 3] |= 1 << (a & 7);
+					}
+				}
+				uint32_t regsPos = (pos + UNDO_BUFFER_SIZE - 3 * (count - 1) - sizeof(Regs)) % UNDO_BUFFER_SIZE;
+				++steps;
+				if (!hit && scanAll) {
+					Regs r;
+					for (size_t b = 0; b < sizeof(Regs); ++b)
+						((uint8_t*)&r)[b] = UndoAt(uint32_t(regsPos + b));
+					hit = (stop.cond && EvalExpression(stop.cond, r, read, user)) ||
+						(breakpoints && CheckPCBreakpoint(r, nBP, aBP_PC, aBP_CN, aBP_EX, read, user));
+				}
+				if (hit) {
+					free(past);
+					return steps;
+				}
+				pos = (regsPos + UNDO_BUFFER_SIZE - 1) % UNDO_BUFFER_SIZE;
+			}
+			if (pos != chunk.first)
+				break;	// reached the oldest record
+		} else
+			steps += chunk.records;
+		if (tail)
+			break;
+		end = chunk.first;
+		c = (c + UNDO_CHUNKS - 1) % UNDO_CHUNKS;
+	}
+	free(past);
+	return 0;
+}
+
+// unwinds the undo records directly without checking breakpoints on the way
+void Machine::Rewind(uint32_t steps)
 {
+	if (IsRunning())
+		return;
+
 	sandboxContext = true;
-	bool ret = CPUStepBackInt(currRegs, cycles);
+	while (steps-- && StepBackInt(currRegs, cycles)) {}
+}
+
+bool Machine::ReverseUntil(const ReverseStop &stop)
+{
+	uint32_t steps = FindReverseStop(stop);
+	if (!steps)
+		return false;
+	Rewind(steps);
+	return true;
+}
+
+bool Machine::ReverseToWrite(uint16_t addr)
+{
+	ReverseStop stop;
+	stop.start = stop.end = addr;
+	stop.writes = true;
+	stop.breakpoints = false;
+	stop.cond = nullptr;
+	return ReverseUntil(stop);
+}
+
+bool Machine::StepBack()
+{
+	sandboxContext = true;
+	bool ret = StepBackInt(currRegs, cycles);
 	return ret;
 }
 
-void CPUStepOverBack()
+void Machine::StepOverBack()
 {
 	// can not step while CPU is running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
-	if (Get6502Byte(currRegs.PC - 3) == 0x20) {
+	if (GetByte(uint16_t(currRegs.PC - 3)) == 0x20) {
 		uint16_t ret = currRegs.PC - 3;
 		uint32_t c = cycles;
 		do {
-			CPUStepBackInt(currRegs, cycles);
-		} while (currRegs.PC != ret && (cycles - c) < 64 && !CheckPCBreakpoint(currRegs.PC) && HaveUndoStep());
+			StepBackInt(currRegs, cycles);
+		} while (currRegs.PC != ret && (cycles - c) < 64 && !CheckPCBreakpoint(currRegs) && HaveUndoStep());
 		if (currRegs.PC != ret && HaveUndoStep()) {
 			runTo = ret;
-			CPUReverseThread();
+			ReverseThread();
 		}
 	} else
-		CPUStepBackInt(currRegs, cycles);
+		StepBackInt(currRegs, cycles);
 
 	memChange = true;
 }
 
-bool IsCPURunning()
-{
-	return hThreadCPU != IBThread_Clear;
-}
-
-bool MemoryChange()
+void Machine::Stop()
 {
-	return memChange || memChangePrev;
+	while (1 != InterlockedExchange16((SHORT*)&bStopCPU, 1)) {}
 }
 
-void ClearMemoryChange()
+MachineRunResult Machine::Run(uint32_t cycleBudget)
 {
-	memChange = false;
-}
-
+	if (IsRunning())
+		return MRR_Break;
 
-void CPUStop()
-{
-	while (1 != InterlockedExchange16((SHORT*)&bStopCPU, 1)) {}
+	uint32_t start = cycles;
+	while ((cycles - start) < cycleBudget) {
+		uint16_t pc = currRegs.PC;
+		currRegs = Step6502(currRegs, GetByteCB, SetByteCB, this, busCycleMode ? BusCycleStart(cycles) : nullptr);
+		if (currRegs.T == 0xff)
+			return MRR_Jam;
+		cycles += currRegs.T;
+		if (currRegs.PC == pc)
+			return MRR_Trap;
+		if (HitPCBreakpoint(currRegs))
+			return MRR_Break;
+	}
+	return MRR_Budget;
 }
 
-void CPUStep()
+void Machine::Step()
 {
 	// can not step while CPU is running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
-	CPUStepInt();
+	StepInt();
 }
 
-/*
-struct sBPCond _aBP_CN[MAX_PC_BREAKPOINTS];
-uint8_t _aBP_EX[MAX_BP_CONDITIONS];
-*/
-
-void CPUGo(uint32_t numInstructions)
+void Machine::Go(uint32_t numInstructions)
 {
 	// can not step while CPU is running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
 	runCount = numInstructions;
 	uint32_t c = cycles;
-	do {
-		CPUStep();
+	for (;;) {
+		Step();
 		if (numInstructions && !runCount) { break; }
 		if (currRegs.T == 0xff)
 			break;
+		// check before handing over to the thread so the hit is counted once
+		if (!numInstructions && HitPCBreakpoint(currRegs))
+			break;
 		if ((cycles - c) > 64) {
-			CPUGoThread();
+			GoThread();
 			return;
 		}
-	} while (numInstructions || !CheckPCBreakpoint(currRegs.PC));
+	}
 }
 
-void CPURunTo(uint16_t stopAddr)
+void Machine::RunTo(uint16_t stopAddr)
 {
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
 	uint32_t c = cycles;
 	do {
 		if (currRegs.PC == stopAddr) { break; }
-		CPUStep();
-		if (currRegs.T == 0xff)
+		Step();
+		if (currRegs.T == 0xff || HitPCBreakpoint(currRegs))
 			break;
 		if ((cycles - c) > 64) {
 			runTo = stopAddr;
-			CPUGoThread();
+			GoThread();
 			return;
 		}
-	} while (!CheckPCBreakpoint(currRegs.PC));
+	} while (true);
 }
 
 
-void CPUReverse(uint32_t numInstructions)
+void Machine::Reverse(uint32_t numInstructions)
 {
 	// can not step while CPU is running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	runCount = numInstructions;
 	sandboxContext = true;
 	uint32_t c = cycles;
 	do {
-		if (!CPUStepBackInt(currRegs, cycles))
+		if (!StepBackInt(currRegs, cycles))
 			break;
 		if (numInstructions && !runCount) { break; }
 		if ((c - cycles) > 64) {
-			CPUReverseThread();
+			ReverseThread();
 			return;
 		}
-	} while (numInstructions || CheckPCBreakpoint(currRegs.PC));
+	} while (numInstructions || CheckPCBreakpoint(currRegs));
 }
 
-void CPUReverseTo(uint16_t stopAddr)
+void Machine::ReverseTo(uint16_t stopAddr)
 {
 	// can not step while CPU is running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
 	uint32_t c = cycles;
 	do {
-		if (!CPUStepBackInt(currRegs, cycles))
+		if (!StepBackInt(currRegs, cycles))
 			break;
 		if ((c - cycles) > 64) {
 			runTo = stopAddr;
-			CPUReverseThread();
+			ReverseThread();
 			return;
 		}
-	} while (!CheckPCBreakpoint(currRegs.PC) && currRegs.PC != stopAddr);
+	} while (!CheckPCBreakpoint(currRegs) && currRegs.PC != stopAddr);
 }
 
-static IBThreadRet CPUGoThreadRun(void *param)
+IBThreadRet Machine::GoThreadRun(void *param)
 {
+	Machine *m = (Machine*)param;
+
 	// copy breakpoints to stack so UI can modify original freely
 	uint16_t _aBP_PC[MAX_PC_BREAKPOINTS];
-	struct sBPCond _aBP_CN[MAX_PC_BREAKPOINTS];
+	uint32_t _aBP_ID[MAX_PC_BREAKPOINTS];
+	BPCond _aBP_CN[MAX_PC_BREAKPOINTS];
+	uint32_t _aBP_HT[MAX_PC_BREAKPOINTS];	// hits when copied
 	uint8_t _aBP_EX[MAX_BP_CONDITIONS];
-	uint16_t _nBP_PC = nBP;
-	uint16_t _runTo = runTo;
-	uint32_t _runCount = runCount;
-	uint32_t _history_count = history_count;
-	runTo = 0xffff;
-	runCount = 0;
-
-	IBMutexLock(&mutexBP);
-
-	memcpy(_aBP_PC, aBP_PC, sizeof(uint16_t) * _nBP_PC);
-	memcpy(_aBP_CN, aBP_CN, sizeof(_aBP_CN[0]) * _nBP_PC);
-	if (nBP_EX_Len)
-		memcpy(_aBP_EX, aBP_EX, nBP_EX_Len);
+	uint16_t _nBP_PC = m->nBP;
+	uint16_t _runTo = m->runTo;
+	uint32_t _runCount = m->runCount;
+	uint32_t _history_count = m->history_count;
+	m->runTo = 0xffff;
+	m->runCount = 0;
+
+	IBMutexLock(&m->mutexBP);
+
+	memcpy(_aBP_PC, m->aBP_PC, sizeof(uint16_t) * _nBP_PC);
+	memcpy(_aBP_ID, m->aBP_ID, sizeof(uint32_t) * _nBP_PC);
+	memcpy(_aBP_CN, m->aBP_CN, sizeof(_aBP_CN[0]) * _nBP_PC);
+	for (uint16_t b = 0; b < _nBP_PC; b++)
+		_aBP_HT[b] = _aBP_CN[b].hits;
+	if (m->nBP_EX_Len)
+		memcpy(_aBP_EX, m->aBP_EX, m->nBP_EX_Len);
+	uint16_t hitSlot = 0xffff;
+
+	// tracepoints are too large for the thread stack, the copy lives in the machine
+	uint16_t _nTP = m->nTP;
+	uint32_t _tpVersion = m->tpVersion;
+	memcpy(m->runTP, m->aTP, sizeof(Tracepoint) * _nTP);
+	memcpy(m->runTPPCs, m->tpPCs, sizeof(m->tpPCs));
 
 	// keep regs and cycles on stack for the same reason
-	Regs stackRegs = currRegs;
-	uint32_t stackCycles = cycles;
-	uint32_t updateCycles = cycles;
-	bStopCPU = 0;
-	bCPUIRQ = 0;
-	bCPUIRQ = 0;
-
-	IBMutexRelease(&mutexBP);
+	Regs stackRegs = m->currRegs;
+	uint32_t stackCycles = m->cycles;
+	uint32_t updateCycles = m->cycles;
+	m->bStopCPU = 0;
+	m->bCPUIRQ = 0;
+	m->bCPUNMI = 0;
+
+	// heatmap collection goes through separate callbacks to keep the default path lean
+	bool heatRun = m->heatEnabled;
+	bool traceRun = m->primary && IsTraceRecording();
+	bool callRun = m->primary && IsCallGraphEnabled();
+	bool busRun = m->busCycleMode;
+	CBGetByte getByte;
+	CBSetByte setByte;
+	m->SelectMemAccess(heatRun, traceRun, getByte, setByte);
+	m->instWrote = false;
+
+	IBMutexRelease(&m->mutexBP);
 
 	do {
-		CPUAddUndoRegs(stackRegs);
-		stackRegs = Step6502(stackRegs, Get6502Byte, Set6502ByteRecord);
-		if (stackRegs.T != 0xff)
-			stackCycles += stackRegs.T;
-		else
+		m->AddUndoRegs(stackRegs);
+		if (heatRun) { m->HeatInstruction(stackRegs.PC, stackCycles); }
+		Regs before = stackRegs;
+		uint8_t op = m->GetByte(stackRegs.PC);
+		stackRegs = Step6502(stackRegs, getByte, setByte, m, busRun ? m->BusCycleStart(stackCycles) : nullptr);
+		if (stackRegs.T == 0xff)
 			break;
+		if (traceRun) { m->TraceStep(before, op, stackCycles); }
+		stackCycles += stackRegs.T;
 		++_history_count;
-
-		if (bCPUIRQ) {
-			CPUAddUndoRegs(stackRegs);
-			stackRegs = IRQ6502(stackRegs, Get6502Byte, Set6502ByteRecord);
-			while (0 != InterlockedExchange16((SHORT*)&bCPUIRQ, 0)) {}
+		if (callRun) { CallGraphStep(op, before, stackRegs, stackCycles); }
+
+		if (m->bCPUIRQ) {
+			m->AddUndoRegs(stackRegs);
+			m->heatLen = 0;
+			before = stackRegs;
+			stackRegs = IRQ6502(stackRegs, getByte, setByte, m, busRun ? m->BusCycleStart(stackCycles) : nullptr);
+			m->instWrote = false;
+			if (callRun) { CallGraphInterrupt(before, stackRegs, stackCycles, false); }
+			while (0 != InterlockedExchange16((SHORT*)&m->bCPUIRQ, 0)) {}
 		}
 
-		if (bCPUNMI) {
-			CPUAddUndoRegs(stackRegs);
-			stackRegs = NMI6502(stackRegs, Get6502Byte, Set6502ByteRecord);
-			while (0 != InterlockedExchange16((SHORT*)&bCPUNMI, 0)) {}
+		if (m->bCPUNMI) {
+			m->AddUndoRegs(stackRegs);
+			m->heatLen = 0;
+			before = stackRegs;
+			stackRegs = NMI6502(stackRegs, getByte, setByte, m, busRun ? m->BusCycleStart(stackCycles) : nullptr);
+			m->instWrote = false;
+			if (callRun) { CallGraphInterrupt(before, stackRegs, stackCycles, true); }
+			while (0 != InterlockedExchange16((SHORT*)&m->bCPUNMI, 0)) {}
 		}
 
+		if (_nTP && TracepointPC(m->runTPPCs, stackRegs.PC)) { m->HitTracepoints(stackRegs, stackCycles, m->runTP, _nTP); }
 		if (_runTo != 0xffff && stackRegs.PC == _runTo) { break; }
 		if (_runCount) {
 			_runCount--;
@@ -1090,76 +1750,100 @@ static IBThreadRet CPUGoThreadRun(void *param)
 		if ((stackCycles - updateCycles) > THREAD_CPU_CYCLES_PER_UPDATE) {
 			Sleep(1);
 			updateCycles = stackCycles;
-			IBMutexLock(&mutexBP);
-			_nBP_PC = nBP;
-			memcpy(_aBP_PC, aBP_PC, sizeof(uint16_t) * _nBP_PC);
-			memcpy(_aBP_CN, aBP_CN, sizeof(_aBP_CN[0]) * _nBP_PC);
-			if (nBP_EX_Len)
-				memcpy(_aBP_EX, aBP_EX, nBP_EX_Len);
-			currRegs = stackRegs;
-			cycles = stackCycles;
-			uint16_t stopped = bStopCPU;
-			IBMutexRelease(&mutexBP);
+			IBMutexLock(&m->mutexBP);
+			m->PublishBPHits(_aBP_ID, _aBP_CN, _aBP_HT, _nBP_PC);
+			_nBP_PC = m->nBP;
+			memcpy(_aBP_PC, m->aBP_PC, sizeof(uint16_t) * _nBP_PC);
+			memcpy(_aBP_ID, m->aBP_ID, sizeof(uint32_t) * _nBP_PC);
+			memcpy(_aBP_CN, m->aBP_CN, sizeof(_aBP_CN[0]) * _nBP_PC);
+			for (uint16_t b = 0; b < _nBP_PC; b++)
+				_aBP_HT[b] = _aBP_CN[b].hits;
+			if (m->nBP_EX_Len)
+				memcpy(_aBP_EX, m->aBP_EX, m->nBP_EX_Len);
+			if (_tpVersion != m->tpVersion) {
+				_nTP = m->nTP;
+				_tpVersion = m->tpVersion;
+				memcpy(m->runTP, m->aTP, sizeof(Tracepoint) * _nTP);
+				memcpy(m->runTPPCs, m->tpPCs, sizeof(m->tpPCs));
+			}
+			m->currRegs = stackRegs;
+			m->cycles = stackCycles;
+			uint16_t stopped = m->bStopCPU;
+			heatRun = m->heatEnabled;
+			traceRun = m->primary && IsTraceRecording();
+			callRun = m->primary && IsCallGraphEnabled();
+			busRun = m->busCycleMode;
+			m->SelectMemAccess(heatRun, traceRun, getByte, setByte);
+			IBMutexRelease(&m->mutexBP);
 			if (stopped)
 				break;
 		}
-	} while (!CheckPCBreakpoint(stackRegs.PC, _nBP_PC, _aBP_PC, _aBP_CN, aBP_EX));
+	} while (!m->HitPCBreakpoint(stackRegs, _nBP_PC, _aBP_PC, _aBP_CN, _aBP_EX, hitSlot));
 
-	currRegs = stackRegs;
-	cycles = stackCycles;
-	history_count = _history_count;
-	if (_history_count > history_max) { history_max = _history_count; }
+	IBMutexLock(&m->mutexBP);
+	m->PublishBPHits(_aBP_ID, _aBP_CN, _aBP_HT, _nBP_PC);
+	IBMutexRelease(&m->mutexBP);
+	if (hitSlot != 0xffff && _aBP_CN[hitSlot].temporary)
+		m->RemoveBreakpointByID(_aBP_ID[hitSlot]);
+
+	m->currRegs = stackRegs;
+	m->cycles = stackCycles;
+	m->history_count = _history_count;
+	if (_history_count > m->history_max) { m->history_max = _history_count; }
 
 	// the CPU thread is finished
-	hThreadCPU = IBThread_Clear;
+	m->hThreadCPU = IBThread_Clear;
 	return NULL;
 }
 
-void CPUGoThread()
+void Machine::GoThread()
 {
 	// can't start running if already running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
-	IBCreateThread(&hThreadCPU, CPU_EMULATOR_THREAD_STACK, CPUGoThreadRun, nullptr);
+	IBCreateThread(&hThreadCPU, CPU_EMULATOR_THREAD_STACK, GoThreadRun, this);
 }
 
 
-static IBThreadRet CPUReverseThreadRun(void *param)
+IBThreadRet Machine::ReverseThreadRun(void *param)
 {
+	Machine *m = (Machine*)param;
+
 	// copy breakpoints to stack so UI can modify original freely
 	uint16_t _aBP_PC[MAX_PC_BREAKPOINTS];
-	struct sBPCond _aBP_CN[MAX_PC_BREAKPOINTS];
+	BPCond _aBP_CN[MAX_PC_BREAKPOINTS];
+	uint32_t _aBP_HT[MAX_PC_BREAKPOINTS];	// hits when copied
 	uint8_t _aBP_EX[MAX_BP_CONDITIONS];
-	uint16_t _nBP_PC = nBP;
-	uint16_t _runTo = runTo;
-	uint32_t _runCount = runCount;
-	uint32_t _history_count = history_count;
-	runTo = 0xffff;
-	runCount = 0;
+	uint16_t _nBP_PC = m->nBP;
+	uint16_t _runTo = m->runTo;
+	uint32_t _runCount = m->runCount;
+	uint32_t _history_count = m->history_count;
+	m->runTo = 0xffff;
+	m->runCount = 0;
 
-	IBMutexLock(&mutexBP);
+	IBMutexLock(&m->mutexBP);
 
-	memcpy(_aBP_PC, aBP_PC, sizeof(uint16_t) * _nBP_PC);
-	memcpy(_aBP_CN, aBP_CN, sizeof(_aBP_CN[0]) * _nBP_PC);
-	if (nBP_EX_Len)
-		memcpy(_aBP_EX, aBP_EX, nBP_EX_Len);
+	memcpy(_aBP_PC, m->aBP_PC, sizeof(uint16_t) * _nBP_PC);
+	memcpy(_aBP_CN, m->aBP_CN, sizeof(_aBP_CN[0]) * _nBP_PC);
+	if (m->nBP_EX_Len)
+		memcpy(_aBP_EX, m->aBP_EX, m->nBP_EX_Len);
 
 	// keep regs and cycles on stack for the same reason
-	Regs stackRegs = currRegs;
-	uint32_t stackCycles = cycles;
-	uint32_t updateCycles = cycles;
-	bStopCPU = 0;
-	bCPUIRQ = 0;
-	bCPUIRQ = 0;
+	Regs stackRegs = m->currRegs;
+	uint32_t stackCycles = m->cycles;
+	uint32_t updateCycles = m->cycles;
+	m->bStopCPU = 0;
+	m->bCPUIRQ = 0;
+	m->bCPUNMI = 0;
 
-	IBMutexRelease(&mutexBP);
+	IBMutexRelease(&m->mutexBP);
 
 	do {
 		if (_runTo != 0xffff && stackRegs.PC == _runTo) { break; }
 
-		bool hadStep = CPUStepBackInt(stackRegs, stackCycles);
+		bool hadStep = m->StepBackInt(stackRegs, stackCycles);
 		if (_history_count) { --_history_count; }
 
 		if (_runCount) {
@@ -1170,76 +1854,80 @@ static IBThreadRet CPUReverseThreadRun(void *param)
 		if (!hadStep || (updateCycles - stackCycles) > THREAD_CPU_CYCLES_PER_UPDATE) {
 			Sleep(1);
 			updateCycles = stackCycles;
-			IBMutexLock(&mutexBP);
-			_nBP_PC = nBP;
-			memcpy(_aBP_PC, aBP_PC, sizeof(uint16_t) * _nBP_PC);
-			currRegs = stackRegs;
-			cycles = stackCycles;
-			uint16_t stopped = bStopCPU;
-			IBMutexRelease(&mutexBP);
+			IBMutexLock(&m->mutexBP);
+			_nBP_PC = m->nBP;
+			memcpy(_aBP_PC, m->aBP_PC, sizeof(uint16_t) * _nBP_PC);
+			m->currRegs = stackRegs;
+			m->cycles = stackCycles;
+			uint16_t stopped = m->bStopCPU;
+			IBMutexRelease(&m->mutexBP);
 			if (stopped || !hadStep)
 				break;
 		}
-	} while (!CheckPCBreakpoint(stackRegs.PC, _nBP_PC, _aBP_PC, _aBP_CN, aBP_EX));
+	} while (!m->CheckPCBreakpoint(stackRegs, _nBP_PC, _aBP_PC, _aBP_CN, _aBP_EX));
 
-	currRegs = stackRegs;
-	cycles = stackCycles;
-	history_count = _history_count;
-	runCount = _runCount;
+	m->currRegs = stackRegs;
+	m->cycles = stackCycles;
+	m->history_count = _history_count;
+	m->runCount = _runCount;
 
 	// the CPU thread is finished
-	hThreadCPU = IBThread_Clear;
+	m->hThreadCPU = IBThread_Clear;
 	return 0;
 }
 
-void CPUReverseThread()
+void Machine::ReverseThread()
 {
 	// can't start running if already running
-	if (IsCPURunning())
+	if (IsRunning())
 		return;
 
 	sandboxContext = true;
-	IBCreateThread(&hThreadCPU, CPU_EMULATOR_THREAD_STACK, CPUReverseThreadRun, nullptr);
+	IBCreateThread(&hThreadCPU, CPU_EMULATOR_THREAD_STACK, ReverseThreadRun, this);
 }
 
 
 
-void CPUReset()
+void Machine::Reset()
 {
-	if (!IsCPURunning()) {
+	if (!IsRunning()) {
 		sandboxContext = true;
-		CPUAddUndoRegs(currRegs);
-		currRegs = Reset6502(currRegs, Get6502Byte, Set6502ByteRecord);
+		AddUndoRegs(currRegs);
+		currRegs = Reset6502(currRegs, GetByteCB, SetByteRecordCB, this);
 	}
 }
 
-void CPUIRQ()
+void Machine::IRQ()
 {
-	if (IsCPURunning()) {
+	if (IsRunning()) {
 		while (1 != InterlockedExchange16((SHORT*)&bCPUIRQ, 1)) {}
 	} else {
-		CPUAddUndoRegs(currRegs);
-		currRegs = IRQ6502(currRegs, Get6502Byte, Set6502ByteRecord);
+		AddUndoRegs(currRegs);
+		Regs before = currRegs;
+		currRegs = IRQ6502(currRegs, GetByteCB, SetByteRecordCB, this, busCycleMode ? BusCycleStart(cycles) : nullptr);
+		if (primary && IsCallGraphEnabled()) { CallGraphInterrupt(before, currRegs, cycles, false); }
 	}
 }
 
-void CPUNMI()
+void Machine::NMI()
 {
-	if (IsCPURunning()) {
+	if (IsRunning()) {
 		while (1 != InterlockedExchange16((SHORT*)&bCPUNMI, 1)) {}
 	} else {
-		CPUAddUndoRegs(currRegs);
-		currRegs = NMI6502(currRegs, Get6502Byte, Set6502ByteRecord);
+		AddUndoRegs(currRegs);
+		Regs before = currRegs;
+		currRegs = NMI6502(currRegs, GetByteCB, SetByteRecordCB, this, busCycleMode ? BusCycleStart(cycles) : nullptr);
+		if (primary && IsCallGraphEnabled()) { CallGraphInterrupt(before, currRegs, cycles, true); }
 	}
 }
 
-uint32_t GetHistoryCount(uint32_t &maxCount)
+uint32_t Machine::GetHistoryCount(uint32_t &maxCount) const
 {
 	maxCount = history_max;
 	return history_count;
 }
 
-uint16_t GetPCBreakpointsID(uint16_t **pBP, uint32_t **pID, uint16_t &nDS)
+uint16_t Machine::GetPCBreakpointsID(uint16_t **pBP, uint32_t **pID, uint16_t &nDS)
 {
 	*pBP = aBP_PC;
 	*pID = aBP_ID;
@@ -1247,17 +1935,7 @@ uint16_t GetPCBreakpointsID(uint16_t **pBP, uint32_t **pID, uint16_t &nDS)
 	return nBP;
 }
 
-uint16_t GetNumPCBreakpoints()
-{
-	return nBP;
-}
-
-uint16_t* GetPCBreakpoints()
-{
-	return aBP_PC;
-}
-
-void EraseBPCondition(uint16_t index)
+void Machine::EraseBPCondition(uint16_t index)
 {
 	if (aBP_CN[index].size != 0) {
 		uint16_t o = aBP_CN[index].offs;
@@ -1275,7 +1953,7 @@ void EraseBPCondition(uint16_t index)
 	}
 }
 
-bool PushBackBPCondition(uint16_t index, const uint8_t *cond, uint16_t length)
+bool Machine::PushBackBPCondition(uint16_t index, const uint8_t *cond, uint16_t length)
 {
 	if (length && length < (MAX_BP_CONDITIONS - nBP_EX_Len)) {
 		memcpy(aBP_EX + nBP_EX_Len, cond, length);
@@ -1287,7 +1965,7 @@ bool PushBackBPCondition(uint16_t index, const uint8_t *cond, uint16_t length)
 	return false;
 }
 
-bool SetBPCondition(uint32_t id, const uint8_t *condition, uint16_t length)
+bool Machine::SetBPCondition(uint32_t id, const uint8_t *condition, uint16_t length)
 {
 	uint16_t idx = 0xffff;
 	for (uint16_t i = 0; i < nBP; i++) {
@@ -1311,7 +1989,7 @@ bool SetBPCondition(uint32_t id, const uint8_t *condition, uint16_t length)
 	return ret;
 }
 
-void ClearBPCondition(uint32_t id)
+void Machine::ClearBPCondition(uint32_t id)
 {
 	for (uint16_t i = 0; i < nBP; i++) {
 		if (aBP_ID[i] == id) {
@@ -1323,31 +2001,26 @@ void ClearBPCondition(uint32_t id)
 	}
 }
 
-void ClearAllPCBreakpoints()
+void Machine::ClearAllPCBreakpoints()
 {
 	IBMutexLock(&mutexBP);
-	uint16_t nBP = 0;		// total number of PC breakpoints
-	uint16_t nBP_PC = 0;	// number of PC breakpoints
-	uint16_t nBP_DS = 0;	// number of disabled breakpoints
-	uint16_t nBP_EX_Len = 0;
-	uint32_t nBP_NextID = 0;
-	uint16_t bStopCPU = 0;
-	uint16_t bCPUIRQ = 0;
-	uint16_t bCPUNMI = 0;
+	nBP = 0;
+	nBP_DS = 0;
+	nBP_EX_Len = 0;
+	nBP_NextID = 0;
 	IBMutexRelease(&mutexBP);
 }
 
-void SwapBPSlots(uint16_t b, uint16_t s)
+void Machine::SwapBPSlots(uint16_t b, uint16_t s)
 {
 	if (s != b) {
 		uint32_t id = aBP_ID[b]; aBP_ID[b] = aBP_ID[s]; aBP_ID[s] = id;
 		uint16_t t = aBP_PC[b];	aBP_PC[b] = aBP_PC[s]; aBP_PC[s] = t;
-		t = aBP_CN[b].offs; aBP_CN[b].offs = aBP_CN[s].offs; aBP_CN[s].offs = t;
-		t = aBP_CN[b].size; aBP_CN[b].size = aBP_CN[s].size; aBP_CN[s].size = t;
+		BPCond c = aBP_CN[b]; aBP_CN[b] = aBP_CN[s]; aBP_CN[s] = c;
 	}
 }
 
-void MoveBPSlots(uint16_t s, uint16_t d)
+void Machine::MoveBPSlots(uint16_t s, uint16_t d)
 {
 	if (s != d) {
 		aBP_PC[d] = aBP_PC[s];
@@ -1357,7 +2030,7 @@ void MoveBPSlots(uint16_t s, uint16_t d)
 }
 
 // if delete - return index of breakpoint, otherwise ~0
-uint32_t TogglePCBreakpoint(uint16_t addr)
+uint32_t Machine::TogglePCBreakpoint(uint16_t addr)
 {
 	IBMutexLock(&mutexBP);
 	uint16_t nBP_T = nBP + nBP_DS;
@@ -1382,14 +2055,180 @@ uint32_t TogglePCBreakpoint(uint16_t addr)
 		if (nBP_DS)
 			MoveBPSlots(nBP, nBP + nBP_DS);
 		aBP_ID[nBP] = nBP_NextID++;
-		aBP_CN[nBP].size = 0;
+		aBP_CN[nBP] = BPCond();
 		aBP_PC[nBP++] = addr;
 	}
 	IBMutexRelease(&mutexBP);
 	return ~0UL;
 }
 
-uint32_t SetPCBreakpoint(uint16_t addr)
+uint32_t Machine::SetTempPCBreakpoint(uint16_t addr)
+{
+	IBMutexLock(&mutexBP);
+	uint16_t nBP_T = nBP + nBP_DS;
+	for (int b = 0; b < nBP_T; b++) {
+		if (aBP_PC[b] == addr) {
+			// an existing breakpoint stays as it is
+			IBMutexRelease(&mutexBP);
+			return aBP_ID[b];
+		}
+	}
+	uint32_t ret = ~0UL;
+	if (nBP < MAX_PC_BREAKPOINTS) {
+		if (nBP_DS)
+			MoveBPSlots(nBP, nBP + nBP_DS);
+		ret = aBP_ID[nBP] = nBP_NextID++;
+		aBP_CN[nBP] = BPCond();
+		aBP_CN[nBP].temporary = true;
+		aBP_PC[nBP++] = addr;
+	}
+	IBMutexRelease(&mutexBP);
+	return ret;
+}
+
+bool Machine::SetBPIgnore(uint32_t id, uint32_t count)
+{
+	IBMutexLock(&mutexBP);
+	for (uint16_t b = 0, n = nBP + nBP_DS; b < n; b++) {
+		if (aBP_ID[b] == id) {
+			aBP_CN[b].ignoreTo = aBP_CN[b].hits + count;
+			IBMutexRelease(&mutexBP);
+			return true;
+		}
+	}
+	IBMutexRelease(&mutexBP);
+	return false;
+}
+
+bool Machine::SetBPEvery(uint32_t id, uint16_t every)
+{
+	IBMutexLock(&mutexBP);
+	for (uint16_t b = 0, n = nBP + nBP_DS; b < n; b++) {
+		if (aBP_ID[b] == id) {
+			aBP_CN[b].every = every;
+			IBMutexRelease(&mutexBP);
+			return true;
+		}
+	}
+	IBMutexRelease(&mutexBP);
+	return false;
+}
+
+void Machine::ResetBPHits(uint32_t id)
+{
+	IBMutexLock(&mutexBP);
+	for (uint16_t b = 0, n = nBP + nBP_DS; b < n; b++) {
+		if (aBP_ID[b] == id || id == ~0U) {
+			aBP_CN[b].hits = 0;
+			aBP_CN[b].ignoreTo = 0;
+		}
+	}
+	IBMutexRelease(&mutexBP);
+}
+
+bool Machine::GetBPHits(uint32_t id, BreakpointHits &info) const
+{
+	for (uint16_t b = 0, n = nBP + nBP_DS; b < n; b++) {
+		if (aBP_ID[b] == id) {
+			const BPCond &c = aBP_CN[b];
+			info.hits = c.hits;
+			info.ignore = c.ignoreTo > c.hits ? c.ignoreTo - c.hits : 0;
+			info.every = c.every;
+			info.temporary = c.temporary;
+			return true;
+		}
+	}
+	return false;
+}
+
+// evaluated on the thread running the cpu, records are formatted when the UI drains the log
+// bit per pc that has a tracepoint, rebuilt with every tracepoint change
+static void BuildTracepointPCs(uint32_t *pcs, const Tracepoint *tp, uint16_t num)
+{
+	memset(pcs, 0, sizeof(uint32_t) * (0x10000 / 32));
+	for (uint16_t t = 0; t < num; ++t)
+		pcs[tp[t].pc >> 5] |= 1U << (tp[t].pc & 31);
+}
+
+void Machine::HitTracepoints(const Regs &regs, uint32_t cycle, const Tracepoint *tp, uint16_t num)
+{
+	for (uint16_t t = 0; t < num; ++t) {
+		if (tp[t].pc != regs.PC)
+			continue;
+		uint32_t head = traceLogHead.load(std::memory_order_relaxed);
+		if ((head - traceLogTail.load(std::memory_order_acquire)) >= TRACE_LOG_SIZE) {
+			++traceLogDropped;
+			continue;
+		}
+		TraceLogRecord &record = traceLog[head & (TRACE_LOG_SIZE - 1)];
+		record.id = tp[t].id;
+		record.cycle = cycle;
+		record.pc = regs.PC;
+		record.numValues = tp[t].numValues;
+		for (uint8_t v = 0; v < tp[t].numValues; ++v)
+			record.values[v] = EvalExpression(tp[t].rpn[v], regs, GetByteCB, this);
+		traceLogHead.store(head + 1, std::memory_order_release);
+	}
+}
+
+bool Machine::PopTraceLog(TraceLogRecord &record)
+{
+	uint32_t tail = traceLogTail.load(std::memory_order_relaxed);
+	if (tail == traceLogHead.load(std::memory_order_acquire))
+		return false;
+	record = traceLog[tail & (TRACE_LOG_SIZE - 1)];
+	traceLogTail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+uint32_t Machine::AddTracepoint(uint16_t pc, const char *expressions)
+{
+	if (!traceLog) {
+		traceLog = (TraceLogRecord*)malloc(sizeof(TraceLogRecord) * TRACE_LOG_SIZE);
+		if (!traceLog)
+			return ~0UL;
+	}
+
+	Tracepoint tp;
+	strref text(expressions);
+	text.trim_whitespace();
+	strovl copy(tp.text, sizeof(tp.text));
+	copy.copy(text);
+	copy.c_str();
+	tp.pc = pc;
+	tp.numValues = 0;
+	while (text && tp.numValues < TRACEPOINT_VALUES) {
+		strown<TRACEPOINT_TEXT> exp(text.split_token_trim(','));
+		if (exp) { BuildExpression(exp.c_str(), tp.rpn[tp.numValues++], TRACEPOINT_EXPR_SIZE); }
+	}
+
+	uint32_t ret = ~0UL;
+	IBMutexLock(&mutexBP);
+	if (nTP < MAX_TRACEPOINTS) {
+		ret = tp.id = nBP_NextID++;
+		aTP[nTP++] = tp;
+		++tpVersion;
+		BuildTracepointPCs(tpPCs, aTP, nTP);
+	}
+	IBMutexRelease(&mutexBP);
+	return ret;
+}
+
+void Machine::RemoveTracepoint(uint32_t id)
+{
+	IBMutexLock(&mutexBP);
+	for (uint16_t t = 0; t < nTP; ) {
+		if (aTP[t].id == id || id == ~0U) {
+			aTP[t] = aTP[--nTP];
+			++tpVersion;
+		} else
+			++t;
+	}
+	BuildTracepointPCs(tpPCs, aTP, nTP);
+	IBMutexRelease(&mutexBP);
+}
+
+uint32_t Machine::SetPCBreakpoint(uint16_t addr)
 {
 	uint32_t ret = ~0UL;
 	IBMutexLock(&mutexBP);
@@ -1405,14 +2244,14 @@ uint32_t SetPCBreakpoint(uint16_t addr)
 		if (nBP_DS)
 			MoveBPSlots(nBP, nBP + nBP_DS);
 		ret = aBP_ID[nBP] = nBP_NextID++;
-		aBP_CN[nBP].size = 0;
+		aBP_CN[nBP] = BPCond();
 		aBP_PC[nBP++] = addr;
 	}
 	IBMutexRelease(&mutexBP);
 	return ret;
 }
 
-void ClearPCBreakpoint(uint16_t addr)
+void Machine::ClearPCBreakpoint(uint16_t addr)
 {
 	IBMutexLock(&mutexBP);
 
@@ -1425,7 +2264,7 @@ void ClearPCBreakpoint(uint16_t addr)
 	IBMutexRelease(&mutexBP);
 }
 
-bool GetBreakpointAddrByID(uint32_t id, uint16_t &addr)
+bool Machine::GetBreakpointAddrByID(uint32_t id, uint16_t &addr) const
 {
 	uint16_t nBP_T = nBP + nBP_DS;
 	for (int b = 0; b < nBP_T; b++) {
@@ -1437,7 +2276,7 @@ bool GetBreakpointAddrByID(uint32_t id, uint16_t &addr)
 	return false;
 }
 
-void RemoveBreakpointByID(uint32_t id)
+void Machine::RemoveBreakpointByID(uint32_t id)
 {
 	IBMutexLock(&mutexBP);
 	for (int b = 0; b < (nBP + nBP_DS); b++) {
@@ -1458,7 +2297,7 @@ void RemoveBreakpointByID(uint32_t id)
 	IBMutexRelease(&mutexBP);
 }
 
-bool EnableBPByID(uint32_t id, bool enable)
+bool Machine::EnableBPByID(uint32_t id, bool enable)
 {
 	IBMutexLock(&mutexBP);
 	if (enable) {
@@ -1488,6 +2327,79 @@ bool EnableBPByID(uint32_t id, bool enable)
 	return false;
 }
 
+//
+// C interface on the default machine
+//
+
+void Initialize6502() { sMachine.Initialize(true); }
+void Shutdown6502() { sMachine.Shutdown(); }
+void ResetUndoBuffer() { sMachine.ResetUndoBuffer(); }
+void CheckRegChange() { sMachine.CheckRegChange(); }
+Regs& GetRegs() { return sMachine.GetRegs(); }
+void SetRegs(const Regs &r) { sMachine.SetRegs(r); }
+uint32_t GetCycles() { return sMachine.GetCycles(); }
+uint8_t *Get6502Mem(uint16_t addr) { return sMachine.GetMem(addr); }
+bool IsSandboxContext() { return sMachine.IsSandboxContext(); }
+void SetSandboxContext(bool set) { sMachine.SetSandboxContext(set); }
+uint8_t Get6502Byte(uint16_t addr) { return sMachine.GetByte(addr); }
+void Set6502Byte(uint16_t addr, uint8_t value) { sMachine.SetByte(addr, value); }
+uint32_t Patch6502Mem(uint16_t addr, const uint8_t *data, uint32_t size) { return sMachine.PatchMemory(addr, data, size); }
+bool MemoryChange() { return sMachine.MemoryChange(); }
+void ClearMemoryChange() { sMachine.ClearMemoryChange(); }
+uint32_t SetTempPCBreakpoint(uint16_t addr) { return sMachine.SetTempPCBreakpoint(addr); }
+bool SetBPIgnore(uint32_t id, uint32_t count) { return sMachine.SetBPIgnore(id, count); }
+bool SetBPEvery(uint32_t id, uint16_t every) { return sMachine.SetBPEvery(id, every); }
+void ResetBPHits(uint32_t id) { sMachine.ResetBPHits(id); }
+bool GetBPHits(uint32_t id, BreakpointHits &info) { return sMachine.GetBPHits(id, info); }
+uint32_t AddTracepoint(uint16_t pc, const char *expressions) { return sMachine.AddTracepoint(pc, expressions); }
+void RemoveTracepoint(uint32_t id) { sMachine.RemoveTracepoint(id); }
+int GetNumTracepoints() { return sMachine.GetNumTracepoints(); }
+const Tracepoint* GetTracepoints() { return sMachine.GetTracepoints(); }
+bool PopTraceLog(TraceLogRecord &record) { return sMachine.PopTraceLog(record); }
+uint32_t GetTraceLogDropped() { return sMachine.GetTraceLogDropped(); }
+uint32_t GetWriteGeneration() { return sMachine.GetWriteGeneration(); }
+uint32_t GetPageWriteGeneration(uint8_t page) { return sMachine.GetPageWriteGeneration(page); }
+bool IsCPURunning() { return sMachine.IsRunning(); }
+void CPUAddUndoRegs(Regs &regs) { sMachine.AddUndoRegs(regs); }
+void CPUGo(uint32_t numInstructions) { sMachine.Go(numInstructions); }
+void CPURunTo(uint16_t stopAddr) { sMachine.RunTo(stopAddr); }
+void CPUReverse(uint32_t numInstructions) { sMachine.Reverse(numInstructions); }
+void CPUReverseTo(uint16_t stopAddr) { sMachine.ReverseTo(stopAddr); }
+void CPUStop() { sMachine.Stop(); }
+void CPUStep() { sMachine.Step(); }
+void CPUStepOver() { sMachine.StepOver(); }
+bool CPUStepBack() { return sMachine.StepBack(); }
+int FindHistoryWrites(uint16_t addr, UndoWrite *writes, int maxWrites) { return sMachine.FindWrites(addr, writes, maxWrites); }
+bool CPUReverseToWrite(uint16_t addr) { return sMachine.ReverseToWrite(addr); }
+bool CPUReverseUntil(const ReverseStop &stop) { return sMachine.ReverseUntil(stop); }
+void CPUStepOverBack() { sMachine.StepOverBack(); }
+void CPUReset() { sMachine.Reset(); }
+void CPUIRQ() { sMachine.IRQ(); }
+void CPUNMI() { sMachine.NMI(); }
+uint32_t GetHistoryCount(uint32_t &maxCount) { return sMachine.GetHistoryCount(maxCount); }
+bool SetBPCondition(uint32_t id, const uint8_t *condition, uint16_t length) { return sMachine.SetBPCondition(id, condition, length); }
+void ClearBPCondition(uint32_t id) { sMachine.ClearBPCondition(id); }
+void ClearAllPCBreakpoints() { sMachine.ClearAllPCBreakpoints(); }
+uint16_t GetNumPCBreakpoints() { return sMachine.GetNumPCBreakpoints(); }
+uint16_t* GetPCBreakpoints() { return sMachine.GetPCBreakpoints(); }
+uint16_t GetPCBreakpointsID(uint16_t **pBP, uint32_t **pID, uint16_t &nDS) { return sMachine.GetPCBreakpointsID(pBP, pID, nDS); }
+uint32_t TogglePCBreakpoint(uint16_t addr) { return sMachine.TogglePCBreakpoint(addr); }
+uint32_t SetPCBreakpoint(uint16_t addr) { return sMachine.SetPCBreakpoint(addr); }
+void ClearPCBreakpoint(uint16_t addr) { sMachine.ClearPCBreakpoint(addr); }
+void RemoveBreakpointByID(uint32_t id) { sMachine.RemoveBreakpointByID(id); }
+bool GetBreakpointAddrByID(uint32_t id, uint16_t &addr) { return sMachine.GetBreakpointAddrByID(id, addr); }
+bool EnableBPByID(uint32_t id, bool enable) { return sMachine.EnableBPByID(id, enable); }
+void EnableHeatmap(bool enable) { sMachine.EnableHeatmap(enable); }
+bool IsHeatmapEnabled() { return sMachine.IsHeatmapEnabled(); }
+void ClearHeatmap() { sMachine.ClearHeatmap(); }
+uint32_t GetHeatAge(uint16_t addr, HeatAccess type) { return sMachine.GetHeatAge(addr, type); }
+uint32_t GetHeatCount(uint16_t addr, HeatAccess type) { return sMachine.GetHeatCount(addr, type); }
+void SetBusCycleMode(bool enable) { sMachine.SetBusCycleMode(enable); }
+bool IsBusCycleMode() { return sMachine.IsBusCycleMode(); }
+void SetBusCycleHook(BusCycleHook hook, void *user) { sMachine.SetBusCycleHook(hook, user); }
+int GetLastBusCycles(const BusCycle **bus) { return sMachine.GetLastBusCycles(bus); }
+
+
 int InstructionBytes(uint16_t addr, bool illegals)
 {
 	const dismnm *opcodes = a6502_ops;
@@ -2,6 +2,9 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <vector>
+#include <atomic>
+#include "platform.h"
 
 // complete representation of 6502 registers
 typedef struct Regs {
@@ -56,6 +59,7 @@ uint32_t GetCycles();
 uint8_t *Get6502Mem(uint16_t addr = 0);
 uint8_t Get6502Byte(uint16_t addr);
 void Set6502Byte(uint16_t addr, uint8_t value);
+uint32_t Patch6502Mem(uint16_t addr, const uint8_t *data, uint32_t size);	// bytes changed, stepping back undoes the patch
 bool IsSandboxContext();
 void SetSandboxContext(bool set);
 int InstrRef(uint16_t pc, char* buf, size_t bufSize);
@@ -64,6 +68,8 @@ int Assemble(char *cmd, uint16_t addr);
 int InstructionBytes(uint16_t addr, bool illegals = false);
 bool MemoryChange();
 void ClearMemoryChange();
+uint32_t GetWriteGeneration();				// counts every memory write
+uint32_t GetPageWriteGeneration(uint8_t page);	// write generation of the most recent write to a page
 void CheckRegChange();
 bool IsCPURunning();
 void CPUAddUndoRegs(Regs &regs);
@@ -82,6 +88,27 @@ void CPUNMI();
 
 uint32_t GetHistoryCount(uint32_t &maxCount);
 
+// a write to an address found in the undo history, newest first
+struct UndoWrite {
+	uint32_t stepsBack;		// reverse steps to the state before the write
+	uint16_t pc;			// instruction that wrote
+	uint8_t before, after;
+};
+
+int FindHistoryWrites(uint16_t addr, UndoWrite *writes, int maxWrites);
+bool CPUReverseToWrite(uint16_t addr);	// false if the address was not written in the history
+
+// reverse-continue stop conditions, checked against the undo records so only
+// the final state is restored
+struct ReverseStop {
+	uint16_t start, end;	// address range for writes
+	bool writes;			// stop before a write within start-end
+	bool breakpoints;		// stop at pc breakpoints
+	const uint8_t *cond;	// expression bytecode, stop at the first earlier state where it is true
+};
+
+bool CPUReverseUntil(const ReverseStop &stop);	// false if no earlier state matches
+
 
 bool SetBPCondition(uint32_t id, const uint8_t *condition, uint16_t length);
 void ClearBPCondition(uint32_t id);
@@ -96,3 +123,351 @@ void RemoveBreakpointByID(uint32_t id);
 bool GetBreakpointAddrByID(uint32_t id, uint16_t &addr);
 bool EnableBPByID(uint32_t id, bool enable);
 
+// hit counting of pc breakpoints, only forward execution counts
+struct BreakpointHits {
+	uint32_t hits;		// times reached with the condition true
+	uint32_t ignore;	// hits left before it stops again
+	uint16_t every;		// stops on every nth hit after the ignored ones
+	bool temporary;		// removed the first time it stops
+};
+
+uint32_t SetTempPCBreakpoint(uint16_t addr);
+bool SetBPIgnore(uint32_t id, uint32_t count);	// don't stop for the next count hits
+bool SetBPEvery(uint32_t id, uint16_t every);	// 0 or 1 stops on every hit
+void ResetBPHits(uint32_t id);	// ~0 resets all
+bool GetBPHits(uint32_t id, BreakpointHits &info);
+
+// memory access heatmap, only collected while enabled
+enum HeatAccess {
+	HEAT_READ,
+	HEAT_WRITE,
+	HEAT_EXEC,
+	HEAT_ACCESS_TYPES
+};
+
+// access counts decay lazily, halving for every HEAT_DECAY_CYCLES since the last access
+#define HEAT_DECAY_CYCLES (1<<20)
+#define HEAT_NEVER 0xffffffff
+
+// one entry per address so a lookup only touches a single cache line
+struct HeatCell {
+	uint32_t last[HEAT_ACCESS_TYPES];	// cycle of most recent access
+	uint16_t count[HEAT_ACCESS_TYPES];	// access count at time of last access
+	uint16_t touched;					// bit per access type seen
+};
+
+void EnableHeatmap(bool enable);
+bool IsHeatmapEnabled();
+void ClearHeatmap();
+uint32_t GetHeatAge(uint16_t addr, HeatAccess type);	// cycles since last access or HEAT_NEVER
+uint32_t GetHeatCount(uint16_t addr, HeatAccess type);	// decayed access count
+
+// bus cycle mode steps with sub-instruction timing, reporting each memory access
+// including dummy reads and the read-modify-write double write with its cycle
+enum BusAccessType {
+	BUS_READ,
+	BUS_WRITE,
+	BUS_DUMMY_READ,
+	BUS_DUMMY_WRITE
+};
+
+#define BUS_CYCLES_MAX 16	// accesses per instruction or interrupt
+
+struct BusCycle {
+	uint32_t cycle;		// cycle count of the access
+	uint16_t addr;
+	uint8_t value;
+	uint8_t access;		// BusAccessType
+};
+
+typedef void(*BusCycleHook)(const BusCycle &bus, void *user);
+
+// cpu memory callbacks, user is passed through from the step functions
+typedef void(*CBSetByte)(uint16_t addr, uint8_t value, void *user);
+typedef uint8_t(*CBGetByte)(uint16_t addr, void *user);
+
+// bus cycle callback, cycle is counted from the opcode fetch and access is a BusAccessType
+typedef void(*CBBusCycle)(uint16_t addr, uint8_t value, uint8_t cycle, uint8_t access, void *user);
+
+void SetBusCycleMode(bool enable);
+bool IsBusCycleMode();
+void SetBusCycleHook(BusCycleHook hook, void *user);	// called for every access in bus cycle mode
+int GetLastBusCycles(const BusCycle **bus);			// accesses of the most recent instruction or interrupt
+
+// why Machine::Run returned
+enum MachineRunResult {
+	MRR_Budget,		// cycle budget used up
+	MRR_Trap,		// instruction jumped or branched to itself
+	MRR_Jam,		// jam opcode
+	MRR_Break,		// pc breakpoint
+};
+
+#define MAX_PC_BREAKPOINTS 256
+#define MAX_BP_CONDITIONS 4*1024
+
+// tracepoints log expressions when the pc reaches an address without stopping
+#define MAX_TRACEPOINTS 64
+#define TRACEPOINT_VALUES 4			// expressions per tracepoint
+#define TRACEPOINT_EXPR_SIZE 64		// bytecode per expression
+#define TRACEPOINT_TEXT 128
+#define TRACE_LOG_SIZE 4096			// tracepoint records buffered for the UI, power of two
+
+struct Tracepoint {
+	uint32_t id;
+	uint16_t pc;
+	uint8_t numValues;
+	uint8_t rpn[TRACEPOINT_VALUES][TRACEPOINT_EXPR_SIZE];
+	char text[TRACEPOINT_TEXT];		// comma separated expressions as entered
+};
+
+struct TraceLogRecord {
+	uint32_t id;
+	uint32_t cycle;
+	uint16_t pc;
+	uint8_t numValues;
+	int values[TRACEPOINT_VALUES];
+};
+
+uint32_t AddTracepoint(uint16_t pc, const char *expressions);	// returns id or ~0 if full
+void RemoveTracepoint(uint32_t id);	// ~0 removes all
+int GetNumTracepoints();
+const Tracepoint* GetTracepoints();
+bool PopTraceLog(TraceLogRecord &record);
+uint32_t GetTraceLogDropped();	// records lost since the last call because the log was full
+
+// One emulated 64k 6502 machine with its own undo history, breakpoints and run
+// thread. The functions above operate on the default instance returned by
+// GetMachine(), trace and call graph recording only follow the default instance.
+class Machine {
+public:
+	Machine();
+	~Machine();
+
+	bool Initialize(bool primary = false);
+	void Shutdown();
+	void ResetUndoBuffer();
+
+	Regs& GetRegs() { return currRegs; }
+	void SetRegs(const Regs &r) { currRegs = r; }
+	uint32_t GetCycles() const { return cycles; }
+	uint8_t* GetMem(uint16_t addr = 0) { return ram + addr; }	// contiguous memory, not available for forks
+	uint8_t GetByte(uint16_t addr) const { return pages[addr >> 8][addr & 0xff]; }
+	void SetByte(uint16_t addr, uint8_t value);
+	uint32_t PatchMemory(uint16_t addr, const uint8_t *data, uint32_t size);
+
+	// copy-on-write fork of the current state. Memory pages are shared until
+	// either machine writes to them, the fork starts without undo history and
+	// is owned by this machine until discarded. Forks can not be forked.
+	Machine* Fork();
+	bool DiscardFork(Machine *fork);	// false while this machine is running
+	int GetNumForks() const { return (int)forks.size(); }
+	Machine* GetFork(int index) { return index >= 0 && index < (int)forks.size() ? forks[index] : nullptr; }
+	bool IsFork() const { return parent != nullptr; }
+	int GetPrivatePages() const;	// pages a fork has copied
+	bool IsSandboxContext() const { return sandboxContext; }
+	void SetSandboxContext(bool set) { sandboxContext = set; }
+	bool MemoryChange() const { return memChange || memChangePrev; }
+	void ClearMemoryChange() { memChange = false; }
+	uint32_t GetWriteGeneration() const { return writeGen; }
+	uint32_t GetPageWriteGeneration(uint8_t page) const { return pageWriteGen[page]; }
+	void CheckRegChange();
+	uint32_t GetHistoryCount(uint32_t &maxCount) const;
+
+	bool IsRunning() const { return hThreadCPU != IBThread_Clear; }
+	void AddUndoRegs(Regs &regs);
+	void Go(uint32_t numInstructions = 0);
+	void RunTo(uint16_t stopAddr);
+	void Reverse(uint32_t numInstructions = 0);
+	void ReverseTo(uint16_t stopAddr);
+	void Stop();
+	MachineRunResult Run(uint32_t cycleBudget);	// runs on the calling thread without undo history
+	void Step();
+	void StepOver();
+	bool StepBack();	// false if no reverse steps left
+	void StepOverBack();
+	int FindWrites(uint16_t addr, UndoWrite *writes, int maxWrites) const;
+	bool ReverseToWrite(uint16_t addr);
+	uint32_t FindReverseStop(const ReverseStop &stop);	// reverse steps to the stop, 0 if none
+	bool ReverseUntil(const ReverseStop &stop);
+	void Rewind(uint32_t steps);
+	void Reset();
+	void IRQ();
+	void NMI();
+
+	bool SetBPCondition(uint32_t id, const uint8_t *condition, uint16_t length);
+	void ClearBPCondition(uint32_t id);
+	void ClearAllPCBreakpoints();
+	uint16_t GetNumPCBreakpoints() const { return nBP; }
+	uint16_t* GetPCBreakpoints() { return aBP_PC; }
+	uint16_t GetPCBreakpointsID(uint16_t **pBP, uint32_t **pID, uint16_t &nDS);
+	uint32_t TogglePCBreakpoint(uint16_t addr);
+	uint32_t SetPCBreakpoint(uint16_t addr);
+	void ClearPCBreakpoint(uint16_t addr);
+	void RemoveBreakpointByID(uint32_t id);
+	bool GetBreakpointAddrByID(uint32_t id, uint16_t &addr) const;
+	bool EnableBPByID(uint32_t id, bool enable);
+	uint32_t SetTempPCBreakpoint(uint16_t addr);
+	bool SetBPIgnore(uint32_t id, uint32_t count);
+	bool SetBPEvery(uint32_t id, uint16_t every);
+	void ResetBPHits(uint32_t id);
+	bool GetBPHits(uint32_t id, BreakpointHits &info) const;
+
+	uint32_t AddTracepoint(uint16_t pc, const char *expressions);
+	void RemoveTracepoint(uint32_t id);
+	int GetNumTracepoints() const { return nTP; }
+	const Tracepoint* GetTracepoints() const { return aTP; }
+	bool PopTraceLog(TraceLogRecord &record);
+	uint32_t GetTraceLogDropped() { return traceLogDropped.exchange(0); }
+
+	void EnableHeatmap(bool enable);
+	bool IsHeatmapEnabled() const { return heatEnabled; }
+	void ClearHeatmap();
+	uint32_t GetHeatAge(uint16_t addr, HeatAccess type) const;
+	uint32_t GetHeatCount(uint16_t addr, HeatAccess type) const;
+
+	void SetBusCycleMode(bool enable);
+	bool IsBusCycleMode() const { return busCycleMode; }
+	void SetBusCycleHook(BusCycleHook hook, void *user);
+	int GetLastBusCycles(const BusCycle **bus) const;
+
+private:
+	struct BPCond {
+		uint16_t offs;
+		uint16_t size;
+		uint32_t hits;
+		uint32_t ignoreTo;	// hits up to this count don't stop
+		uint16_t every;
+		bool temporary;
+	};
+
+	// the undo buffer is split into chunks that keep a bit per page written by
+	// their records so write queries can skip most of the history
+	struct UndoChunk {
+		uint32_t first;		// count byte preceding the first record of the chunk
+		uint32_t records;
+		uint64_t pages[4];
+	};
+
+	uint8_t *ram;			// contiguous memory, nullptr for forks
+	uint8_t *pages[256];	// memory by 256 byte page
+	uint16_t pageShare[256];	// forks sharing each page, for a fork 1 if the page belongs to the parent
+	Machine *parent;
+	std::vector<Machine*> forks;
+	IBMutex mutexFork;
+	uint32_t writeGen;
+	uint32_t pageWriteGen[256];	// writeGen of the most recent write by page
+	uint8_t *undo;
+	uint32_t undo_oldest;
+	uint32_t undo_newest;
+	uint32_t history_max;
+	uint32_t history_count;
+	UndoChunk *undoChunks;
+	UndoChunk undoTail;		// oldest records, left in the chunk the buffer wrapped into
+	uint32_t undoChunk;		// chunk of the newest record
+
+	bool primary;			// feeds the trace and call graph recorders
+	bool memChange;
+	bool memChangePrev;
+	bool sandboxContext;
+	Regs currRegs;
+	Regs prevRegs;
+	uint32_t cycles;
+	uint32_t runCount;		// if non-zero run this many instructions
+
+	// in order to easily make a snapshot of breakpoints they are organized in
+	// a single array of PC breakpoints, then disabled breakpoints.
+	uint16_t aBP_PC[MAX_PC_BREAKPOINTS];	// active breakpoints
+	uint32_t aBP_ID[MAX_PC_BREAKPOINTS];	// breakpoint IDs, for visualization
+	BPCond aBP_CN[MAX_PC_BREAKPOINTS];		// condition bytecode
+	uint8_t aBP_EX[MAX_BP_CONDITIONS];
+	uint16_t nBP;					// total number of PC breakpoints
+	uint16_t nBP_DS;				// number of disabled breakpoints
+	uint16_t nBP_EX_Len;
+	uint32_t nBP_NextID;
+	uint16_t runTo;
+	uint16_t bStopCPU;
+	uint16_t bCPUIRQ;
+	uint16_t bCPUNMI;
+	IBMutex mutexBP;
+	IBThread hThreadCPU;	// runs the CPU in a thread so the UI can continue
+
+	// tracepoints are copied for the run thread when changed, the log is a
+	// single producer ring written by whichever thread runs the cpu
+	Tracepoint aTP[MAX_TRACEPOINTS];
+	Tracepoint runTP[MAX_TRACEPOINTS];
+	uint32_t tpPCs[0x10000 / 32];		// bit per pc of aTP so most instructions skip the list
+	uint32_t runTPPCs[0x10000 / 32];	// bit per pc of runTP
+	uint16_t nTP;
+	uint32_t tpVersion;		// bumped on any tracepoint change
+	TraceLogRecord *traceLog;
+	std::atomic<uint32_t> traceLogHead;
+	std::atomic<uint32_t> traceLogTail;
+	std::atomic<uint32_t> traceLogDropped;
+
+	// access heatmap, flat 64k array allocated the first time it is enabled
+	HeatCell *heat;
+	bool heatEnabled;
+	uint32_t heatCycle;		// cycle stamp for the current instruction
+	uint16_t heatPC;		// reads of the instruction bytes count as execution
+	uint8_t heatLen;
+
+	// most recent write by the current instruction for trace recording
+	uint16_t instWriteAddr;
+	uint8_t instWriteValue;
+	bool instWrote;
+
+	bool busCycleMode;
+	BusCycleHook busHook;
+	void *busHookUser;
+	BusCycle busLog[BUS_CYCLES_MAX];	// accesses of the most recent instruction
+	int busLogCount;
+	uint32_t busBase;		// cycle count at the start of the instruction
+
+	uint8_t& WriteRef(uint16_t addr) {
+		if (pageShare[addr >> 8]) { UnsharePage(addr >> 8); }
+		pageWriteGen[addr >> 8] = ++writeGen;
+		return pages[addr >> 8][addr & 0xff];
+	}
+	void UnsharePage(uint8_t page);
+	void CopySharedPage(uint8_t page);
+	void PushUndoByte(uint8_t b);
+	uint8_t PopUndoByte();
+	bool AllocUndo();
+	uint8_t UndoAt(uint32_t pos) const;
+	bool HaveUndoRecord(uint32_t pos) const;
+	bool HaveUndoStep() const { return HaveUndoRecord(undo_newest); }
+	void StepInt();
+	bool StepBackInt(Regs &regs, uint32_t &stepCycles);
+	void GoThread();
+	void ReverseThread();
+	bool CheckPCBreakpoint(const Regs &regs, uint16_t num, const uint16_t *cmp, const BPCond *cond, const uint8_t *expr,
+						   CBGetByte read = nullptr, void *user = nullptr);
+	bool CheckPCBreakpoint(const Regs &regs) { return CheckPCBreakpoint(regs, nBP, aBP_PC, aBP_CN, aBP_EX); }
+	bool HitPCBreakpoint(const Regs &regs, uint16_t num, const uint16_t *cmp, BPCond *cond, const uint8_t *expr, uint16_t &slot);
+	bool HitPCBreakpoint(const Regs &regs);
+	void PublishBPHits(const uint32_t *ids, const BPCond *cond, const uint32_t *copied, uint16_t num);
+	void EraseBPCondition(uint16_t index);
+	bool PushBackBPCondition(uint16_t index, const uint8_t *cond, uint16_t length);
+	void SwapBPSlots(uint16_t b, uint16_t s);
+	void MoveBPSlots(uint16_t s, uint16_t d);
+	void HitTracepoints(const Regs &regs, uint32_t cycle, const Tracepoint *tp, uint16_t num);
+	static bool TracepointPC(const uint32_t *pcs, uint16_t pc) { return !!(pcs[pc >> 5] & (1U << (pc & 31))); }
+	void HeatTouch(uint16_t addr, int type);
+	void HeatInstruction(uint16_t pc, uint32_t cycle);
+	void TraceStep(const Regs &before, uint8_t op, uint32_t cycle);
+	bool EffectiveAddress(const Regs &r, uint16_t &addr) const;
+
+	// cpu callbacks, user is the machine
+	static uint8_t GetByteCB(uint16_t addr, void *user);
+	static void SetByteCB(uint16_t addr, uint8_t value, void *user);
+	static void SetByteRecordCB(uint16_t addr, uint8_t value, void *user);
+	static uint8_t GetByteInstCB(uint16_t addr, void *user);
+	static void SetByteRecordInstCB(uint16_t addr, uint8_t value, void *user);
+	static void BusCycleCB(uint16_t addr, uint8_t value, uint8_t cycle, uint8_t access, void *user);
+	CBBusCycle BusCycleStart(uint32_t cycle);
+	void SelectMemAccess(bool heatRun, bool traceRun, CBGetByte &getByte, CBSetByte &setByte);
+	static IBThreadRet GoThreadRun(void *param);
+	static IBThreadRet ReverseThreadRun(void *param);
+};
+
+Machine& GetMachine();
@@ -33,4 +33,33 @@ int IBMutexLock(IBMutex* mutex);
 bool IBMutexRelease(IBMutex* mutex);
 bool IBCreateThread(IBThread* thread, size_t stackSize, IBThreadFunc func, void* param);
 bool IBDestroyThread(IBThread* thread);
+int IBNumCores();
 
+// runs func for each index 0..count-1 on its own thread and waits for all of them
+typedef void (*IBParallelFunc)(void* user, int index);
+void IBParallelFor(int count, IBParallelFunc func, void* user);
+
+// memory mapped files
+struct IBMappedFile {
+	void* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE map;
+#else
+	int fd;
+#endif
+};
+
+// size 0 maps an existing file read only, otherwise the file is created or grown to size
+bool IBMapFile(IBMappedFile* map, const char* filename, size_t size = 0);
+// truncateTo is only applied for writable maps, 0 keeps the current size
+void IBUnmapFile(IBMappedFile* map, size_t truncateTo = 0);
+
+// change notification for a few files, polled from the main loop without blocking.
+// the directories are watched so files replaced by a rename are noticed too
+struct IBFileWatch;
+IBFileWatch* IBCreateFileWatch(const char** filenames, int count);
+// sets changed[i] for each file written since the last poll, true if any was
+bool IBPollFileWatch(IBFileWatch* watch, bool* changed);
+void IBDestroyFileWatch(IBFileWatch* watch);
@@ -4,240 +4,666 @@
 #include "machine.h"
 #include "struse/struse.h"
 #include <map>
+#include <vector>
+#include <algorithm>
 #include <string.h>
-#include "HashTable.h"
 #include "Breakpoints.h"
+#include "sym.h"
+#include "TextFile.h"
 
-struct SymEntry {
-	int16_t count;
+// Symbol names are interned in an append-only arena of fixed size chunks so
+// the pointers handed out by GetSymbol stay valid until the next reset. Each
+// label is a compact (address, name offset) pair, sorted by address on demand.
+// Arena offsets grow with insertion order so sorting by (address, offset)
+// keeps the first label added for an address in front.
+enum {
+	SYM_ARENA_CHUNK_BITS = 16,
+	SYM_ARENA_CHUNK = 1 << SYM_ARENA_CHUNK_BITS,
+	SYM_MIN_SYMBOLS = 1024,
+	SYM_MIN_NAME_SLOTS = 2048,
+	SYM_MAX_SCOPE_DEPTH = 16,
+	SYM_TRIGRAM_BITS = 12,
+	SYM_TRIGRAMS = 1 << SYM_TRIGRAM_BITS,
+	SYM_MIN_POSTINGS = 16
 };
 
-struct SymList {
-	enum {
-		MIN_LIST = 7,
-		GROW_LIST = 8
-	};
-	size_t capacity;
-	const char* names[ 1 ];
+struct SymAddr {
+	uint16_t address;
+	uint32_t offset;	// arena chunk << SYM_ARENA_CHUNK_BITS | position in chunk
 };
 
-union SymRef {
-	const char* unique;
-	SymList* multi;
+static char** sArenaChunks = nullptr;
+static uint32_t sArenaNumChunks = 0;	// chunks allocated, kept across resets
+static uint32_t sArenaChunk = 0;		// chunk currently appended to
+static uint32_t sArenaUsed = 0;			// bytes used in the current chunk
+
+static SymAddr* sSymbols = nullptr;
+static uint32_t sNumSymbols = 0;
+static uint32_t sSymbolCapacity = 0;
+static uint32_t sSortedSymbols = 0;		// symbols before this are sorted and unique
+
+// Name to address index with open addressing and linear probing. Slots are
+// 16 bytes so a probe usually stays within one cache line. The hash is taken
+// over the lower case name so lookups ignore case, the name is always checked
+// against the arena and an exact case match wins.
+struct SymNameSlot {
+	uint64_t hash;
+	uint32_t offset;	// name in the arena
+	uint16_t address;
+	uint16_t length;	// 0 = empty slot
 };
 
-static SymEntry* sLabelCount = nullptr;
-static SymRef* sLabelEntries = nullptr;
+static SymNameSlot* sNameSlots = nullptr;
+static uint32_t sNumNameSlots = 0;		// power of two
+static uint32_t sNameSlotsUsed = 0;
+static uint32_t sSymbolGeneration = 0;	// changes whenever a name lookup could give a different result
+
+// Search index over every unique name. Prefix queries binary search a list
+// sorted ignoring case, substring queries scan the shortest trigram posting
+// list of the query and fuzzy (in order) queries are filtered by a mask of
+// the characters in each name. Names are appended as they are added and
+// merged into the sorted list by the next query.
+struct SymSearchName {
+	uint64_t key;		// first 8 characters folded to lower case, for sorting
+	uint32_t offset;
+	uint16_t address;
+	uint16_t length;
+};
 
-static HashTable<uint32_t> sReverseLookup;
+struct SymPostings {
+	uint32_t* ids;
+	uint32_t count;
+	uint32_t capacity;
+};
 
-void ResetSymbols()
+static SymSearchName* sSearchNames = nullptr;
+static uint64_t* sSearchMasks = nullptr;
+static uint32_t* sSearchSorted = nullptr;	// name ids in case insensitive order
+static uint32_t sNumSearchNames = 0;
+static uint32_t sNumSearchSorted = 0;
+static uint32_t sSearchCapacity = 0;
+static SymPostings sTrigrams[ SYM_TRIGRAMS ];
+
+static const char* SymName( uint32_t offset )
 {
-	sReverseLookup.Clear();
-	if( sLabelCount ) {
-		for( size_t adr = 0; adr < 0x10000; ++adr ) {
-			if( sLabelCount[ adr ].count == 1 ) {
-				if( sLabelEntries[ adr ].unique ) {
-					free( (void*)sLabelEntries[ adr ].unique );
-					sLabelEntries[ adr ].unique = nullptr;
-				}
-			}
-			else if( sLabelCount[ adr ].count ) {
-				if( const char** ppStr = sLabelEntries[ adr ].multi->names ) {
-					for( size_t i = 0, n = sLabelCount[ adr ].count; i < n; ++i ) {
-						if( *ppStr ) { free( (void*)*ppStr ); }
-						++ppStr;
-					}
-					free( sLabelEntries[ adr ].multi );
-				}
-			}
+	return sArenaChunks[ offset >> SYM_ARENA_CHUNK_BITS ] + ( offset & ( SYM_ARENA_CHUNK - 1 ) );
+}
+
+static bool ArenaAlloc( const char* name, size_t chars, uint32_t& offset )
+{
+	if( chars >= SYM_ARENA_CHUNK ) { chars = SYM_ARENA_CHUNK - 1; }
+	if( !sArenaNumChunks || ( sArenaUsed + chars + 1 ) > SYM_ARENA_CHUNK ) {
+		uint32_t next = sArenaNumChunks ? ( sArenaChunk + 1 ) : 0;
+		if( next == sArenaNumChunks ) {
+			char** chunks = (char**)realloc( sArenaChunks, sizeof( char* ) * ( sArenaNumChunks + 1 ) );
+			if( !chunks ) { return false; }
+			sArenaChunks = chunks;
+			if( !( sArenaChunks[ next ] = (char*)malloc( SYM_ARENA_CHUNK ) ) ) { return false; }
+			++sArenaNumChunks;
 		}
-		free( sLabelCount );
-		sLabelCount = nullptr;
-		free( sLabelEntries );
-		sLabelEntries = nullptr;
+		sArenaChunk = next;
+		sArenaUsed = 0;
 	}
+	char* copy = sArenaChunks[ sArenaChunk ] + sArenaUsed;
+	memcpy( copy, name, chars );
+	copy[ chars ] = 0;
+	offset = ( sArenaChunk << SYM_ARENA_CHUNK_BITS ) | sArenaUsed;
+	sArenaUsed += (uint32_t)chars + 1;
+	return true;
 }
 
-void AddSymbol( uint16_t address, const char *name, size_t chars )
+static uint64_t NameHash( const char* name, size_t chars )
 {
-	// make sure label array exists
-	if( !sLabelCount ) {
-		sLabelCount = (SymEntry*)calloc( 1, sizeof( SymEntry ) * 0x10000 );
-		sLabelEntries = (SymRef*)calloc( 1, sizeof( SymRef ) * 0x10000 );
+	uint64_t hash = 14695981039346656037ULL;
+	for( size_t i = 0; i < chars; ++i ) {
+		uint8_t c = (uint8_t)name[ i ];
+		if( c >= 'A' && c <= 'Z' ) { c += 'a' - 'A'; }
+		hash = ( c ^ hash ) * 1099511628211ULL;
 	}
-	// check for dupes
+	return hash;
+}
+
+static uint32_t NameSlot( uint64_t hash )
+{
+	return (uint32_t)( hash ^ ( hash >> 32 ) ) & ( sNumNameSlots - 1 );
+}
+
+// without exactCase a name that only differs in case is returned if there is no exact match
+static const SymNameSlot* FindName( const char* name, size_t chars, uint64_t hash, bool exactCase )
+{
+	if( !sNameSlotsUsed ) { return nullptr; }
 	strref lbl( name, (strl_t)chars );
-	if( sLabelCount[ address ].count ) {
-		if( sLabelCount[ address ].count == 1 ) {
-			if( lbl.same_str_case( sLabelEntries[ address ].unique ) ) { return; }
-		} else {
-			if( const char** ppStr = sLabelEntries[ address ].multi->names ) {
-				for( size_t i = 0, n = sLabelCount[ address ].count; i < n; ++i ) {
-					if( lbl.same_str( *ppStr ) ) { return; }
-					++ppStr;
-				}
-			}
+	const SymNameSlot* found = nullptr;
+	for( uint32_t slot = NameSlot( hash ); sNameSlots[ slot ].length; slot = ( slot + 1 ) & ( sNumNameSlots - 1 ) ) {
+		const SymNameSlot& entry = sNameSlots[ slot ];
+		if( entry.hash == hash && entry.length == chars ) {
+			const char* str = SymName( entry.offset );
+			if( lbl.same_str_case( str ) ) { return &entry; }
+			if( !exactCase && !found && lbl.same_str( str ) ) { found = &entry; }
 		}
 	}
+	return found;
+}
+
+static void PlaceName( const SymNameSlot& entry )
+{
+	uint32_t slot = NameSlot( entry.hash );
+	while( sNameSlots[ slot ].length ) { slot = ( slot + 1 ) & ( sNumNameSlots - 1 ); }
+	sNameSlots[ slot ] = entry;
+}
 
-	uint64_t hash = lbl.fnv1a_64();
-	if( !sReverseLookup.Exists( hash ) ) {
-		sReverseLookup.Insert( hash, address);
+static bool InsertName( uint64_t hash, uint32_t offset, size_t chars, uint16_t address )
+{
+	// keep the table at most half full so most probes end at the first slot
+	if( ( sNameSlotsUsed + 1 ) * 2 > sNumNameSlots ) {
+		uint32_t count = sNumNameSlots ? ( sNumNameSlots * 2 ) : SYM_MIN_NAME_SLOTS;
+		SymNameSlot* slots = (SymNameSlot*)calloc( count, sizeof( SymNameSlot ) );
+		if( !slots ) { return false; }
+		SymNameSlot* prev = sNameSlots;
+		uint32_t prevCount = sNumNameSlots;
+		sNameSlots = slots;
+		sNumNameSlots = count;
+		for( uint32_t i = 0; i < prevCount; ++i ) {
+			if( prev[ i ].length ) { PlaceName( prev[ i ] ); }
+		}
+		free( prev );
 	}
+	SymNameSlot entry = { hash, offset, address, (uint16_t)chars };
+	PlaceName( entry );
+	++sNameSlotsUsed;
+	return true;
+}
 
-	// not a dupe
-	char* copy = (char*)malloc( chars + 1 );
-	memcpy( copy, name, chars );
-	copy[ chars ] = 0;
-	if( !sLabelCount[ address ].count ) {
-		sLabelCount[ address ].count = 1;
-		sLabelEntries[ address ].unique = copy;
-	} else if( sLabelCount[ address ].count == 1 ) {
-		const char* prev = sLabelEntries[ address ].unique;
-		sLabelEntries[ address ].multi = (SymList*)malloc( sizeof( SymList ) + sizeof( const char* ) * (SymList::MIN_LIST - 1) );
-		sLabelEntries[ address ].multi->capacity = SymList::MIN_LIST;
-		sLabelCount[ address ].count = 2;
-		sLabelEntries[ address ].multi->names[ 0 ] = prev;
-		sLabelEntries[ address ].multi->names[ 1 ] = copy;
-	} else {
-		SymList* entries = sLabelEntries[ address ].multi;
-		if( entries->capacity == sLabelCount[ address ].count ) {
-			sLabelEntries[ address ].multi = (SymList*)malloc(
-				sizeof( SymList ) + sizeof( const char* ) * (entries->capacity + SymList::GROW_LIST - 1) );
-			sLabelEntries[ address ].multi->capacity = entries->capacity + SymList::GROW_LIST;
-			memcpy( sLabelEntries[ address ].multi->names, entries->names, sizeof( const char* ) * sLabelCount[ address ].count );
-			free( entries );
-			entries = sLabelEntries[ address ].multi;
+static uint8_t FoldCase( char c )
+{
+	return ( c >= 'A' && c <= 'Z' ) ? (uint8_t)( c + 'a' - 'A' ) : (uint8_t)c;
+}
+
+static uint64_t CharMask( const char* name, size_t chars )
+{
+	uint64_t mask = 0;
+	for( size_t i = 0; i < chars; ++i ) { mask |= 1ULL << ( FoldCase( name[ i ] ) & 63 ); }
+	return mask;
+}
+
+static uint32_t Trigram( const char* str )
+{
+	uint32_t t = ( FoldCase( str[ 0 ] ) << 16 ) | ( FoldCase( str[ 1 ] ) << 8 ) | FoldCase( str[ 2 ] );
+	return ( t * 2654435761U ) >> ( 32 - SYM_TRIGRAM_BITS );
+}
+
+static int CompareNoCase( const char* a, size_t lenA, const char* b, size_t lenB )
+{
+	for( size_t i = 0, n = lenA < lenB ? lenA : lenB; i < n; ++i ) {
+		int d = (int)FoldCase( a[ i ] ) - (int)FoldCase( b[ i ] );
+		if( d ) { return d; }
+	}
+	return lenA < lenB ? -1 : ( lenA > lenB ? 1 : 0 );
+}
+
+static void AddPosting( uint32_t trigram, uint32_t id )
+{
+	SymPostings& list = sTrigrams[ trigram ];
+	if( list.count && list.ids[ list.count - 1 ] == id ) { return; }
+	if( list.count == list.capacity ) {
+		uint32_t capacity = list.capacity ? ( list.capacity * 2 ) : SYM_MIN_POSTINGS;
+		uint32_t* ids = (uint32_t*)realloc( list.ids, sizeof( uint32_t ) * capacity );
+		if( !ids ) { return; }
+		list.ids = ids;
+		list.capacity = capacity;
+	}
+	list.ids[ list.count++ ] = id;
+}
+
+static void AddSearchName( uint32_t offset, size_t chars, uint16_t address )
+{
+	if( sNumSearchNames == sSearchCapacity ) {
+		uint32_t capacity = sSearchCapacity ? ( sSearchCapacity * 2 ) : SYM_MIN_SYMBOLS;
+		SymSearchName* names = (SymSearchName*)realloc( sSearchNames, sizeof( SymSearchName ) * capacity );
+		if( names ) { sSearchNames = names; }
+		uint64_t* masks = (uint64_t*)realloc( sSearchMasks, sizeof( uint64_t ) * capacity );
+		if( masks ) { sSearchMasks = masks; }
+		uint32_t* sorted = (uint32_t*)realloc( sSearchSorted, sizeof( uint32_t ) * capacity );
+		if( sorted ) { sSearchSorted = sorted; }
+		if( !names || !masks || !sorted ) { return; }
+		sSearchCapacity = capacity;
+	}
+	uint32_t id = sNumSearchNames++;
+	const char* name = SymName( offset );
+	uint64_t key = 0;
+	for( size_t i = 0; i < 8; ++i ) { key = ( key << 8 ) | ( i < chars ? FoldCase( name[ i ] ) : 0 ); }
+	sSearchNames[ id ].key = key;
+	sSearchNames[ id ].offset = offset;
+	sSearchNames[ id ].address = address;
+	sSearchNames[ id ].length = (uint16_t)chars;
+	sSearchMasks[ id ] = CharMask( name, chars );
+	for( size_t i = 0; ( i + 3 ) <= chars; ++i ) { AddPosting( Trigram( name + i ), id ); }
+}
+
+static bool SearchNameLess( uint32_t a, uint32_t b )
+{
+	const SymSearchName& na = sSearchNames[ a ];
+	const SymSearchName& nb = sSearchNames[ b ];
+	if( na.key != nb.key ) { return na.key < nb.key; }
+	int d = CompareNoCase( SymName( na.offset ), na.length, SymName( nb.offset ), nb.length );
+	return d < 0 || ( !d && a < b );
+}
+
+static void SortSearchNames()
+{
+	if( sNumSearchSorted == sNumSearchNames ) { return; }
+	for( uint32_t i = sNumSearchSorted; i < sNumSearchNames; ++i ) { sSearchSorted[ i ] = i; }
+	std::sort( sSearchSorted + sNumSearchSorted, sSearchSorted + sNumSearchNames, SearchNameLess );
+	std::inplace_merge( sSearchSorted, sSearchSorted + sNumSearchSorted, sSearchSorted + sNumSearchNames, SearchNameLess );
+	sNumSearchSorted = sNumSearchNames;
+}
+
+static SymbolMatch MatchName( const char* name, size_t chars, const char* query, size_t queryChars )
+{
+	if( queryChars > chars ) { return SYM_MATCH_NONE; }
+	for( size_t pos = 0; ( pos + queryChars ) <= chars; ++pos ) {
+		size_t i = 0;
+		while( i < queryChars && FoldCase( name[ pos + i ] ) == FoldCase( query[ i ] ) ) { ++i; }
+		if( i == queryChars ) { return pos ? SYM_MATCH_SUBSTRING : SYM_MATCH_PREFIX; }
+	}
+	size_t q = 0;
+	for( size_t i = 0; i < chars && q < queryChars; ++i ) {
+		if( FoldCase( name[ i ] ) == FoldCase( query[ q ] ) ) { ++q; }
+	}
+	return q == queryChars ? SYM_MATCH_FUZZY : SYM_MATCH_NONE;
+}
+
+static void AddSearchResult( uint32_t id, SymbolMatch match, SymbolSearchResult* results, uint32_t &numResults )
+{
+	results[ numResults ].name = SymName( sSearchNames[ id ].offset );
+	results[ numResults ].address = sSearchNames[ id ].address;
+	results[ numResults ].match = match;
+	++numResults;
+}
+
+static bool SymAddrLess( const SymAddr& a, const SymAddr& b )
+{
+	return a.address < b.address || ( a.address == b.address && a.offset < b.offset );
+}
+
+// merge symbols added since the last sort into the sorted range and drop
+// repeated names at the same address
+static void SortSymbolAddresses()
+{
+	if( sSortedSymbols == sNumSymbols ) { return; }
+	std::sort( sSymbols + sSortedSymbols, sSymbols + sNumSymbols, SymAddrLess );
+	std::inplace_merge( sSymbols, sSymbols + sSortedSymbols, sSymbols + sNumSymbols, SymAddrLess );
+	uint32_t out = 0, group = 0;
+	for( uint32_t i = 0; i < sNumSymbols; ++i ) {
+		if( !out || sSymbols[ out - 1 ].address != sSymbols[ i ].address ) { group = out; }
+		const char* name = SymName( sSymbols[ i ].offset );
+		bool dupe = false;
+		for( uint32_t j = group; j < out && !dupe; ++j ) {
+			dupe = strcmp( SymName( sSymbols[ j ].offset ), name ) == 0;
 		}
-		entries->names[ sLabelCount[ address ].count++ ] = copy;
+		if( !dupe ) { sSymbols[ out++ ] = sSymbols[ i ]; }
 	}
+	sNumSymbols = sSortedSymbols = out;
+}
+
+// lookups only see sorted symbols, the loaders sort once after adding so
+// reading never changes the tables
+void SortSymbols()
+{
+	SortSymbolAddresses();
+	SortSearchNames();
+}
+
+// releases nothing, the arena and tables are reused by the next load
+void ResetSymbols()
+{
+	if( sNameSlotsUsed ) {
+		memset( sNameSlots, 0, sizeof( SymNameSlot ) * sNumNameSlots );
+		sNameSlotsUsed = 0;
+	}
+	++sSymbolGeneration;
+	sNumSymbols = 0;
+	sSortedSymbols = 0;
+	sNumSearchNames = 0;
+	sNumSearchSorted = 0;
+	for( uint32_t t = 0; t < SYM_TRIGRAMS; ++t ) { sTrigrams[ t ].count = 0; }
+	sArenaChunk = 0;
+	sArenaUsed = 0;
+}
+
+// display names are listed for their address, other names (scoped labels)
+// can only be looked up
+// chars must be below SYM_ARENA_CHUNK and hash must be NameHash of the name
+static void AddSymbolHashed( uint16_t address, const char *name, size_t chars, uint64_t hash, bool display )
+{
+	if( !chars ) { return; }
+	const SymNameSlot* known = FindName( name, chars, hash, true );
+	bool sameAddress = known && known->address == address;
+	if( sameAddress && !display ) { return; }
+
+	if( display && sNumSymbols == sSymbolCapacity ) {
+		uint32_t capacity = sSymbolCapacity ? ( sSymbolCapacity * 2 ) : SYM_MIN_SYMBOLS;
+		SymAddr* symbols = (SymAddr*)realloc( sSymbols, sizeof( SymAddr ) * capacity );
+		if( !symbols ) { return; }
+		sSymbols = symbols;
+		sSymbolCapacity = capacity;
+	}
+	// a name already at this address is shared, SortSymbols drops repeats
+	uint32_t offset;
+	if( sameAddress ) { offset = known->offset; }
+	else if( !ArenaAlloc( name, chars, offset ) ) { return; }
+	if( display ) {
+		sSymbols[ sNumSymbols ].address = address;
+		sSymbols[ sNumSymbols ].offset = offset;
+		++sNumSymbols;
+	}
+	// the first address given to a name is the one it resolves to
+	if( !known && InsertName( hash, offset, chars, address ) ) {
+		AddSearchName( offset, chars, address );
+		++sSymbolGeneration;
+	}
+}
+
+static void AddSymbolName( uint16_t address, const char *name, size_t chars, bool display )
+{
+	if( chars >= SYM_ARENA_CHUNK ) { chars = SYM_ARENA_CHUNK - 1; }
+	AddSymbolHashed( address, name, chars, NameHash( name, chars ), display );
+}
+
+void AddSymbol( uint16_t address, const char *name, size_t chars )
+{
+	AddSymbolName( address, name, chars, true );
+}
+
+uint32_t GetSymbolGeneration()
+{
+	return sSymbolGeneration;
 }
 
 void ShutdownSymbols()
 {
 	ResetSymbols();
+	for( uint32_t c = 0; c < sArenaNumChunks; ++c ) { free( sArenaChunks[ c ] ); }
+	free( sArenaChunks );
+	sArenaChunks = nullptr;
+	sArenaNumChunks = 0;
+	free( sSymbols );
+	sSymbols = nullptr;
+	sSymbolCapacity = 0;
+	free( sSearchNames );
+	free( sSearchMasks );
+	free( sSearchSorted );
+	sSearchNames = nullptr;
+	sSearchMasks = nullptr;
+	sSearchSorted = nullptr;
+	sSearchCapacity = 0;
+	for( uint32_t t = 0; t < SYM_TRIGRAMS; ++t ) {
+		free( sTrigrams[ t ].ids );
+		sTrigrams[ t ].ids = nullptr;
+		sTrigrams[ t ].capacity = 0;
+	}
 }
 
 const char* GetSymbol(uint16_t address)
 {
-	if( sLabelCount ) {
-		if( !sLabelCount[ address ].count ) { return nullptr; }
-		if( sLabelCount[ address ].count == 1 ) { return sLabelEntries[ address ].unique; }
-		return sLabelEntries[ address ].multi->names[ 0 ];
+	uint32_t lo = 0, hi = sSortedSymbols;
+	while( lo < hi ) {
+		uint32_t mid = ( lo + hi ) >> 1;
+		if( sSymbols[ mid ].address < address ) { lo = mid + 1; }
+		else { hi = mid; }
 	}
+	if( lo < sSortedSymbols && sSymbols[ lo ].address == address ) { return SymName( sSymbols[ lo ].offset ); }
 	return nullptr;
 }
 
-static uint64_t fnv1a_64(const char *string, size_t length, uint64_t seed = 14695981039346656037ULL)
+bool GetAddress( const char *name, size_t chars, uint16_t &addr )
 {
-	uint64_t hash = seed;
-	if (string) {
-		size_t left = length;
-		while (left--)
-			hash = (*string++ ^ hash) * 1099511628211;
+	if( !chars || chars >= SYM_ARENA_CHUNK ) { return false; }
+	if( const SymNameSlot* entry = FindName( name, chars, NameHash( name, chars ), false ) ) {
+		addr = entry->address;
+		return true;
 	}
-	return hash;
+	return false;
 }
 
-bool GetAddress( const char *name, size_t chars, uint16_t &addr )
+// first sorted name that is not less than the query
+static uint32_t SearchSortedStart( const char* query, size_t chars )
 {
-	uint64_t key = fnv1a_64( name, chars );
-	if( uint32_t* value = sReverseLookup.Value( key ) ) {
-		addr = (uint16_t)*value;
-		return true;
+	uint32_t lo = 0, hi = sNumSearchSorted;
+	while( lo < hi ) {
+		uint32_t mid = ( lo + hi ) >> 1;
+		const SymSearchName& entry = sSearchNames[ sSearchSorted[ mid ] ];
+		if( CompareNoCase( SymName( entry.offset ), entry.length, query, chars ) < 0 ) { lo = mid + 1; }
+		else { hi = mid; }
+	}
+	return lo;
+}
+
+// prefix matches come first in name order, then names containing the query
+// and last names that contain the query characters in order
+uint32_t SearchSymbols( const char* query, size_t chars, SymbolSearchResult* results, uint32_t maxResults )
+{
+	uint32_t numResults = 0;
+	if( !chars || !maxResults || !sNumSearchNames ) { return 0; }
+
+	for( uint32_t lo = SearchSortedStart( query, chars ); lo < sNumSearchSorted && numResults < maxResults; ++lo ) {
+		const SymSearchName& entry = sSearchNames[ sSearchSorted[ lo ] ];
+		if( entry.length < chars || CompareNoCase( SymName( entry.offset ), chars, query, chars ) ) { break; }
+		AddSearchResult( sSearchSorted[ lo ], SYM_MATCH_PREFIX, results, numResults );
+	}
+
+	if( chars >= 3 ) {
+		const SymPostings* shortest = &sTrigrams[ Trigram( query ) ];
+		for( size_t i = 1; ( i + 3 ) <= chars; ++i ) {
+			const SymPostings* list = &sTrigrams[ Trigram( query + i ) ];
+			if( list->count < shortest->count ) { shortest = list; }
+		}
+		for( uint32_t i = 0; i < shortest->count && numResults < maxResults; ++i ) {
+			uint32_t id = shortest->ids[ i ];
+			const SymSearchName& entry = sSearchNames[ id ];
+			if( MatchName( SymName( entry.offset ), entry.length, query, chars ) == SYM_MATCH_SUBSTRING ) {
+				AddSearchResult( id, SYM_MATCH_SUBSTRING, results, numResults );
+			}
+		}
+	}
+
+	uint64_t mask = CharMask( query, chars );
+	for( uint32_t id = 0; id < sNumSearchNames && numResults < maxResults; ++id ) {
+		if( ( sSearchMasks[ id ] & mask ) != mask ) { continue; }
+		const SymSearchName& entry = sSearchNames[ id ];
+		SymbolMatch match = MatchName( SymName( entry.offset ), entry.length, query, chars );
+		if( match == SYM_MATCH_FUZZY || ( match == SYM_MATCH_SUBSTRING && chars < 3 ) ) {
+			AddSearchResult( id, match, results, numResults );
+		}
+	}
+	return numResults;
+}
+
+// all names starting with the query are GetSymbolName( first ) onwards, returns how many
+uint32_t SearchSymbolPrefix( const char* query, size_t chars, uint32_t& first )
+{
+	first = SearchSortedStart( query, chars );
+	if( !chars ) { return 0; }
+	uint32_t lo = first, hi = sNumSearchSorted;
+	while( lo < hi ) {
+		uint32_t mid = ( lo + hi ) >> 1;
+		const SymSearchName& entry = sSearchNames[ sSearchSorted[ mid ] ];
+		size_t length = entry.length < chars ? entry.length : chars;
+		if( CompareNoCase( SymName( entry.offset ), length, query, chars ) <= 0 ) { lo = mid + 1; }
+		else { hi = mid; }
+	}
+	return lo - first;
+}
+
+uint32_t GetNumSymbolNames()
+{
+	return sNumSearchSorted;
+}
+
+// index is in case insensitive name order
+bool GetSymbolName( uint32_t index, const char* &name, uint16_t &address )
+{
+	if( index >= sNumSearchSorted ) { return false; }
+	const SymSearchName& entry = sSearchNames[ sSearchSorted[ index ] ];
+	name = SymName( entry.offset );
+	address = entry.address;
+	return true;
+}
+
+// Symbol files are parsed in chunks on separate threads. Each chunk
+// collects its lines with the name hashes already computed, then the lines
+// are applied in file order so scopes and label order match a serial load.
+enum SymFileLineType {
+	SFL_Label,
+	SFL_Namespace,
+	SFL_ScopeEnd,
+	SFL_Break,
+	SFL_DebugBreak
+};
+
+struct SymFileLine {
+	strref name;
+	uint64_t hash;
+	uint16_t address;
+	uint8_t type;
+	bool opensScope;
+};
+
+typedef std::vector<SymFileLine> SymFileChunk;
+
+static void AddFileLine( SymFileChunk& chunk, SymFileLineType type, uint16_t address, strref name, bool opensScope )
+{
+	SymFileLine line;
+	if( name.get_len() >= SYM_ARENA_CHUNK ) { name = name.get_substr( 0, SYM_ARENA_CHUNK - 1 ); }
+	line.name = name;
+	line.hash = name ? NameHash( name.get(), name.get_len() ) : 0;
+	line.address = address;
+	line.type = (uint8_t)type;
+	line.opensScope = opensScope;
+	chunk.push_back( line );
+}
+
+static void ParseViceCommandChunk( void* user, int index, strref file )
+{
+	SymFileChunk& chunk = ( (SymFileChunk*)user )[ index ];
+	while( strref line = file.line() ) {
+		if( strref command = line.get_word() ) {
+			line += command.get_len();
+			line.trim_whitespace();
+			if( command.same_str( "break" ) || command.same_str( "bk" ) ) {
+				if( line.get_first() == '$' ) { ++line; }
+				AddFileLine( chunk, SFL_Break, (uint16_t)( line + 1 ).ahextoui(), strref(), false );
+			} else if( command.same_str( "al" ) || command.same_str( "add_label" ) ) {
+				if( line.has_prefix( "c:" ) ) { line += 2; }
+				line.skip_whitespace();
+				if( line.get_first() == '$' ) { ++line; }
+				uint16_t addr = (uint16_t)line.ahextoui_skip();
+				line.skip_whitespace();
+				AddFileLine( chunk, SFL_Label, addr, line, false );
+			}
+		}
 	}
-	return false;
 }
 
 void ReadViceCommandFile(const char *symFile)
 {
 	ResetSymbols();
-	FILE* f;
-	if (fopen_s(&f, symFile, "rb") == 0 && f) {
-		fseek(f, 0, SEEK_END);
-		uint32_t size = ftell(f);
-		fseek(f, 0, SEEK_SET);
-		if (void *voidbuf = malloc(size)) {
-			fread(voidbuf, size, 1, f);
-
-			char *strcurr = nullptr;
-			char *strend = nullptr;
-			char **strtable = nullptr;
-			uint16_t *addresses = nullptr;
-			size_t strcurr_left = 0;
-
-			size_t numChars = 0;
-			for (int pass = 0; pass<2; pass++) {
-				uint32_t size_tmp = size;
-				strref file((const char*)voidbuf, size);
-				//				const char *buf = (const char*)voidbuf;
-				uint32_t numLabels = 0;
-
-				while (strref line = file.line()) {
-					if (strref command = line.get_word()) {
-						uint32_t addr;
-						line += command.get_len();
-						line.trim_whitespace();
-						if (command.same_str("break") || command.same_str("bk")) {
-							if (pass) {
-								if (line.get_first() == '$') { ++line; }
-								SetPCBreakpoint((uint16_t)(line + 1).ahextoui());
-							}
-						} else if (command.same_str("al") || command.same_str("add_label")) {
-							if (line.has_prefix("c:")) { line += 2; }
-							line.skip_whitespace();
-							if (line.get_first() == '$') { ++line; }
-							addr = (uint16_t)line.ahextoui_skip();
-							line.skip_whitespace();
-							if (addr < 0x10000) {
-								AddSymbol(addr, line.get(), line.get_len());
-							}
-						}
+	TextFile file;
+	if (OpenTextFile(file, symFile)) {
+		int numChunks = TextChunkCount(file.text);
+		std::vector<SymFileChunk> chunks(numChunks);
+		ParseTextChunks(file.text, numChunks, ParseViceCommandChunk, chunks.data());
+
+		// all labels go in before any breakpoint is set
+		for (int c = 0; c < numChunks; ++c) {
+			for (const SymFileLine& line : chunks[c]) {
+				if (line.type == SFL_Label) { AddSymbolHashed(line.address, line.name.get(), line.name.get_len(), line.hash, true); }
+			}
+		}
+		SortSymbols();
+		for (int c = 0; c < numChunks; ++c) {
+			for (const SymFileLine& line : chunks[c]) {
+				if (line.type == SFL_Break) { SetPCBreakpoint(line.address); }
+			}
+		}
+		CloseTextFile(file);
+	}
+}
+
+static void ParseSymbolChunk( void* user, int index, strref file )
+{
+	SymFileChunk& chunk = ( (SymFileChunk*)user )[ index ];
+	while( file ) {
+		if( strref line = file.line() ) {
+			line.skip_whitespace();
+			if( line.get_first() == '}' ) {
+				AddFileLine( chunk, SFL_ScopeEnd, 0, strref(), false );
+			} else if( line.grab_prefix( ".namespace" ) ) {
+				line.skip_whitespace();
+				strref name = line.split_label();
+				line.skip_whitespace();
+				if( name && line.get_first() == '{' ) { AddFileLine( chunk, SFL_Namespace, 0, name, true ); }
+			} else if( line.grab_prefix( ".label" ) ) {
+				line.skip_whitespace();
+				strref label = line.split_label();
+				line.skip_whitespace();
+				if( line.grab_char( '=' ) ) {
+					line.skip_whitespace();
+					if( line.grab_char( '$' ) ) {
+						uint16_t addr = (uint16_t)line.ahextoui_skip();
+						line.skip_whitespace();
+						bool opensScope = label && line.get_first() == '{';
+						AddFileLine( chunk, label.same_str( "debugbreak" ) ? SFL_DebugBreak : SFL_Label, addr, label, opensScope );
 					}
 				}
 			}
-			free(voidbuf);
 		}
-		fclose(f);
 	}
 }
 
 bool ReadSymbols(const char *filename)
 {
 	ResetSymbols();
-	FILE *f;
-	if (fopen_s(&f, filename, "rb") == 0) {
-		fseek(f, 0, SEEK_END);
-		uint32_t size = ftell(f);
-		fseek(f, 0, SEEK_SET);
-		if (void *voidbuf = malloc(size)) {
-			fread(voidbuf, size, 1, f);
-			strref file((const char*)voidbuf, size);
-			while (file) {
-				if (strref line = file.line()) {
-					line.skip_whitespace();
-					if (line.grab_prefix(".label")) {
-						line.skip_whitespace();
-						strref label = line.split_label();
-						line.skip_whitespace();
-						if (line.grab_char('=')) {
-							line.skip_whitespace();
-							if (line.grab_char('$')) {
-								size_t addr = line.ahextoui();
-								if (label.same_str("debugbreak")) {
-									SetViceBP((uint16_t)addr, (uint16_t)addr, -1, true, VBP_Break, false);
-								} else {
-									AddSymbol((uint16_t)addr, label.get(), label.get_len());
-								}
-							}
-						}
+	TextFile file;
+	if (OpenTextFile(file, filename)) {
+		int numChunks = TextChunkCount(file.text);
+		std::vector<SymFileChunk> chunks(numChunks);
+		ParseTextChunks(file.text, numChunks, ParseSymbolChunk, chunks.data());
+
+		// labels inside { } blocks can also be found as scope.label
+		strown<512> scope;
+		strl_t scopeLen[SYM_MAX_SCOPE_DEPTH];
+		int depth = 0;
+		for (int c = 0; c < numChunks; ++c) {
+			for (const SymFileLine& line : chunks[c]) {
+				if (line.type == SFL_ScopeEnd) {
+					if (depth) {
+						--depth;
+						if (depth < SYM_MAX_SCOPE_DEPTH) { scope.remove(scopeLen[depth], scope.get_len() - scopeLen[depth]); }
+					}
+					continue;
+				} else if (line.type == SFL_DebugBreak) {
+					SetViceBP(line.address, line.address, -1, true, VBP_Break, false);
+				} else if (line.type == SFL_Label) {
+					AddSymbolHashed(line.address, line.name.get(), line.name.get_len(), line.hash, true);
+					if (scope) {
+						strown<512> qualified(scope);
+						qualified.append('.').append(line.name);
+						AddSymbolName(line.address, qualified.get(), qualified.get_len(), false);
+					}
+				}
+				if (line.opensScope) {
+					if (depth < SYM_MAX_SCOPE_DEPTH) {
+						scopeLen[depth] = scope.get_len();
+						if (scope) { scope.append('.'); }
+						scope.append(line.name);
 					}
+					++depth;
 				}
 			}
-			free(voidbuf);
 		}
-		fclose(f);
+		SortSymbols();
+		CloseTextFile(file);
 		return true;
 	}
 	return false;
@@ -3,7 +3,28 @@
 bool ReadSymbols(const char *binname);
 void ReadViceCommandFile(const char *symFile);
 void ReadSymbolsForBinary(const char *binname);
+void ResetSymbols();
 void ShutdownSymbols();
 bool GetAddress(const char *name, size_t chars, uint16_t &addr);
 const char* GetSymbol(uint16_t address);
 void AddSymbol(uint16_t address, const char *name, size_t chars);
+void SortSymbols();	// after adding, lookups don't see symbols until sorted
+uint32_t GetSymbolGeneration();
+
+enum SymbolMatch {
+	SYM_MATCH_NONE,
+	SYM_MATCH_PREFIX,		// name starts with the query
+	SYM_MATCH_SUBSTRING,	// query found later in the name
+	SYM_MATCH_FUZZY			// query characters appear in order
+};
+
+struct SymbolSearchResult {
+	const char* name;
+	uint16_t address;
+	SymbolMatch match;
+};
+
+uint32_t SearchSymbols(const char *query, size_t chars, SymbolSearchResult *results, uint32_t maxResults);
+uint32_t SearchSymbolPrefix(const char *query, size_t chars, uint32_t &first);
+uint32_t GetNumSymbolNames();
+bool GetSymbolName(uint32_t index, const char* &name, uint16_t &address);